@@ -41,6 +41,19 @@ void BVertexCQ::findQW(const std::vector<double> &F,
 	FuncEnd();
 }
 
+double BVertexCQ::dQW(const std::vector<double> &Lw , const std::vector<double> &Ln,
+					  const std::vector<double> &dLw , const std::vector<double> &dLn) const{
+	FuncBegin();
+
+	if(reg_->stype != RegionBoundary::SGPZero) return 0;
+	const int i = self_->dd.front().idx;
+	const double lt = Lw.at(i) + Ln.at(i);
+	return - dLn.at(i) * kdgdzna * Lw.at(i) / lt +
+		( mGamma_  - Ln.at(i) * kdgdzna) * ( dLw.at(i) * Ln.at(i) - Lw.at(i) * dLn.at(i) ) / lt / lt;
+
+	FuncEnd();
+}
+
 void BVertexCQ::constructL(){
 	FuncBegin();
 
@@ -148,6 +161,13 @@ void BVertexCQ::assemP(Mat A, Vec b) {
 	FuncEnd();
 }
 
+void BVertexCQ::assemP(Vec b) {
+	FuncBegin();
+	double rhs = -mGamma_;
+	Error::code=VecSetValue(b , self_->idx, rhs, ADD_VALUES);ERRCHK();
+	FuncEnd();
+}
+
 int BVertexCQ::addNeigh(Node *nd){
 	FuncBegin();
 
@@ -211,6 +231,27 @@ void BVertexCQ::constructGeoParams(const double dp, Mat A, const Gravity &grav){
 	mGamma_=length_ * reg_->val[0] * dp;
 }
 
+void BVertexCQ::geoParams(double *v) const{
+	v[0] = length_;
+	v[1] = nA_(0);
+	v[2] = nA_(1);
+	v[3] = kdgdzna;
+}
+
+void BVertexCQ::setGeoParams(const double *v, Node *pre, Node *next, const double dp, Mat A){
+	pre_ = pre;
+	next_ = next;
+	length_ = v[0];
+	nA_(0) = v[1];
+	nA_(1) = v[2];
+	kdgdzna = v[3];
+	mGamma_=length_ * reg_->val[0] * dp;
+}
+
+void BVertexCQ::updateValue(const double dp){
+	mGamma_=length_ * reg_->val[0] * dp;
+}
+
 std::string BVertexCQ::name() const{
 	FuncBegin();
 	return "BVertexCQ " + nameB();
@@ -258,15 +299,76 @@ void BVertexCP::assemP(Mat A, Vec b) {
 	FuncEnd();
 }
 
+void BVertexCP::assemPDist(Mat A, Vec b) {
+	FuncBegin();
+
+	double const *vals;
+
+	Error::code=MatGetRow(A,self_->idx,NULL,NULL,&vals);ERRCHK();
+	for (int i = 0 ; i < nConn_ ; i++) lhs_(i) = vals[i] ;
+	Error::code=MatRestoreRow(A,self_->idx,NULL,NULL,&vals);ERRCHK();
+	Error::code=VecGetValues(b, 1, &self_->idx, &rhs_);ERRCHK();
+	Error::code=VecSetValue(b , self_->idx, p_, INSERT_VALUES);ERRCHK();
+	
+	FuncEnd();
+}
+
+void BVertexCP::assemP(Vec b) {
+	FuncBegin();
+
+	Error::code=VecGetValues(b, 1, &self_->idx, &rhs_);ERRCHK();
+	Error::code=VecSetValue(b , self_->idx, p_, INSERT_VALUES);ERRCHK();
+	
+	FuncEnd();
+}
+
+void BVertexCP::resetLhsP() {
+	FuncBegin();
+	lhs_.zeros();
+	FuncEnd();
+}
+
+void BVertexCP::addLhsP(const arma::ivec &idx, const arma::mat &lhs, const int k) {
+	FuncBegin();
+
+	int l;
+	for (int j = 0 ; j < (int)idx.n_elem ; j++){
+		for (l = 0 ; l < nConn_ ; l++) if (conn_(l) == idx(j)) break;
+		if (l == nConn_){
+			Error::mess << "node " << idx(j) << " is not connected to bvertex " << self_->idx;
+			ERRSET();
+		}
+		lhs_(l) += lhs(k,j);
+	}
+
+	FuncEnd();
+}
+
 void BVertexCP::constructGeoParams(const double dp, Mat A,const Gravity &grav){
 	FuncBegin();
 
+	constructL();
+	constructNA(grav);
+	constructConn(A);
+
+	FuncEnd();
+}
+
+void BVertexCP::setGeoParams(const double *v, Node *pre, Node *next, const double dp, Mat A){
+	FuncBegin();
+
+	BVertexCQ::setGeoParams(v, pre, next, dp, A);
+	constructConn(A);
+
+	FuncEnd();
+}
+
+void BVertexCP::constructConn(Mat A){
+	FuncBegin();
+
 	int const *conn;
 	int nconn;
 
-	constructL();
-	constructNA(grav);
-	
 	Error::code=MatGetRow(A,self_->idx,&nconn,&conn,NULL);ERRCHK();
 	nConn_ = nconn;
 	lhs_.resize(nConn_);
@@ -278,6 +380,10 @@ void BVertexCP::constructGeoParams(const double dp, Mat A,const Gravity &grav){
 	FuncEnd();
 }
 
+void BVertexCP::updateValue(const double dp){
+	p_ = reg_->val[0];
+}
+
 std::string BVertexCP::name() const{
 	FuncBegin();
 
@@ -105,6 +105,19 @@ public:
 	 */
 	virtual void findQAll(const std::vector<double> &F, double const * const P,
 						  const std::vector<double> &Lw , const std::vector<double> &Ln);
+	/** @brief derivative of mGammaW with respect to the master saturation.
+		
+		mGamma (i.e. P) is kept constant. For constant saturation vertices the
+		S equation is not solved so 0 is returned.
+		@param Lw the value of wetting phase mobilities.
+		@param Ln the value of non-wetting phase mobilites.
+		@param dLw derivative of Lw with respect to the master saturation.
+		@param dLn derivative of Ln with respect to the master saturation.
+	 */
+	double dQW(const std::vector<double> &Lw , const std::vector<double> &Ln,
+			   const std::vector<double> &dLw , const std::vector<double> &dLn) const;
+	/** @brief returns true if the vertex enforces a constant saturation */
+	bool isSConst() const {return reg_->stype == RegionBoundary::SSConst;}
 	/** @brief adds the contribution of the vertex to the S equation.
 		
 		@param F the RHS of S equation.
@@ -116,6 +129,38 @@ public:
 		@param b RHS of P equation.
 	*/
 	virtual void assemP(Mat A, Vec b);
+	/** @brief adds the contribution of the vertex to a matrix-free P equation.
+		
+		Same as assemP(Mat, Vec), but only the rhs is changed. The matrix-free
+		operator is responsible for the row of the vertex.
+		@param b RHS of P equation.
+	*/
+	virtual void assemP(Vec b);
+	/** @brief adds the contribution of the vertex to a distributed P equation.
+		
+		Same as assemP(Mat, Vec), but the row of A is not zeroed. MatZeroRows is
+		collective, so the caller zeros the rows of all the constant p vertices
+		at once. The constant p vertices insert in b and the others add to it,
+		so they should be called between separate assemblies of b.
+		@param A LHS of P equation.
+		@param b RHS of P equation.
+	*/
+	virtual void assemPDist(Mat A, Vec b) { assemP(A, b); }
+	/** @brief clears the lhs row stored for a matrix-free P equation. */
+	virtual void resetLhsP() {}
+	/** @brief adds one row of an element lhs matrix to the stored lhs row.
+		
+		Used instead of reading the row from the assembled matrix when the P
+		equation is solved matrix-free.
+		@param idx global indices of the element nodes.
+		@param lhs local lhs matrix of the element.
+		@param k the local row that belongs to the vertex.
+	*/
+	virtual void addLhsP(const arma::ivec &idx, const arma::mat &lhs, const int k) {}
+	/** @brief returns true if the vertex enforces a constant pressure */
+	virtual bool isPConst() const {return false;}
+	/** @brief index of the node that is the vertex */
+	int idx() const {return self_->idx;}
 	/** @brief adds a neighbour to the vertex.
 		
 		@param nd the neighbour to be added.
@@ -144,6 +189,28 @@ public:
 		@note this function must be called after addNeigh, checkPre and checkNext. 
 	 */
 	virtual void constructGeoParams(const double dp, Mat A, const Gravity &grav);
+	/** @brief number of doubles geoParams writes */
+	static const int nGeo = 4;
+	/** @brief the previous node connected to the vertex, NULL if none */
+	Node* pre() const {return pre_;}
+	/** @brief the next node connected to the vertex, NULL if none */
+	Node* next() const {return next_;}
+	/** @brief writes what constructGeoParams found to v: length, nA and kdgdzna */
+	void geoParams(double *v) const;
+	/** @brief sets what checkPre, checkNext and constructGeoParams would find.
+		
+		@param v written by geoParams
+		@param pre the previous node, as checkPre and checkNext left it
+		@param next the next node, as checkPre and checkNext left it
+		@param dp the dimensionless p number
+		@param A a global assembles matrix (the content is not important)
+	 */
+	virtual void setGeoParams(const double *v, Node *pre, Node *next, const double dp, Mat A);
+	/** @brief reads the value of the boundary region again, after it was changed.
+		
+		@param dp the dimensionless p number
+	*/
+	virtual void updateValue(const double dp);
 	/** @brief returns the description of the vertex in text form.
 	 */
 	virtual std::string name() const;
@@ -192,12 +259,21 @@ protected:
 
 	/** @brief This constructor should not be called */
 	BVertexCP() {}
+	/** @brief finds the neighbours of the vertex from the row of A */
+	void constructConn(Mat A);
 	
 public:
 	void findQAll(const std::vector<double> &F, double const * P,
 				  const std::vector<double> &Lw , const std::vector<double> &Ln);
 	void assemP(Mat A, Vec b) ;
+	void assemP(Vec b) ;
+	void assemPDist(Mat A, Vec b) ;
+	void resetLhsP();
+	void addLhsP(const arma::ivec &idx, const arma::mat &lhs, const int k);
+	bool isPConst() const {return true;}
 	void constructGeoParams(const double dp, Mat A, const Gravity &grav);
+	void setGeoParams(const double *v, Node *pre, Node *next, const double dp, Mat A);
+	void updateValue(const double dp);
 	std::string name() const;
 	/** @brief creates a bvertex and informs the node it belongs to.
 		@param nd the self node
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Puts a case in the job directory of a df2d daemon and waits for it.
+# Part of DF_2d.
+#
+# usage: df2d-submit.sh <job dir> <case dir> [name]
+#
+# The daemon is started with: df2d -df2d_daemon <job dir>
+# The results are written in <case dir>/result, as df2d -d <case dir> does,
+# and the output of df2d in <job dir>/<name>.log.
+# Returns 0 if the job finished and 1 if it failed.
+
+if [ $# -lt 2 ]; then
+	echo "usage: $0 <job dir> <case dir> [name]" >&2
+	exit 2
+fi
+jobdir=$1
+casedir=$(cd "$2" && pwd) || exit 2
+name=${3:-$(date +%Y%m%d%H%M%S)-$$}
+
+# the daemon only sees the job once it is complete
+echo "$casedir" > "$jobdir/$name.tmp" || exit 2
+mv "$jobdir/$name.tmp" "$jobdir/$name.job"
+
+while [ ! -e "$jobdir/$name.done" ] && [ ! -e "$jobdir/$name.fail" ]; do
+	sleep 0.2
+done
+cat "$jobdir/$name.log"
+[ -e "$jobdir/$name.done" ]
@@ -12,6 +12,12 @@ int main(int argc, char *argv[]){
 	Mesh msh; //external variables
 	
 	driver::initialize(&argc,&argv,md); //initialize all the data
+	if (!md.dmnDir.empty()){            //keep running the jobs of other df2d calls
+		driver::daemon(md);
+		md.finalize();
+		PetscFinalize();
+		return 0;
+	}
 	driver::readregion(md,msh);         //read the regions
 	driver::readfixed(md);              //read other solver properties
 	driver::readmesh(md,msh);           //read the mesh
@@ -20,17 +26,21 @@ int main(int argc, char *argv[]){
     if(md.setfield){                    //we should change the initial conditions
 		driver::setfield(md, msh);     
 	}
+	else if (md.ensN > 0){              //many runs on the same mesh
+		driver::ensemble(md, msh);
+	}
 	else{                               //we should run a simulation
-		driver::preparedata(md,msh);
-		do{
-			driver::marchintime(md, msh);        //solve the system once in time
-			driver::writeintime(md, msh,false);  //write the data if required
-		}	while ( md.t < md.tEnd);
+		driver::solve(md, msh);
 	}
 
 	//anounce that everything is done
-	std::cout << "Simulation finished successfully in " << md.cT << " seconds." << std::endl
-			  << "The results can be found in " << md.dir << "result/(*.vtk and *.flow)" << std::endl ;
+	if (md.ensN > 0)
+		std::cout << "The results can be found in " << md.dir << "member*/result/" << std::endl;
+	else std::cout << "Simulation finished successfully in " << md.cT << " seconds." << std::endl
+			  << "Time steps: " << md.nStep << " pressure solves: " << md.nPSolve << std::endl
+			  << "Rejected steps: " << md.nDtRej << " limited steps: " << md.nDtLim << std::endl
+			  << "Newton iterations (implicit S): " << md.nSNESIt << std::endl
+			  << "The results can be found in " << md.dir << "result/(*.vtk, *.flow, *.dt and *.scaling)" << std::endl ;
 	
 	//finalize petsc and other data
 	md.finalize();
@@ -7,16 +7,36 @@
 
 #include "driver.hpp"
 #include "asciifile.hpp"
+#include "mapfile.hpp"
+#include "lossy.hpp"
+#include "series.hpp"
 #include "geom.hpp"
 #include "visit_writer.h"
+#include <petsctime.h>
 
 #include <string>
 #include <sstream>
 #include <fstream>
 #include <iostream>
 #include <cstring>
+#include <cstddef>
+#include <cctype>
 #include <iomanip>
 #include <ctime>
+#include <algorithm>
+#include <map>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 using std::string;
 using std::cout;
@@ -37,6 +57,41 @@ using std::fixed;
 
 static const char swidir[] = "-d";
 static const char swisetf[] = "-s";
+static const char swipdirect[] = "-df2d_pdirect";
+static const char swipdirectlag[] = "-df2d_pdirect_lag";
+static const char swipdirectpkg[] = "-df2d_pdirect_package";
+static const char swipshell[] = "-df2d_pshell";
+static const char swipupdate[] = "-df2d_pupdate_tol";
+static const char swiltsmax[] = "-df2d_lts_max";
+static const char swidtctrl[] = "-df2d_dt_controller";
+static const char swidtsafe[] = "-df2d_dt_safety";
+static const char swisscheme[] = "-df2d_s_scheme";
+static const char swisimpds[] = "-df2d_s_implicit_dsmax";
+static const char swirktol[] = "-df2d_rk_tol";
+static const char swisteadytol[] = "-df2d_steady_tol";
+static const char swisteadywin[] = "-df2d_steady_window";
+static const char swisteadyact[] = "-df2d_steady_action";
+static const char swisteadyptc[] = "-df2d_steady_ptc_tol";
+static const char swisteadyptcmax[] = "-df2d_steady_ptc_max";
+static const char swipr[] = "-df2d_parareal";
+static const char swiprnp[] = "-df2d_parareal_np";
+static const char swiprtol[] = "-df2d_parareal_tol";
+static const char swiprcoarse[] = "-df2d_parareal_coarse";
+static const char swithreads[] = "-df2d_threads";
+static const char swiens[] = "-df2d_ensemble";
+static const char swiensnp[] = "-df2d_ensemble_np";
+static const char swicacheoff[] = "-df2d_cache_off";
+static const char swimeshimg[] = "-df2d_mesh_image";
+static const char swickpt[] = "-df2d_checkpoint";
+static const char swickptwall[] = "-df2d_checkpoint_wall";
+static const char swiresume[] = "-df2d_resume";
+static const char swioutasync[] = "-df2d_output_async";
+static const char swilossy[] = "-df2d_output_lossy";
+static const char swidelta[] = "-df2d_output_delta";
+static const char swideltatol[] = "-df2d_output_delta_tol";
+static const char swidmn[] = "-df2d_daemon";
+static const char swidmnnp[] = "-df2d_daemon_np";
+static const char swidmncache[] = "-df2d_daemon_cache";
 static const char help[] = "DF_2d written by Shayan Hoshyari \n Please consult the doxygen documentation.";
 
 static const string adrsol = "solver.config";
@@ -100,6 +155,20 @@ static int cell2visit(const CellType c){
 		return 0;
 	}
 }
+/** @brief convert CellType to the XDMF type of a cell in a Mixed topology */
+static int cell2xdmf(const CellType c){
+	switch(c){
+	case CellLine:
+		return 2;  //Polyline, followed by its number of points
+	case CellTri:
+		return 4;
+	case CellQuad:
+		return 5;
+	default:
+		ERRSET();
+		return 0;
+	}
+}
 /* @brief convert CellType to tecplot */
 static int cell2tecplot(const CellType c){
 	ERRSET();
@@ -147,13 +216,81 @@ static KFunc* readregion_kr(AsciiFile &cfile){
 	FuncEnd();
 }
 
-/** @brief  read a triangle mesh */
-static void readmesh_triangle(MData& md,Mesh &msh){
+/** @brief nodes and elements as they are read from the mesh files, kept to write the mesh image */
+struct MeshRecord{
+	static const int eleSize = 2 + (int)CellQuad; /**< @brief ints of each element */
+	vector<double> xy;  /**< @brief x and y of each node */
+	vector<int> ele;    /**< @brief region ID, cell type and nodes of each element, eleSize ints */
+
+	/** @brief records a node */
+	void addNode(const double x, const double y){
+		xy.push_back(x);
+		xy.push_back(y);
+	}
+	/** @brief records an element */
+	void addElement(const int regid, const int ndidx[], const CellType celltype){
+		ele.push_back(regid);
+		ele.push_back(celltype);
+		for (int i = 0 ; i < (int)CellQuad ; i++) ele.push_back( i < (int)celltype ? ndidx[i] : -1 );
+	}
+};
+
+/** @brief reads lines[i] with f(lines[i], i) for every i.
+
+	Long sections are split between md.nthread threads, so f must only write
+	to the i-th entry of its outputs. f returns NULL, or the name of the field
+	it could not read, and the error is raised for the first bad line with the
+	same message as MapFile.
+ */
+template<class F>
+static void parse_lines(MData &md, MapFile &fl, vector<MapLine> &lines, F f){
+	FuncBegin();
+
+	const int n = lines.size(), np = ( n < 65536 ? 1 : std::max(md.nthread, 1) );
+	vector<int> bad(np, n);
+	vector<const char*> name(np, (const char*)NULL);
+	std::function<void(int)> part = [&](const int t){
+		for (int i = (long)n * t / np ; i < (long)n * (t+1) / np ; i++)
+			if ( (name[t] = f(lines[i], i)) ){
+				bad[t] = i;
+				return;
+			}
+	};
+
+	if (np > 1){
+		ThreadPool pool(np);
+		pool.run(part);
+	}
+	else part(0);
+	for (int t = 0 ; t < np ; t++)
+		if (name[t]){
+			Error::mess << fl.fn << " at line " << lines[bad[t]].ln << ". Failed to read " << name[t];
+			ERRSET();
+		}
+
+	FuncEnd();
+}
+
+/** @brief number of nodes of a gmsh element type, 0 if it is not supported */
+static int gmsh_nnode(const int c){
+	switch(c){
+	case 1: return 2;
+	case 2: return 3;
+	case 3: return 4;
+	case 15: return 1;
+	default: return 0;
+	}
+}
+
+/** @brief  read a triangle mesh, and record it in rec if it is not NULL */
+static void readmesh_triangle(MData& md,Mesh &msh, MeshRecord *rec){
 	FuncBegin();
 
-	AsciiFile fl;
-	int size,idx0,ndidx[3],offset,bndmarker;
-	double x,y;
+	MapFile fl;
+	vector<MapLine> lines;
+	vector<int> id;
+	vector<double> xy;
+	int size,ndidx[3],offset;
 
 	/*
 	  read the node file
@@ -164,13 +301,20 @@ static void readmesh_triangle(MData& md,Mesh &msh){
 	*/
 	fl.open(md.dir+adrmesh+".node");
 	fl(); fl(size,"<# of vertices>");
+	fl.lines(size, lines);
+	id.resize(size);
+	xy.resize(2*size);
+	parse_lines(md, fl, lines, [&](MapLine &l, const int i) -> const char*{
+		if (!l(id[i])) return "<vertex #>";
+		if (!l(xy[2*i])) return "x";
+		if (!l(xy[2*i+1])) return "y";
+		return NULL;
+	});
+	offset = ( size ? id[0] : 0 );
 	msh.reserveNodes(size);
-	fl(); fl(idx0,"<vertex #>"); fl(x,"x"); fl(y,"y");
-	offset = idx0;
-	msh.addNode(x, y, idx0-offset);
-	for (int i = 1 ; i < size ; i++){
-	    fl(); fl(idx0,"<vertex #>"); fl(x,"x"); fl(y,"y");
-		msh.addNode(x, y, idx0-offset);
+	for (int i = 0 ; i < size ; i++){
+		msh.addNode(xy[2*i], xy[2*i+1], id[i]-offset);
+		if (rec) rec->addNode(xy[2*i], xy[2*i+1]);
 	}
 	fl.close();
 
@@ -183,12 +327,20 @@ static void readmesh_triangle(MData& md,Mesh &msh){
 	*/
 	fl.open(md.dir+adrmesh+".ele");
 	fl(); fl(size,"<# of triangles>");
+	fl.lines(size, lines);
+	id.resize(5*size);
+	parse_lines(md, fl, lines, [&](MapLine &l, const int i) -> const char*{
+		if (!l(id[5*i])) return "<triangle #>";
+		if (!l(id[5*i+1])) return "<node1>";
+		if (!l(id[5*i+2])) return "<node2>";
+		if (!l(id[5*i+3])) return "<node3>";
+		if (!l(id[5*i+4])) return "[attribute0]";
+		return NULL;
+	});
 	for (int i = 0 ; i < size ; i++){
-	    fl(); fl(idx0,"<triangle #>");
-		fl(ndidx[0],"<node1>"); fl(ndidx[1],"<node2>"); fl(ndidx[2],"<node3>");
-		fl(bndmarker,"[attribute0]");
-		ndidx[0]-=offset; ndidx[1]-=offset; ndidx[2]-=offset;
-		msh.addElement(bndmarker,ndidx, CellTri, fl.ln);
+		ndidx[0] = id[5*i+1]-offset; ndidx[1] = id[5*i+2]-offset; ndidx[2] = id[5*i+3]-offset;
+		msh.addElement(id[5*i+4],ndidx, CellTri, lines[i].ln);
+		if (rec) rec->addElement(id[5*i+4], ndidx, CellTri);
 	}
 	fl.close();
 
@@ -206,28 +358,330 @@ static void readmesh_triangle(MData& md,Mesh &msh){
 	fl(); fl(size,"<# of vertices>");
 	for (int i = 0 ; i < size ; i++) fl();
 	fl(); fl(size,"<# of segments>");
+	fl.lines(size, lines);
+	id.resize(4*size);
+	parse_lines(md, fl, lines, [&](MapLine &l, const int i) -> const char*{
+		if (!l(id[4*i])) return "<segment #>";
+		if (!l(id[4*i+1])) return "<start point>";
+		if (!l(id[4*i+2])) return "<end point>";
+		if (!l(id[4*i+3])) return "[bndmarker]";
+		return NULL;
+	});
 	for (int i = 0 ; i < size ; i++){
-		fl(); fl(idx0,"<segment #>");
-		fl(ndidx[0],"<start point>"); fl(ndidx[1],"<end point>"); 
-		fl(bndmarker,"[bndmarker]");
-		ndidx[0]-=offset; ndidx[1]-=offset; 
-		msh.addElement(bndmarker,ndidx, CellLine, fl.ln);
+		ndidx[0] = id[4*i+1]-offset; ndidx[1] = id[4*i+2]-offset;
+		msh.addElement(id[4*i+3],ndidx, CellLine, lines[i].ln);
+		if (rec) rec->addElement(id[4*i+3], ndidx, CellLine);
 	}
 	fl.close();
 	
 	FuncEnd();
 }
 
-/** @brief  read a gmsh mesh */
-static void readmesh_gmsh(MData& md,Mesh &msh){
+/** @brief reads the numbers of a gmsh 4.1 file.
+
+	From the lines of an ascii file, where a number may be on the next line,
+	or straight from the bytes of a binary one. The long blocks of nodes and
+	elements are read at once, with parse_lines for an ascii file.
+ */
+class GmshReader{
+	MData &md_;         /**< @brief for the number of threads */
+	MapFile &fl_;       /**< @brief the file */
+	const bool bin_;    /**< @brief the file is binary */
+	const int sz_;      /**< @brief bytes of a size_t in a binary file */
+	const char *p_;     /**< @brief next byte of a binary file */
+
+	/** @brief checks that n more bytes are in a binary file */
+	void need(const size_t n){
+		FuncBegin();
+		if (p_ + n > fl_.end()){
+			Error::mess << fl_.fn << " ended unexpectedly.";
+			ERRSET();
+		}
+		FuncEnd();
+	}
+	/** @brief next binary value of type T */
+	template<class T>
+	T bin(){
+		T x;
+		need(sizeof(T));
+		memcpy(&x, p_, sizeof(T));
+		p_ += sizeof(T);
+		return x;
+	}
+	/** @brief next ascii value, on this line or the next one */
+	template<class T>
+	T asc(const char *name){
+		FuncBegin();
+		T x;
+		while (fl_.ls.p < fl_.ls.e && isspace(*fl_.ls.p)) fl_.ls.p++;
+		if (fl_.ls.p == fl_.ls.e) fl_();
+		fl_(x, name);
+		return x;
+		FuncEnd();
+	}
+public:
+	/** @brief reads fl, whose current line is the $MeshFormat version */
+	GmshReader(MData &md, MapFile &fl, const bool bin, const int sz):
+		md_(md), fl_(fl), bin_(bin), sz_(sz), p_(fl.pos()){}
+	/** @brief moves to the data of a section */
+	void begin(const string &name){
+		FuncBegin();
+		if (bin_) fl_.seek(p_);
+		fl_.efind(name);
+		p_ = fl_.pos();
+		FuncEnd();
+	}
+	/** @brief checks the end of a section */
+	void end(const string &name){
+		FuncBegin();
+		if (bin_) fl_.seek(p_);
+		fl_(); fl_(name);
+		p_ = fl_.pos();
+		FuncEnd();
+	}
+	/** @brief an int */
+	int i(const char *name)
+		{ return ( bin_ ? bin<int32_t>() : asc<int>(name) ); }
+	/** @brief a size_t */
+	int z(const char *name)
+		{ return ( bin_ ? (sz_ == 8 ? (int)bin<uint64_t>() : (int)bin<uint32_t>()) : asc<int>(name) ); }
+	/** @brief a double */
+	double d(const char *name)
+		{ return ( bin_ ? bin<double>() : asc<double>(name) ); }
+	/** @brief a block of n nodes, with np parametric coordinates.
+		@param tag output, tag of each node
+		@param xy output, x and y of each node
+	*/
+	void nodes(const int n, const int np, vector<int> &tag, vector<double> &xy){
+		FuncBegin();
+		vector<MapLine> lines;
+		tag.resize(n);
+		xy.resize(2*n);
+		if (bin_){
+			for (int k = 0 ; k < n ; k++) tag[k] = z("node tag");
+			need( (size_t)n * (3 + np) * sizeof(double) );
+			for (int k = 0 ; k < n ; k++, p_ += (3 + np) * sizeof(double))
+				memcpy(&xy[2*k], p_, 2 * sizeof(double));
+			return;
+		}
+		fl_.lines(n, lines);
+		parse_lines(md_, fl_, lines, [&](MapLine &l, const int k) -> const char*{
+			return ( l(tag[k]) ? NULL : "node tag" );
+		});
+		fl_.lines(n, lines);
+		parse_lines(md_, fl_, lines, [&](MapLine &l, const int k) -> const char*{
+			if (!l(xy[2*k])) return "x";
+			if (!l(xy[2*k+1])) return "y";
+			return NULL;
+		});
+		fl_.ls.p = fl_.ls.e;   //z and the parametric coordinates are not read
+		FuncEnd();
+	}
+	/** @brief a block of n elements with nn nodes.
+		@param v output, the tag and nn node tags of each element
+	*/
+	void elements(const int n, const int nn, vector<int> &v){
+		FuncBegin();
+		vector<MapLine> lines;
+		v.resize( (size_t)n * (1 + nn) );
+		if (bin_){
+			need( (size_t)n * (1 + nn) * sz_ );
+			for (size_t k = 0 ; k < v.size() ; k++) v[k] = z("node tag");
+			return;
+		}
+		fl_.lines(n, lines);
+		parse_lines(md_, fl_, lines, [&](MapLine &l, const int k) -> const char*{
+			if (!l(v[(1+nn)*k])) return "element tag";
+			for (int j = 1 ; j <= nn ; j++)
+				if (!l(v[(1+nn)*k+j])) return "node tag";
+			return NULL;
+		});
+		fl_.ls.p = fl_.ls.e;
+		FuncEnd();
+	}
+};
+
+/** @brief  read a gmsh 4.1 mesh, ascii or binary.
+
+	The region of an element is the first physical tag of its entity, and the
+	elements of an entity without one are not added. The nodes are numbered in
+	the order they appear in the file, and the elements of each block are
+	added at once.
+	@param fl the file, its current line is the version in $MeshFormat
+	@param bin the file is binary
+	@param sz data-size of the file
+ */
+static void readmesh_gmsh4(MData& md,Mesh &msh, MeshRecord *rec, MapFile &fl,
+						   const bool bin, const int sz){
+	FuncBegin();
+
+	GmshReader r(md, fl, bin, sz);
+	std::map<std::pair<int,int>, int> phys;
+	std::map<std::pair<int,int>, int>::iterator ph;
+	vector<int> tag, tag2pos, v, nd;
+	vector<double> xy;
+	int nent[4], nblock, nph, dim, etag, type, n, nn, ptag;
+
+	/*
+	  read the entities, for their physical tags
+
+	  the format is
+	  * $Entities
+	  * numPoints numCurves numSurfaces numVolumes
+	  * pointTag X Y Z numPhysicalTags physicalTag ...
+	  * tag minX minY minZ maxX maxY maxZ numPhysicalTags physicalTag ...
+	    numBoundingEntities tag ...
+	*/
+	r.begin("$Entities");
+	for (int j = 0 ; j < 4 ; j++) nent[j] = r.z("number of entities");
+	for (int j = 0 ; j < 4 ; j++)
+		for (int k = 0 ; k < nent[j] ; k++){
+			etag = r.i("entity tag");
+			for (int l = 0 ; l < (j ? 6 : 3) ; l++) r.d("bounding box");
+			nph = r.z("numPhysicalTags");
+			for (int l = 0 ; l < nph ; l++){
+				ptag = r.i("physical tag");
+				if (l == 0) phys[std::make_pair(j, etag)] = ptag;
+			}
+			if (j){
+				n = r.z("numBoundingEntities");
+				for (int l = 0 ; l < n ; l++) r.i("bounding entity tag");
+			}
+		}
+	r.end("$EndEntities");
+
+	/*
+	  read the nodes
+
+	  the format is
+	  * $Nodes
+	  * numEntityBlocks numNodes minNodeTag maxNodeTag
+	  * entityDim entityTag parametric numNodesInBlock
+	  * nodeTag ...
+	  * x y z [u v w] ...
+	*/
+	r.begin("$Nodes");
+	nblock = r.z("numEntityBlocks");
+	n = r.z("numNodes");
+	r.z("minNodeTag");
+	tag2pos.assign(r.z("maxNodeTag") + 1, -1);
+	msh.reserveNodes(n);
+	for (int b = 0 ; b < nblock ; b++){
+		dim = r.i("entityDim");
+		r.i("entityTag");
+		const int par = r.i("parametric");
+		n = r.z("numNodesInBlock");
+		r.nodes(n, (par ? dim : 0), tag, xy);
+		for (int k = 0 ; k < n ; k++){
+			if ( (tag[k] < 0) || (tag[k] >= (int)tag2pos.size()) ){
+				Error::mess << fl.fn << ": node tag " << tag[k] << " is larger than maxNodeTag";
+				ERRSET();
+			}
+			tag2pos[tag[k]] = msh.nnode();
+			msh.addNode(xy[2*k], xy[2*k+1], msh.nnode());
+			if (rec) rec->addNode(xy[2*k], xy[2*k+1]);
+		}
+	}
+	r.end("$EndNodes");
+
+	/*
+	  read the elements
+
+	  the format is
+	  * $Elements
+	  * numEntityBlocks numElements minElementTag maxElementTag
+	  * entityDim entityTag elementType numElementsInBlock
+	  * elementTag nodeTag ...
+	*/
+	r.begin("$Elements");
+	nblock = r.z("numEntityBlocks");
+	r.z("numElements"); r.z("minElementTag"); r.z("maxElementTag");
+	for (int b = 0 ; b < nblock ; b++){
+		dim = r.i("entityDim");
+		etag = r.i("entityTag");
+		type = r.i("elementType");
+		n = r.z("numElementsInBlock");
+		if ( !(nn = gmsh_nnode(type)) ){
+			Error::mess << fl.fn << ": gmsh element type " << type << " is not supported";
+			ERRSET();
+		}
+		r.elements(n, nn, v);
+		nd.resize( (size_t)n * nn );
+		for (int k = 0 ; k < n ; k++)
+			for (int j = 0 ; j < nn ; j++){
+				const int t = v[(1+nn)*k+1+j];
+				if ( (t < 0) || (t >= (int)tag2pos.size()) || (tag2pos[t] < 0) ){
+					Error::mess << fl.fn << ": element " << v[(1+nn)*k] << " has an unknown node " << t;
+					ERRSET();
+				}
+				nd[nn*k+j] = tag2pos[t];
+			}
+		ph = phys.find(std::make_pair(dim, etag));
+		ptag = ( ph == phys.end() ? 0 : ph->second );
+		if (n) msh.addElements(ptag, &nd[0], gmsh2cell(type), n);
+		if (rec)
+			for (int k = 0 ; k < n ; k++) rec->addElement(ptag, &nd[nn*k], gmsh2cell(type));
+	}
+	r.end("$EndElements");
+
+	FuncEnd();
+}
+
+/** @brief  read a gmsh mesh, and record it in rec if it is not NULL.
+
+	Reads the ascii 2 format, and hands the 4.1 format to readmesh_gmsh4.
+ */
+static void readmesh_gmsh(MData& md,Mesh &msh, MeshRecord *rec){
 	FuncBegin();
 
-	AsciiFile fl;
-	int size,idx0,ndidx[5],offset,bndmarker,sizetmp,bndmarkertmp, eletype;
+	const int es = 2 + (int)CellQuad;
+	MapFile fl;
+	vector<MapLine> lines;
+	vector<int> id;
+	vector<double> xy;
+	int size,ndidx[5],offset,ftype = 0,dsize = 8,one;
 	CellType celltype;
-	double x,y;
+	double ver = 2;
 
 	fl.open(md.dir+adrmesh+".msh");
+	/*
+	  read the format
+
+	  the format is
+	  * $MeshFormat
+	  * version-number file-type data-size
+	  * [the int 1 in binary, to check the byte order]
+	*/
+	if (fl.find("$MeshFormat")){
+		fl(); fl(ver, "version-number"); fl(ftype, "file-type"); fl(dsize, "data-size");
+	}
+	else fl.goto_beg();
+	if (ver >= 4){
+		if ( (ver < 4.1) || ( (dsize != 4) && (dsize != 8) ) ){
+			Error::mess << fl.fn << ": gmsh format " << ver << " with data-size " << dsize
+						<< " is not supported, use 2.2 or 4.1";
+			ERRSET();
+		}
+		if (ftype){
+			if (fl.pos() + sizeof(one) > fl.end()){
+				Error::mess << fl.fn << " ended unexpectedly.";
+				ERRSET();
+			}
+			memcpy(&one, fl.pos(), sizeof(one));
+			if (one != 1){
+				Error::mess << fl.fn << " was written on a machine with another byte order";
+				ERRSET();
+			}
+			fl.seek(fl.pos() + sizeof(one));
+		}
+		readmesh_gmsh4(md, msh, rec, fl, ftype != 0, dsize);
+		fl.close();
+		return;
+	}
+	if (ftype){
+		Error::mess << fl.fn << ": binary gmsh 2 files are not supported, use 4.1";
+		ERRSET();
+	}
 	/*
 	  read the nodes
 
@@ -238,13 +692,20 @@ static void readmesh_gmsh(MData& md,Mesh &msh){
 	*/
 	fl.efind("$Nodes");
 	fl(); fl(size,"no. of nodes");
+	fl.lines(size, lines);
+	id.resize(size);
+	xy.resize(2*size);
+	parse_lines(md, fl, lines, [&](MapLine &l, const int i) -> const char*{
+		if (!l(id[i])) return "idx";
+		if (!l(xy[2*i])) return "x";
+		if (!l(xy[2*i+1])) return "y";
+		return NULL;
+	});
+	offset = ( size ? id[0] : 0 );
 	msh.reserveNodes(size);
-	fl(); fl(idx0,"idx"); fl(x,"x"); fl(y,"y"); 
-	offset = idx0;
-	msh.addNode(x, y, idx0-offset);
-	for (int i = 1 ; i < size ; i++){
-		fl(); fl(idx0,"idx"); fl(x,"x"); fl(y,"y"); 
-		msh.addNode(x, y, idx0-offset);
+	for (int i = 0 ; i < size ; i++){
+		msh.addNode(xy[2*i], xy[2*i+1], id[i]-offset);
+		if (rec) rec->addNode(xy[2*i], xy[2*i+1]);
 	}
 
 	/*
@@ -254,284 +715,3196 @@ static void readmesh_gmsh(MData& md,Mesh &msh){
 	  * $Elements
 	  * # of elements
 	  * idx <type> <# of tags>  [tags-phys first] [nodes]
+
+	  each element is kept as <physical tag> <type> [nodes]
 	*/
-	fl.goto_beg();
-	fl(); fl.efind("$Elements");
+	if (!fl.find("$Elements")){
+		fl.goto_beg();
+		fl.efind("$Elements");
+	}
 	fl(); fl(size,"<# of elements>");
+	fl.lines(size, lines);
+	id.resize(es*size);
+	parse_lines(md, fl, lines, [&](MapLine &l, const int i) -> const char*{
+		int *e = &id[es*i], t, ntag, nn;
+		if (!l(t)) return "idx";
+		if (!l(e[1]) || !(nn = gmsh_nnode(e[1])) ) return "eletype";
+		if (!l(ntag)) return "tag size";
+		if (!l(e[0])) return "physical tag";
+		for (int j = 1 ; j < ntag ; j++)
+			if (!l(t)) return "unused tag";
+		for (int j = 0 ; j < nn ; j++)
+			if (!l(e[2+j])) return "node id";
+		return NULL;
+	});
 	for (int i = 0 ; i < size ; i++){
-		fl();
-		fl(idx0,"idx");
-		fl(eletype, "eletype"); celltype=gmsh2cell(eletype);
-		fl(sizetmp, "tag size");
-		fl(bndmarker, "physical tag");
-		for (int j = 1 ; j < sizetmp ; j++)
-			fl(bndmarkertmp,"unused tag");
-		for(int j = 0 ; j < (int)celltype ; j++){
-			fl(ndidx[j],"node id");
-			ndidx[j]-=offset;
-		}
-		msh.addElement(bndmarker, ndidx,celltype, fl.ln);
+		const int *e = &id[es*i];
+		celltype = gmsh2cell(e[1]);
+		for(int j = 0 ; j < (int)celltype ; j++) ndidx[j] = e[2+j] - offset;
+		msh.addElement(e[0], ndidx, celltype, lines[i].ln);
+		if (rec) rec->addElement(e[0], ndidx, celltype);
 	}
 	fl.close();
 
 	FuncEnd();
 }
 
+/** @brief reads the mesh files of md.meshtype into msh, without constructing it */
+static void readmesh_files(MData& md,Mesh &msh, MeshRecord *rec){
+	FuncBegin();
+
+	switch(md.meshtype){
+	case MData::MeshTriangle:
+		readmesh_triangle(md,msh, rec);
+		break;
+	case MData::MeshGmsh:
+		readmesh_gmsh(md,msh, rec);
+		break;
+	default:
+		Error::mess << "invalid mesh" ;
+		ERRSET();
+	}
+
+	FuncEnd();
+}
+
 /************************************************************************
  * writing stuff
  ************************************************************************/
-/** @brief writes a .vtk file.
- *
- * although this function allocates a lot of memmory it will not affect the
- * execution time much, as it will be called only a few times.
- */
-static void writevisual_vtk	(const char * address,MData& md,Mesh &msh){
-	FuncBegin();
+/** @brief names of the fields visual_fields finds */
+static const char *visual_names[] = {"Sw_node", "Sw_cell", "Pw", "qw", "qn", "qtotal"};
+/** @brief components of the fields visual_fields finds */
+static const int visual_dim[] = {1, 1, 1, 3, 3, 3};
+/** @brief 1 for the nodal fields, 0 for the cellwise ones */
+static const int visual_nodal[] = {1, 0, 1, 0, 0, 0};
+/** @brief number of fields visual_fields finds, field k is selected by flag 1 << k of md.outFields */
+static const int visual_nfield = 6;
+/** @brief which of md.lossyTol, for S, P or the velocities, bounds the error of the fields */
+static const int visual_tol[] = {0, 0, 1, 2, 2, 2};
 
-	int usebinary = 1; 
-	int npts;
-	float *pts;
-	int *celltypes;
-	int *conn;
-	int nvars = 2;
-	int vardim[] = { 1,1, 1,1,1, 3,3,3};
-	int centering[] = {0,1, 1,0,1, 0,0,0};
-	int i,j;
-
-	const char name1[] = "porous_region_no";
-	const char name2[] = "bnd_region_no";
-	const char name3[] = "Sw_node";
-	const char name4[] = "Sw_cell";
-	const char name5[] = "Pw";
-	const char name6[] = "qw";
-	const char name7[] = "qn";
-	const char name8[] = "qtotal";
-	const char *varnames[] = {name1,name2,name3,name4,name5,name6,name7,name8};
-
-	float *vars[8];
+/** @brief the points and the cells of a visual file.
 
-	const arma::ivec *idxele;
-	const arma::mat *kdarma;
-	const arma::vec *parma,*pcarma,*lnarma,*lwarma;
-	arma::vec2 vt , vn, vw;
+	With visualduplicate 0 there is a point for every duplicate, otherwise
+	one for every node, sorted by idx.
+	@param pts output, x y z of the points
+	@param bnd output, boundary region number of the points, -1 if none
+	@param cells output, CellType of the cells
+	@param conn output, the points of the cells, one after the other
+	@param reg output, porous region number of the cells
+*/
+static void visual_mesh(MData &md, Mesh &msh, vector<float> &pts, vector<float> &bnd,
+						vector<int> &cells, vector<int> &conn, vector<float> &reg){
+	FuncBegin();
 
-	//give number of points
-	npts = (md.visualduplicate ==0 ? msh.ndd() : msh.nnode());
+	const arma::ivec *idxele;
+	int i;
 
-	//allocate memory to mesh_node data
-	if (md.visualduplicate == 0 ){
-		vars[1] = new float [ msh.ndd() ];  //boundary region no
-		pts = new float [ 3 * msh.ndd() ];  //points
-		for (vector<Node>::iterator it = msh.begnode() ; it != msh.endnode() ; it++){
-			for (list<DuplData>::iterator l = it->dd.begin() ; l != it->dd.end() ; l++){				
+	//points
+	pts.assign(3 * (md.visualduplicate == 0 ? msh.ndd() : msh.nnode()), 0);
+	bnd.resize(pts.size() / 3);
+	for (vector<Node>::iterator it = msh.begnode() ; it != msh.endnode() ; it++){
+		const float b = ( it->bvertex ? (float) it->bvertex->reg_->ID : -1 );
+		if (md.visualduplicate == 0){
+			for (list<DuplData>::iterator l = it->dd.begin() ; l != it->dd.end() ; l++){
 				pts[3*l->idx] = (float)it->x;
 				pts[3*l->idx+1] = (float)it->y;
-				pts[3*l->idx+2] = 0;
-				vars[1][l->idx] = ( it->bvertex ?
-									(float) it->bvertex->reg_->ID :
-									-1 );
+				bnd[l->idx] = b;
 			}
 		}
-	}
-	else{
-		vars[1] = new float [ msh.nnode() ];  //boundary region no
-		pts = new float [ 3 * msh.nnode() ];  //points
-		i = 0;
-		for (vector<Node>::iterator it = msh.begnode() ; it != msh.endnode() ; it++){
+		else{
+			//points are sorted by idx, as in the connectivity
+			i = it->idx;
 			pts[3*i] = (float)it->x;
 			pts[3*i+1] = (float)it->y;
-			pts[3*i+2] = 0;
-			vars[1][i] = ( it->bvertex ?
-						   (float) it->bvertex->reg_->ID :
-						   -1 );
-			i++;
+			bnd[i] = b;
 		}
 	}
 
-	//allocate memory to mesh_element data
-	conn = new int [ msh.nele() * 4 ] ;    //connectivity
-	celltypes = new int [ msh.nele() ];    //cell type (vtk)
-	vars[0] = new float [ msh.nele() ];    //region_id
-	//fill mesh data
-	i = 0; j = 0;
-	for (list<eleblank*>::iterator it = msh.begele() ; it != msh.endele() ; it++){
-		celltypes[i] = cell2visit ( (*it)->cellType() );
-		vars[0][i] = (float) ( (*it)->regionID() ) ;
-	    if (md.visualduplicate == 0 ){
-			for (int k=0; k < (*it)->nNode() ; k++) {
-				conn[j] = (*it)->dupl(k)->idx;
-				j++;
-			}			
+	//cells
+	cells.resize(msh.nele());
+	reg.resize(msh.nele());
+	conn.clear();
+	conn.reserve(4 * msh.nele());
+	i = 0;
+	for (list<eleblank*>::iterator it = msh.begele() ; it != msh.endeleall() ; it++){
+		cells[i] = (*it)->cellType();
+		reg[i] = (float) ( (*it)->regionID() ) ;
+		if (md.visualduplicate == 0 ){
+			for (int k=0; k < (*it)->nNode() ; k++) conn.push_back( (*it)->dupl(k)->idx );
 		}
 		else{
 			idxele = &(*it)->idxGlob();
-			for (int k=0; k < (*it)->nNode() ; k++) {
-				conn[j] = (*idxele)(k);
-				j++;
-			}
+			for (int k=0; k < (*it)->nNode() ; k++) conn.push_back( (*idxele)(k) );
 		}
 		i++;
 	}
 
-	
+	FuncEnd();
+}
+
+/** @brief the fields of a visual file, named by visual_names.
+
+	Only the fields selected by md.outFields are computed, the velocities
+	only need Pc for qn and qtotal, and Lw and Ln for the phases they use.
+	@param f output, visual_nfield fields, a field md does not have or that
+	is not selected is left empty
+*/
+static void visual_fields(MData &md, Mesh &msh, vector<float> f[]){
+	FuncBegin();
+
+	const arma::mat *kdarma;
+	const arma::vec *parma,*pcarma,*lnarma,*lwarma;
+	arma::vec2 vt , vn, vw;
+	int i;
+	const bool w = md.outFields & (MData::OutQw | MData::OutQtotal),
+		n = md.outFields & (MData::OutQn | MData::OutQtotal);
+
+	for (i = 0 ; i < visual_nfield ; i++) f[i].clear();
+
 	//Saturation
-	if (md.S.size() > 0){
-		nvars+=2;
+	if ( (md.S.size() > 0) && (md.outFields & MData::OutSwNode) ){
 		//nodewise S
 		if (md.visualduplicate == 0){
-			vars[2] = new float[ msh.ndd() ] ;
+			f[0].resize( msh.ndd() );
 			for (vector<Node>::iterator it = msh.begnode() ; it != msh.endnode() ; it++){
 				for (list<DuplData>::iterator l = it->dd.begin() ; l != it->dd.end() ; l++)
-					vars[2][l->idx] = (float)md.S.at(l->idx);
+					f[0][l->idx] = (float)md.S.at(l->idx);
 			}
 		}
 		else{
-			vars[2] = new float[ msh.nnode() ] ;
-			i = 0;
+			f[0].resize( msh.nnode() );
 			for (vector<Node>::iterator it = msh.begnode() ; it != msh.endnode() ; it++){
 				if (md.visualduplicate == 1)
-					vars[2][i] = (float)fmin( md.S.at( it->dd.front().idx ) ,
-											  md.S.at( it->dd.back().idx ) );
+					f[0][it->idx] = (float)fmin( md.S.at( it->dd.front().idx ) ,
+												 md.S.at( it->dd.back().idx ) );
 				else
-					vars[2][i] = (float)fmax( md.S.at( it->dd.front().idx ) ,
-											  md.S.at( it->dd.back().idx ) );				
-				i++;
+					f[0][it->idx] = (float)fmax( md.S.at( it->dd.front().idx ) ,
+												 md.S.at( it->dd.back().idx ) );
 			}
 		}
+	}
+	if ( (md.S.size() > 0) && (md.outFields & MData::OutSwCell) ){
 		//cellwise S
-		vars[3] = new float[ msh.nele() ] ;
+		f[1].resize( msh.nele() );
 		i = 0;
-		for (list<eleblank*>::iterator it = msh.begele() ; it != msh.endele() ; it++){
-		    vars[3][i] = arma::mean( (*it)->lDatCnDis(md.S, 0) );
+		for (list<eleblank*>::iterator it = msh.begele() ; it != msh.endeleall() ; it++){
+			f[1][i] = arma::mean( (*it)->lDatCnDis(md.S, 0) );
 			i++;
 		}
 	}
 
 	//Pressure
-	if (md.P != NULL){
-		nvars++;
-	    if (md.visualduplicate == 0){
-			vars[4] = new float[ msh.ndd() ] ;
+	if ( (md.P != NULL) && (md.outFields & MData::OutPw) ){
+		if (md.visualduplicate == 0){
+			f[2].resize( msh.ndd() );
 			for (vector<Node>::iterator it = msh.begnode() ; it != msh.endnode() ; it++)
 				for (list<DuplData>::iterator l = it->dd.begin() ; l != it->dd.end() ; l++)
-					vars[4][l->idx] = (float)md.P[it->idx];
-					
+					f[2][l->idx] = (float)md.P[it->idx];
 		}
 		else{
-			vars[4] = new float[ msh.nnode() ] ;
-			for (i = 0 ; i < msh.nnode() ; i++ ) vars[4][i] = (float)md.P[i];
+			f[2].resize( msh.nnode() );
+			for (i = 0 ; i < msh.nnode() ; i++ ) f[2][i] = (float)md.P[i];
 		}
 	}
-	
-	
+
 	//cellwise phase velocity
-	if ((md.Lw.size() > 0) && (md.Ln.size() > 0)){
-		nvars+=3;
-		//allocate memmory for water, oil and total velocity
-		vars[5] = new float[ msh.nele() * 3] ;
-		vars[6] = new float[ msh.nele() * 3] ;
-		vars[7] = new float[ msh.nele() * 3] ;
-		//find v
-		i = 0; 
-		for (list<eleblank*>::iterator it = msh.begele() ; it != msh.endele() ; it++){
+	if ( (w || n) && (md.P != NULL) && (!w || (md.Lw.size() > 0)) && (!n || (md.Ln.size() > 0)) ){
+		//water, oil and total velocity
+		for (int k = 3 ; k < 6 ; k++)
+			if (md.outFields & (1 << k)) f[k].assign( 3 * msh.nele(), 0 );
+		vw.zeros(); vn.zeros();
+		i = 0;
+		for (list<eleblank*>::iterator it = msh.begele() ; it != msh.endeleall() ; it++){
 			parma = &(*it)->lDatCnCon(md.P, 0);
-			pcarma = &(*it)->lDatCnDis(md.Pc, 1);
-			lwarma = &(*it)->lDatCnDis(md.Lw, 2);
-			lnarma = &(*it)->lDatCnDis(md.Ln, 3);
 			kdarma = &(*it)->matKD();
-			vw = -arma::mean(*lwarma) * (*kdarma) * (*parma) / md.dp ;
-			vn = -arma::mean(*lnarma) * (*kdarma) * (  *parma  +  *pcarma  ) / md.dp ;
+			if (w){
+				lwarma = &(*it)->lDatCnDis(md.Lw, 2);
+				vw = -arma::mean(*lwarma) * (*kdarma) * (*parma) / md.dp ;
+			}
+			if (n){
+				pcarma = &(*it)->lDatCnDis(md.Pc, 1);
+				lnarma = &(*it)->lDatCnDis(md.Ln, 3);
+				vn = -arma::mean(*lnarma) * (*kdarma) * (  *parma  +  *pcarma  ) / md.dp ;
+			}
 			vt = vw + vn ;
-		    vars[5][3*i] = (float)vw(0); vars[5][3*i+1] = (float)vw(1); vars[5][3*i+2] = 0;
-			vars[6][3*i] = (float)vn(0); vars[6][3*i+1] = (float)vn(1); vars[6][3*i+2] = 0;
-			vars[7][3*i] = (float)vt(0); vars[7][3*i+1] = (float)vt(1); vars[7][3*i+2] = 0; 
+			if (!f[3].empty()){ f[3][3*i] = (float)vw(0); f[3][3*i+1] = (float)vw(1); }
+			if (!f[4].empty()){ f[4][3*i] = (float)vn(0); f[4][3*i+1] = (float)vn(1); }
+			if (!f[5].empty()){ f[5][3*i] = (float)vt(0); f[5][3*i+1] = (float)vt(1); }
 			i++;
-		}		
+		}
+	}
+
+	FuncEnd();
+}
+
+/** @brief writes a .vtk file.
+ *
+ * although this function allocates a lot of memmory it will not affect the
+ * execution time much, as it will be called only a few times.
+ */
+static void writevisual_vtk	(const char * address,MData& md,Mesh &msh){
+	FuncBegin();
+
+	vector<float> pts, bnd, reg, f[visual_nfield];
+	vector<int> cells, conn;
+	float *vars[2 + visual_nfield];
+	const char *varnames[2 + visual_nfield];
+	int vardim[2 + visual_nfield], centering[2 + visual_nfield];
+	int nvars = 2;
+
+	visual_mesh(md, msh, pts, bnd, cells, conn, reg);
+	visual_fields(md, msh, f);
+	for (size_t i = 0 ; i < cells.size() ; i++) cells[i] = cell2visit( (CellType)cells[i] );
+
+	//the region numbers and the fields md has
+	varnames[0] = "porous_region_no"; vars[0] = &reg[0]; vardim[0] = 1; centering[0] = 0;
+	varnames[1] = "bnd_region_no"; vars[1] = &bnd[0]; vardim[1] = 1; centering[1] = 1;
+	for (int k = 0 ; k < visual_nfield ; k++){
+		if (f[k].empty()) continue;
+		varnames[nvars] = visual_names[k];
+		vars[nvars] = &f[k][0];
+		vardim[nvars] = visual_dim[k];
+		centering[nvars] = visual_nodal[k];
+		nvars++;
 	}
-	
 
 	//write the mesh using VisIt writer
-	write_unstructured_mesh(address, usebinary,
-						    npts, pts,
-							msh.nele(), celltypes, conn,
+	write_unstructured_mesh(address, 1,
+							pts.size() / 3, &pts[0],
+							cells.size(), &cells[0], &conn[0],
 							nvars, vardim, centering, varnames, vars);
 
-	//clear the data
-	delete[] pts;
-	delete[] celltypes;
-	delete[] conn;
-	for (i = 0 ; i < nvars ; i++ ) delete[] vars[i];
-
 	FuncEnd();
 }
 
-/** @brief  writes a gmsh visualization file */
-static void writevisual_gmsh(const char * address,MData& md,Mesh &msh){
-	cell2gmsh(CellTri);
-	ERRSET();
+/** @brief byte order of this machine, as XDMF names it */
+static const char* xdmf_endian(){
+	const uint16_t one = 1;
+	return ( *(const char*)&one ? "Little" : "Big" );
 }
 
-/** @brief  writes a tecplot visualization file */
-static void writevisual_tecplot (const char * address,MData& md,Mesh &msh){
-	cell2tecplot(CellTri);
-	ERRSET();
+/** @brief writes an XDMF DataItem of a binary file.
+	@param dim dimensions, e.g. "10 3"
+	@param type NumberType, Int or Float
+	@param seek offset of the data in the file, in bytes
+	@param fn name of the file, relative to the .xmf file
+*/
+static void xdmf_item(fstream &fl, const string &dim, const char *type, const size_t seek, const string &fn){
+	fl << "     <DataItem Dimensions=\"" << dim << "\" NumberType=\"" << type
+	   << "\" Precision=\"4\" Format=\"Binary\" Endian=\"" << xdmf_endian()
+	   << "\" Seek=\"" << seek << "\">" << fn << "</DataItem>" << endl;
 }
-/************************************************************************
- * computational stuff
- ************************************************************************/
 
-/** @brief find a nodes slave saturations */
-static void cmpnode_slave_s (MData &md, Node &node){
-	FuncBegin();
-	list<DuplData>::iterator i = node.dd.begin(); i++;
-	for ( ; i != node.dd.end() ; i++){
-		md.S.at( i->idx ) =
-			md.J->sopp(md.S.at(node.dd.front().idx), node.dd.front().reg->pd,i->reg->pd);
-	}
-	FuncEnd();
+/** @brief writes an XDMF Attribute of a binary file, see xdmf_item */
+static void xdmf_attribute(fstream &fl, const char *name, const int dim, const bool nodal,
+						   const int n, const size_t seek, const string &fn){
+	stringstream ss;
+	ss << n;
+	if (dim > 1) ss << " " << dim;
+	fl << "    <Attribute Name=\"" << name << "\" AttributeType=\"" << (dim > 1 ? "Vector" : "Scalar")
+	   << "\" Center=\"" << (nodal ? "Node" : "Cell") << "\">" << endl;
+	xdmf_item(fl, ss.str(), "Float", seek, fn);
+	fl << "    </Attribute>" << endl;
 }
 
-/** @brief find a nodes slave delta saturation.
-	
-	not used (unstable probably because of round of errors ).
-	instead use cmpnode_slave_s.
+/** @brief writes the data of v to fl */
+template <class T>
+static void write_raw(fstream &fl, const vector<T> &v){
+	if (!v.empty()) fl.write((const char*)&v[0], v.size() * sizeof(T));
+}
+
+/** @brief sizes of the mesh of the xdmf visual files.
+	@param npts output, number of points
+	@param nele output, number of cells
+	@param nmix output, length of the mixed topology, which has the type of
+	each cell before its points, and the number of points for a line
 */
-static void cmpnode_slave_deltas (MData &md, Node &node){
-	FuncBegin();
-	list<DuplData>::iterator i = node.dd.begin(); i++;
-	for ( ; i != node.dd.end() ; i++){
-		md.dS.at( i->idx ) = md.dS.at( node.dd.front().idx ) *
-			md.J->ds(md.S.at(node.dd.front().idx), node.dd.front().reg->pd,i->reg->pd);
-	}
-	FuncEnd();
+static void xdmf_sizes(MData &md, Mesh &msh, int &npts, int &nele, int &nmix){
+	npts = (md.visualduplicate == 0 ? msh.ndd() : msh.nnode());
+	nele = msh.nele();
+	nmix = 0;
+	for (list<eleblank*>::iterator it = msh.begele() ; it != msh.endeleall() ; it++)
+		nmix += 1 + (*it)->nNode() + ( (*it)->cellType() == CellLine ? 1 : 0 );
 }
 
-/** @brief  find a nodes cappilary potential and mobilities*/
-static void cmpnode_cappil_mobil (MData &md, Node &node){
+/** @brief the end of every .xmf file, the grids of new times are written before it */
+static const char xdmf_tail[] = "  </Grid>\n </Domain>\n</Xdmf>\n";
+
+/** @brief the .xmf file without its tail and without the grids of the outputs from nFile on.
+
+	A run that goes on from an earlier output, e.g. from the cache or a
+	checkpoint, writes those outputs again, so their old grids are dropped.
+*/
+static string xdmf_head(const string &xmf, const int nFile){
 	FuncBegin();
-	for (list<DuplData>::iterator i = node.dd.begin(); i != node.dd.end() ; i++){
-		md.Lw.at( i->idx ) = i->reg->kr->w( md.S.at (i->idx) );
-	    md.Ln.at( i->idx ) = i->reg->kr->nw( md.S.at (i->idx) ) / md.dm;
-		md.Pc.at(i->idx) =
-			i->reg->pd*md.J->J(md.S.at(i->idx)) +  //cappilary term
-			md.DgH.at(node.idx) ;                  //gravity
+
+	static const string gb = "   <Grid Name=\"", ge = "   </Grid>\n";
+	std::ifstream in(xmf.c_str(), std::ios::binary);
+	stringstream ss;
+	string old, head;
+	size_t p, e, q, d;
+
+	ss << in.rdbuf();
+	old = ss.str();
+	old.erase(old.size() - strlen(xdmf_tail));
+	p = old.find(gb);
+	head = old.substr(0, p);
+	while (p != string::npos){
+		e = old.find(ge, p);
+		e = ( e == string::npos ? old.size() : e + ge.size() );
+		q = old.find('"', p + gb.size());
+		d = old.rfind('.', q);
+		if ( (q > e) || (d < p) || (atoi(old.c_str() + d + 1) < nFile) )
+			head += old.substr(p, e - p);
+		p = old.find(gb, e);
 	}
+	return head;
+
 	FuncEnd();
 }
 
-/** @brief find a nodes SIGMA( ds_i/ds_master * phi_i * v_i ) */
-static void cmpnode_sphiv (MData &md, Node &node){
+/** @brief writes one time of an XDMF time series.
+
+	The mesh does not change during a run, so it is written once to
+	<base>.mesh.bin, where address is <base>.<n>. Every time only writes
+	its fields, as floats, to <address>.bin and adds a grid pointing to both
+	to <base>.xmf, which Paraview and VisIt open as a time series. The mesh is
+	written again at the first output of a run, and the .xmf starts over
+	when the output number is 0, or drops the grids from that output on. With md.lossy the fields go to <address>.dfz
+	instead, and df2d-expand turns it into the .bin the .xmf points to. With
+	md.series they are a frame of the series, which df2d-frames turns into
+	the .bin, a .vtk or the restart file.
+*/
+static void writevisual_xdmf(const char * address,MData& md,Mesh &msh){
 	FuncBegin();
-	list<DuplData>::iterator i = node.dd.begin(); i++;
-	md.SPhiV.at(node.idx) = md.VPhi.at(node.dd.front().idx);
-	for ( ; i != node.dd.end() ; i++){
-		md.SPhiV.at(node.idx) += md.VPhi.at(i->idx)
-			* md.J->ds(md.S.at(node.dd.front().idx), node.dd.front().reg->pd,i->reg->pd);
+
+	fstream fl;
+	struct stat st;
+	vector<float> f[visual_nfield];
+	string base(address), name;
+	size_t seek, j;
+	int npts, nele, nmix;
+
+	//<base>.<n>, the files are named after base
+	j = base.find_last_of('.');
+	if ( (j != string::npos) && (j + 1 < base.size()) &&
+		 (base.find_first_not_of("0123456789", j + 1) == string::npos) )
+		base.erase(j);
+	j = base.find_last_of('/');
+	const string dir = ( j == string::npos ? string() : base.substr(0, j + 1) );
+	name = string(address).substr(dir.size());
+	const string meshfn = base.substr(dir.size()) + ".mesh.bin";
+
+	xdmf_sizes(md, msh, npts, nele, nmix);
+
+	//the mesh: points, mixed topology, porous and boundary region numbers
+	if ( (md.nFile == md.nFileRun) || (stat((dir + meshfn).c_str(), &st) != 0) ){
+		vector<float> pts, bnd, reg;
+		vector<int> cells, conn, mix;
+		visual_mesh(md, msh, pts, bnd, cells, conn, reg);
+		mix.reserve(nmix);
+		j = 0;
+		for (size_t i = 0 ; i < cells.size() ; i++){
+			mix.push_back( cell2xdmf( (CellType)cells[i] ) );
+			if (cells[i] == CellLine) mix.push_back(2);
+			for (int k = 0 ; k < cells[i] ; k++) mix.push_back(conn[j++]);
+		}
+		fl.open((dir + meshfn + ".tmp").c_str(), fstream::out | fstream::binary);
+		if (!fl.is_open()){
+			Error::mess << dir + meshfn << " could not be openned.";
+			ERRSET();
+		}
+		write_raw(fl, pts);
+		write_raw(fl, mix);
+		write_raw(fl, reg);
+		write_raw(fl, bnd);
+		fl.close();
+		if (fl.fail() || (rename((dir + meshfn + ".tmp").c_str(), (dir + meshfn).c_str()) != 0) ){
+			Error::mess << dir + meshfn << " could not be written.";
+			ERRSET();
+		}
+	}
+
+	//the fields of this time, compressed with the error bounds if asked
+	visual_fields(md, msh, f);
+	if (md.series){
+		//a frame of the series, with S of the restart file by node
+		vector<SeriesField> sf;
+		vector<double> sr;
+		for (int k = 0 ; k < visual_nfield ; k++){
+			if (f[k].empty()) continue;
+			SeriesField x = {visual_names[k], visual_dim[k], visual_nodal[k], sizeof(float),
+							 (int)f[k].size(), md.deltaTol[visual_tol[k]], &f[k][0]};
+			sf.push_back(x);
+		}
+		if (md.outFields & MData::OutRestart){
+			for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++)
+				sr.push_back(md.S.at(i->dd.front().idx));
+			SeriesField x = {"restart", 1, 1, sizeof(double), (int)sr.size(), 0, &sr[0]};
+			sf.push_back(x);
+		}
+		md.series->write(md.nFile, md.t, sf);
+	}
+	else if (md.lossy){
+		vector<int> id, dim;
+		vector<const vector<float>*> fk;
+		vector<double> eb;
+		for (int k = 0 ; k < visual_nfield ; k++){
+			if (f[k].empty()) continue;
+			id.push_back(k);
+			fk.push_back(&f[k]);
+			dim.push_back(visual_dim[k]);
+			eb.push_back(md.lossyTol[visual_tol[k]]);
+		}
+		if (!lossy::write(string(address) + ".dfz", id, fk, dim, eb)){
+			Error::mess << address << ".dfz could not be written.";
+			ERRSET();
+		}
+	}
+	else{
+		fl.open((string(address) + ".bin").c_str(), fstream::out | fstream::binary | fstream::trunc);
+		if (!fl.is_open()){
+			Error::mess << address << ".bin could not be openned.";
+			ERRSET();
+		}
+		for (int k = 0 ; k < visual_nfield ; k++) write_raw(fl, f[k]);
+		fl.close();
+		if (fl.fail()){
+			Error::mess << address << ".bin could not be written.";
+			ERRSET();
+		}
+	}
+
+	//the index: a new grid before the tail, or a new file
+	const string xmf = base + ".xmf";
+	bool append = false;
+	if ( (md.nFile != 0) && (stat(xmf.c_str(), &st) == 0) &&
+		 (st.st_size >= (off_t)strlen(xdmf_tail)) ){
+		fl.open(xmf.c_str(), fstream::in | fstream::out | fstream::binary);
+		string tail(strlen(xdmf_tail), ' ');
+		fl.seekg(st.st_size - tail.size());
+		fl.read(&tail[0], tail.size());
+		append = ( fl.good() && (tail.compare(xdmf_tail) == 0) );
+		if (append) fl.seekp(st.st_size - tail.size());
+		else fl.close();
+	}
+	if (append && (md.nFile == md.nFileRun)){
+		//the first output of a run, the grids from it on are of an older run
+		fl.close();
+		const string head = xdmf_head(xmf, md.nFile);
+		fl.clear();
+		fl.open(xmf.c_str(), fstream::out | fstream::trunc | fstream::binary);
+		fl << head;
+	}
+	if (!append){
+		fl.clear();
+		fl.open(xmf.c_str(), fstream::out | fstream::trunc);
+		fl << "<?xml version=\"1.0\" ?>" << endl
+		   << "<Xdmf Version=\"2.0\">" << endl
+		   << " <Domain>" << endl
+		   << "  <Grid Name=\"" << base.substr(dir.size())
+		   << "\" GridType=\"Collection\" CollectionType=\"Temporal\">" << endl;
+	}
+	if (!fl.is_open()){
+		Error::mess << xmf << " could not be openned.";
+		ERRSET();
+	}
+	stringstream ss;
+	ss << setprecision(12);
+	fl << "   <Grid Name=\"" << name << "\" GridType=\"Uniform\">" << endl;
+	ss << md.t;
+	fl << "    <Time Value=\"" << ss.str() << "\"/>" << endl;
+	ss.str(""); ss << nmix;
+	fl << "    <Topology TopologyType=\"Mixed\" NumberOfElements=\"" << nele << "\">" << endl;
+	seek = 3 * sizeof(float) * npts;
+	xdmf_item(fl, ss.str(), "Int", seek, meshfn);
+	fl << "    </Topology>" << endl;
+	ss.str(""); ss << npts << " 3";
+	fl << "    <Geometry GeometryType=\"XYZ\">" << endl;
+	xdmf_item(fl, ss.str(), "Float", 0, meshfn);
+	fl << "    </Geometry>" << endl;
+	seek += sizeof(int) * nmix;
+	xdmf_attribute(fl, "porous_region_no", 1, false, nele, seek, meshfn);
+	seek += sizeof(float) * nele;
+	xdmf_attribute(fl, "bnd_region_no", 1, true, npts, seek, meshfn);
+	seek = 0;
+	for (int k = 0 ; k < visual_nfield ; k++){
+		if (f[k].empty()) continue;
+		xdmf_attribute(fl, visual_names[k], visual_dim[k], visual_nodal[k], f[k].size() / visual_dim[k],
+					   seek, name + ".bin");
+		seek += sizeof(float) * f[k].size();
+	}
+	fl << "   </Grid>" << endl << xdmf_tail;
+	fl.close();
+	if (fl.fail()){
+		Error::mess << xmf << " could not be written.";
+		ERRSET();
+	}
+
+	FuncEnd();
+}
+
+/** @brief  writes a gmsh visualization file */
+static void writevisual_gmsh(const char * address,MData& md,Mesh &msh){
+	cell2gmsh(CellTri);
+	ERRSET();
+}
+
+/** @brief  writes a tecplot visualization file */
+static void writevisual_tecplot (const char * address,MData& md,Mesh &msh){
+	cell2tecplot(CellTri);
+	ERRSET();
+}
+/************************************************************************
+ * computational stuff
+ ************************************************************************/
+
+/** @brief find a nodes slave saturations */
+static void cmpnode_slave_s (MData &md, Node &node){
+	FuncBegin();
+	list<DuplData>::iterator i = node.dd.begin(); i++;
+	for ( ; i != node.dd.end() ; i++){
+		md.S.at( i->idx ) =
+			md.J->sopp(md.S.at(node.dd.front().idx), node.dd.front().reg->pd,i->reg->pd);
+	}
+	FuncEnd();
+}
+
+/** @brief find a nodes slave delta saturation.
+	
+	not used (unstable probably because of round of errors ).
+	instead use cmpnode_slave_s.
+*/
+static void cmpnode_slave_deltas (MData &md, Node &node){
+	FuncBegin();
+	list<DuplData>::iterator i = node.dd.begin(); i++;
+	for ( ; i != node.dd.end() ; i++){
+		md.dS.at( i->idx ) = md.dS.at( node.dd.front().idx ) *
+			md.J->ds(md.S.at(node.dd.front().idx), node.dd.front().reg->pd,i->reg->pd);
+	}
+	FuncEnd();
+}
+
+/** @brief  find a nodes cappilary potential and mobilities*/
+static void cmpnode_cappil_mobil (MData &md, Node &node){
+	FuncBegin();
+	for (list<DuplData>::iterator i = node.dd.begin(); i != node.dd.end() ; i++){
+		md.Lw.at( i->idx ) = i->reg->kr->w( md.S.at (i->idx) );
+	    md.Ln.at( i->idx ) = i->reg->kr->nw( md.S.at (i->idx) ) / md.dm;
+		md.Pc.at(i->idx) =
+			i->reg->pd*md.J->J(md.S.at(i->idx)) +  //cappilary term
+			md.DgH.at(node.idx) ;                  //gravity
+	}
+	FuncEnd();
+}
+
+/** @brief find a nodes SIGMA( ds_i/ds_master * phi_i * v_i ) */
+static void cmpnode_sphiv (MData &md, Node &node){
+	FuncBegin();
+	list<DuplData>::iterator i = node.dd.begin(); i++;
+	md.SPhiV.at(node.idx) = md.VPhi.at(node.dd.front().idx);
+	for ( ; i != node.dd.end() ; i++){
+		md.SPhiV.at(node.idx) += md.VPhi.at(i->idx)
+			* md.J->ds(md.S.at(node.dd.front().idx), node.dd.front().reg->pd,i->reg->pd);
+	}
+	FuncEnd();
+}
+
+
+
+/************************************************************************
+ * shared memory stuff
+ ************************************************************************/
+
+/** @brief runs f(t) on every thread t of md.pool, raises an error if one of them failed */
+static void par_run(MData &md, const std::function<void(int)> &f){
+	FuncBegin();
+
+	if (!md.pool->run(f)){
+		Error::mess << "a thread failed while working on its mesh partition";
+		if (!md.pool->error().empty()) Error::mess << ": " << md.pool->error();
+		ERRSET();
+	}
+
+	FuncEnd();
+}
+
+/** @brief calls f(t, node) for every owned node.
+
+	With threads, thread t gets the inner nodes of partition t and an equal share
+	of the interface nodes, so no node is touched by two threads.
+ */
+template<class F>
+static void par_nodes(MData &md, Mesh &msh, F f){
+	FuncBegin();
+
+	if (!md.pool){
+		for (vector<Node*>::iterator i = msh.begownnode() ; i < msh.endownnode() ; i++) f(0, **i);
+		return;
+	}
+	const int np = msh.npart(), n0 = msh.partnode(np), nif = msh.nnode() - n0;
+	par_run(md, [&](const int t){
+		for (int i = msh.partnode(t) ; i < msh.partnode(t+1) ; i++) f(t, msh.node(i));
+		for (int i = n0 + nif * t / np ; i < n0 + nif * (t+1) / np ; i++) f(t, msh.node(i));
+	});
+
+	FuncEnd();
+}
+
+/************************************************************************
+ * distributed stuff
+ ************************************************************************/
+
+/** @brief reduces x[0..n) over all processes with op, e.g. MPI_MAX or MPI_SUM */
+static void dist_reduce(MData &md, double *x, const int n, MPI_Op op){
+	FuncBegin();
+
+	PetscLogDouble w0, w1;
+
+	if (md.nrank == 1) return;
+	PetscTime(&w0);
+	Error::code=MPI_Allreduce(MPI_IN_PLACE, x, n, MPI_DOUBLE, op, md.comm);ERRCHK();
+	PetscTime(&w1);
+	md.wH += w1 - w0;
+
+	FuncEnd();
+}
+
+/** @brief max of x over all processes */
+static double dist_max(MData &md, double x){
+	dist_reduce(md, &x, 1, MPI_MAX);
+	return x;
+}
+
+/** @brief creates the vectors and scatters used to exchange the ghost nodes.
+
+	All the local vectors have the size of the whole mesh and are indexed by the
+	node idx, so md.P, md.S, md.Fs and the rest can be used as before. Only the
+	entries of the owned and ghost nodes are valid, except on process 0 just
+	after dist_gather.
+ */
+static void dist_setup(MData &md, Mesh &msh){
+	FuncBegin();
+
+	vector<int> lidx;
+	IS is;
+
+	for (vector<Node*>::iterator i = msh.begownnode() ; i < msh.endghostnode() ; i++)
+		lidx.push_back( (*i)->idx );
+	Error::code=VecCreateSeq(PETSC_COMM_SELF, msh.nnode(), &md.Ploc);ERRCHK();
+	Error::code=VecDuplicate(md.Ploc, &md.Sl);ERRCHK();
+	Error::code=VecDuplicate(md.Ploc, &md.Fsl);ERRCHK();
+	Error::code=VecDuplicate(md.Pvec, &md.Sg);ERRCHK();
+	Error::code=VecDuplicate(md.Pvec, &md.Fsg);ERRCHK();
+	Error::code=VecSet(md.Ploc, 0);ERRCHK();
+	Error::code=ISCreateGeneral(PETSC_COMM_SELF, lidx.size(), lidx.data(), PETSC_COPY_VALUES, &is);ERRCHK();
+	Error::code=VecScatterCreate(md.Pvec, is, md.Ploc, is, &md.halo);ERRCHK();
+	Error::code=ISDestroy(&is);ERRCHK();
+	Error::code=VecScatterCreateToZero(md.Pvec, &md.gather, &md.Gz);ERRCHK();
+
+	FuncEnd();
+}
+
+/** @brief copies the master S of the owned nodes to Sg */
+static void dist_sg(MData &md, Mesh &msh){
+	FuncBegin();
+
+	double *a;
+
+	Error::code=VecGetArray(md.Sg, &a);ERRCHK();
+	for (vector<Node*>::iterator i = msh.begownnode() ; i < msh.endownnode() ; i++)
+		a[ (*i)->idx - msh.rstart() ] = md.S.at( (*i)->dd.front().idx );
+	Error::code=VecRestoreArray(md.Sg, &a);ERRCHK();
+
+	FuncEnd();
+}
+
+/** @brief halo exchange of P, after the p solve */
+static void dist_p(MData &md){
+	FuncBegin();
+
+	PetscLogDouble w0, w1;
+
+	PetscTime(&w0);
+	Error::code=VecScatterBegin(md.halo, md.Pvec, md.Ploc, INSERT_VALUES, SCATTER_FORWARD);ERRCHK();
+	Error::code=VecScatterEnd(md.halo, md.Pvec, md.Ploc, INSERT_VALUES, SCATTER_FORWARD);ERRCHK();
+	PetscTime(&w1);
+	md.wH += w1 - w0;
+
+	FuncEnd();
+}
+
+/** @brief halo exchange of S, after the owned nodes are moved.
+
+	Only the master saturation is sent, the rest of the ghost node data is found
+	again from it.
+ */
+static void dist_s(MData &md, Mesh &msh){
+	FuncBegin();
+
+	const double *a;
+	PetscLogDouble w0, w1;
+
+	PetscTime(&w0);
+	dist_sg(md, msh);
+	Error::code=VecScatterBegin(md.halo, md.Sg, md.Sl, INSERT_VALUES, SCATTER_FORWARD);ERRCHK();
+	Error::code=VecScatterEnd(md.halo, md.Sg, md.Sl, INSERT_VALUES, SCATTER_FORWARD);ERRCHK();
+	Error::code=VecGetArrayRead(md.Sl, &a);ERRCHK();
+	for (vector<Node*>::iterator i = msh.endownnode() ; i < msh.endghostnode() ; i++){
+		md.S.at( (*i)->dd.front().idx ) = a[ (*i)->idx ];
+		cmpnode_slave_s(md, **i);
+		cmpnode_sphiv(md, **i);
+		cmpnode_cappil_mobil(md, **i);
+	}
+	Error::code=VecRestoreArrayRead(md.Sl, &a);ERRCHK();
+	PetscTime(&w1);
+	md.wH += w1 - w0;
+
+	FuncEnd();
+}
+
+/** @brief adds the element fluxes of the ghost nodes to their owners.
+
+	After the call Fs of the owned nodes is complete and Fs of the ghost nodes
+	is zero, so a loop over all local nodes only moves the owned ones.
+ */
+static void dist_fs(MData &md, Mesh &msh){
+	FuncBegin();
+
+	double *a;
+	const double *g;
+	PetscLogDouble w0, w1;
+
+	PetscTime(&w0);
+	Error::code=VecGetArray(md.Fsl, &a);ERRCHK();
+	for (vector<Node*>::iterator i = msh.begownnode() ; i < msh.endghostnode() ; i++)
+		a[ (*i)->idx ] = md.Fs.at( (*i)->idx );
+	Error::code=VecRestoreArray(md.Fsl, &a);ERRCHK();
+	Error::code=VecSet(md.Fsg, 0);ERRCHK();
+	Error::code=VecScatterBegin(md.halo, md.Fsl, md.Fsg, ADD_VALUES, SCATTER_REVERSE);ERRCHK();
+	Error::code=VecScatterEnd(md.halo, md.Fsl, md.Fsg, ADD_VALUES, SCATTER_REVERSE);ERRCHK();
+	Error::code=VecGetArrayRead(md.Fsg, &g);ERRCHK();
+	for (vector<Node*>::iterator i = msh.begownnode() ; i < msh.endownnode() ; i++)
+		md.Fs.at( (*i)->idx ) = g[ (*i)->idx - msh.rstart() ];
+	for (vector<Node*>::iterator i = msh.endownnode() ; i < msh.endghostnode() ; i++)
+		md.Fs.at( (*i)->idx ) = 0;
+	Error::code=VecRestoreArrayRead(md.Fsg, &g);ERRCHK();
+	PetscTime(&w1);
+	md.wH += w1 - w0;
+
+	FuncEnd();
+}
+
+/** @brief sums the boundary fluxes of this time step over all processes.
+	@param q0 qIn, qOut, qWin and qWout before the step, same on all processes.
+ */
+static void dist_q(MData &md, const double q0[]){
+	FuncBegin();
+
+	double dq[] = {md.qIn - q0[0], md.qOut - q0[1], md.qWin - q0[2], md.qWout - q0[3]};
+
+	dist_reduce(md, dq, 4, MPI_SUM);
+	md.qIn = q0[0] + dq[0];
+	md.qOut = q0[1] + dq[1];
+	md.qWin = q0[2] + dq[2];
+	md.qWout = q0[3] + dq[3];
+
+	FuncEnd();
+}
+
+/** @brief collects S and P of the whole mesh on process 0, so it can write the files.
+	Collective, the other processes do not change.
+ */
+static void dist_gather(MData &md, Mesh &msh){
+	FuncBegin();
+
+	const double *g;
+	double *p;
+
+	dist_sg(md, msh);
+	Error::code=VecScatterBegin(md.gather, md.Sg, md.Gz, INSERT_VALUES, SCATTER_FORWARD);ERRCHK();
+	Error::code=VecScatterEnd(md.gather, md.Sg, md.Gz, INSERT_VALUES, SCATTER_FORWARD);ERRCHK();
+	if (md.rank == 0){
+		Error::code=VecGetArrayRead(md.Gz, &g);ERRCHK();
+		for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++){
+			md.S.at( i->dd.front().idx ) = g[ i->idx ];
+			cmpnode_slave_s(md, *i);
+			cmpnode_cappil_mobil(md, *i);
+		}
+		Error::code=VecRestoreArrayRead(md.Gz, &g);ERRCHK();
+	}
+	Error::code=VecScatterBegin(md.gather, md.Pvec, md.Gz, INSERT_VALUES, SCATTER_FORWARD);ERRCHK();
+	Error::code=VecScatterEnd(md.gather, md.Pvec, md.Gz, INSERT_VALUES, SCATTER_FORWARD);ERRCHK();
+	if (md.rank == 0){
+		Error::code=VecGetArrayRead(md.Gz, &g);ERRCHK();
+		Error::code=VecGetArray(md.Ploc, &p);ERRCHK();
+		for (int i = 0 ; i < msh.nnode() ; i++) p[i] = g[i];
+		Error::code=VecRestoreArray(md.Ploc, &p);ERRCHK();
+		Error::code=VecRestoreArrayRead(md.Gz, &g);ERRCHK();
+	}
+
+	FuncEnd();
+}
+
+/** @brief applies the (possibly lagged) LU factor of A as a preconditioner.
+
+	The function is called by Petsc so it returns an error code instead of
+	throwing.
+*/
+static PetscErrorCode pdirect_apply(PC pc, Vec x, Vec y){
+	PetscErrorCode ierr;
+	MData *md;
+	ierr = PCShellGetContext(pc, (void**)&md);CHKERRQ(ierr);
+	ierr = MatSolve(md->F, x, y);CHKERRQ(ierr);
+	return 0;
+}
+
+/** @brief finds the ordering and symbolic factorization of A once.
+
+	A only has to have its final sparsity pattern, its values are not used.
+	The KSP and PC types set here are defaults, called before
+	KSPSetFromOptions so that -ksp_type and -pc_type still apply.
+ */
+static void pdirect_setup(MData &md){
+	FuncBegin();
+
+	MatFactorInfo info;
+	PC pc;
+
+	//ordering and symbolic factorization
+	Error::code=MatGetOrdering(md.A, MATORDERINGND, &md.prow, &md.pcol);ERRCHK();
+	Error::code=MatGetFactor(md.A, md.pdirectPackage.c_str(), MAT_FACTOR_LU, &md.F);ERRCHK();
+	Error::code=MatFactorInfoInitialize(&info);ERRCHK();
+	Error::code=MatLUFactorSymbolic(md.F, md.A, md.prow, md.pcol, &info);ERRCHK();
+	//the factor is applied through a shell preconditioner
+	Error::code=KSPSetType(md.ksp, (md.pdirectLag > 1 ? KSPBCGS : KSPPREONLY) );ERRCHK();
+	Error::code=KSPGetPC(md.ksp, &pc);ERRCHK();
+	Error::code=PCSetType(pc, PCSHELL);ERRCHK();
+	Error::code=PCShellSetContext(pc, &md);ERRCHK();
+	Error::code=PCShellSetApply(pc, pdirect_apply);ERRCHK();
+	Error::code=PCShellSetName(pc, "df2d_pdirect");ERRCHK();
+
+	FuncEnd();
+}
+
+/** @brief does the numerical factorization of A if the factor is old enough */
+static void pdirect_factor(MData &md){
+	FuncBegin();
+
+	MatFactorInfo info;
+
+	if ( (md.nPFactor == 0) || (md.nPSolve % md.pdirectLag == 0) ){
+		Error::code=MatFactorInfoInitialize(&info);ERRCHK();
+		Error::code=MatLUFactorNumeric(md.F, md.A, &info);ERRCHK();
+		md.nPFactor++;
+	}
+
+	FuncEnd();
+}
+
+/** @brief matrix-free product y = A x of the p equation.
+
+	The element lhsP matrices are found on the fly from the current upwind
+	indices and mobilities. The rows of constant p nodes are identity, same as
+	after BVertexCP::assemP. Called by Petsc, so it returns an error code.
+*/
+static PetscErrorCode pshell_mult(Mat As, Vec x, Vec y){
+	PetscErrorCode ierr;
+	MData *md;
+	const double *xa;
+	double *ya;
+	const arma::mat *lhs;
+	const arma::ivec *idx;
+
+	ierr = MatShellGetContext(As, &md);CHKERRQ(ierr);
+	ierr = VecSet(y, 0);CHKERRQ(ierr);
+	ierr = VecGetArrayRead(x, &xa);CHKERRQ(ierr);
+	ierr = VecGetArray(y, &ya);CHKERRQ(ierr);
+	try{
+		for (list<eleblank*>::iterator i = md->mesh->begele() ; i != md->mesh->endele() ; i++){
+			lhs = &(*i)->lhsP(md->Lw, md->Ln);
+			idx = &(*i)->idxGlob();
+			for (int k = 0 ; k < (*i)->nNode() ; k++)
+				for (int j = 0 ; j < (*i)->nNode() ; j++)
+					ya[ (*idx)(k) ] += (*lhs)(k,j) * xa[ (*idx)(j) ];
+		}
+	}
+	catch(...){
+		SETERRQ(PETSC_COMM_SELF, PETSC_ERR_LIB, "element kernel failed in matrix-free p operator");
+	}
+	for (int i = 0 ; i < (int)md->pconst.size() ; i++)
+		ya[ md->pconst[i] ] = xa[ md->pconst[i] ];
+	ierr = VecRestoreArray(y, &ya);CHKERRQ(ierr);
+	ierr = VecRestoreArrayRead(x, &xa);CHKERRQ(ierr);
+	return 0;
+}
+
+/** @brief diagonal of the matrix-free p operator, used by the preconditioner */
+static PetscErrorCode pshell_diagonal(Mat As, Vec d){
+	PetscErrorCode ierr;
+	MData *md;
+	double *da;
+	const arma::mat *lhs;
+	const arma::ivec *idx;
+
+	ierr = MatShellGetContext(As, &md);CHKERRQ(ierr);
+	ierr = VecSet(d, 0);CHKERRQ(ierr);
+	ierr = VecGetArray(d, &da);CHKERRQ(ierr);
+	try{
+		for (list<eleblank*>::iterator i = md->mesh->begele() ; i != md->mesh->endele() ; i++){
+			lhs = &(*i)->lhsP(md->Lw, md->Ln);
+			idx = &(*i)->idxGlob();
+			for (int k = 0 ; k < (*i)->nNode() ; k++)
+				da[ (*idx)(k) ] += (*lhs)(k,k);
+		}
+	}
+	catch(...){
+		SETERRQ(PETSC_COMM_SELF, PETSC_ERR_LIB, "element kernel failed in matrix-free p operator");
+	}
+	for (int i = 0 ; i < (int)md->pconst.size() ; i++)
+		da[ md->pconst[i] ] = 1;
+	ierr = VecRestoreArray(d, &da);CHKERRQ(ierr);
+	return 0;
+}
+
+/** @brief replaces A with a matrix-free operator.
+
+	A is only needed up to here for its sparsity pattern, which the constant
+	p bvertices have already copied.
+ */
+static void pshell_setup(MData &md, Mesh &msh){
+	FuncBegin();
+
+	PC pc;
+
+	md.pconst.clear();
+	for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++)
+		if ( (*i)->isPConst() ) md.pconst.push_back( (*i)->idx() );
+	Error::code=MatDestroy(&md.A);ERRCHK();
+	Error::code=MatCreateShell(PETSC_COMM_SELF, msh.nnode(), msh.nnode(),
+							   msh.nnode(), msh.nnode(), &md, &md.As);ERRCHK();
+	Error::code=MatShellSetOperation(md.As, MATOP_MULT, (void(*)(void))pshell_mult);ERRCHK();
+	Error::code=MatShellSetOperation(md.As, MATOP_GET_DIAGONAL,
+									 (void(*)(void))pshell_diagonal);ERRCHK();
+	Error::code=KSPSetOperators(md.ksp, md.As, md.As);ERRCHK();
+	Error::code=KSPGetPC(md.ksp, &pc);ERRCHK();
+	Error::code=PCSetType(pc, PCJACOBI);ERRCHK();
+
+	FuncEnd();
+}
+
+/** @brief checks the PC of the shell matrix, after KSPSetFromOptions.
+
+	The shell matrix can only multiply and give its diagonal, so a PC set in
+	petsc.config that needs the entries, e.g. ilu, lu or gamg, is refused.
+ */
+static void pshell_check(MData &md){
+	FuncBegin();
+
+	PC pc;
+	PCType type;
+
+	Error::code=KSPGetPC(md.ksp, &pc);ERRCHK();
+	Error::code=PCGetType(pc, &type);ERRCHK();
+	if ( type && strcmp(type, PCJACOBI) && strcmp(type, PCNONE) ){
+		Error::mess << swipshell << " does not assemble the p matrix, so -pc_type " << type
+					<< " can not be used with it. Use jacobi or none.";
+		ERRSET();
+	}
+
+	FuncEnd();
+}
+
+/** @brief assembles and solves the p equation.
+
+	The total mobility used is saved, so that cmp_dlt can tell how much it has
+	changed since.
+ */
+static void solve_p(MData &md, Mesh &msh){
+	FuncBegin();
+
+	const arma::vec *rhs;
+	const arma::mat *lhs;
+	const arma::ivec *idx;
+	Node *node;
+	vector<int> rows;
+	PetscLogDouble w0, w1;
+
+	//assemble P equation
+	Error::code=VecSet(md.b, 0);ERRCHK();
+	if (md.pshell){
+		for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++)
+			(*i)->resetLhsP();
+	}
+	else{
+		Error::code=MatZeroEntries(md.A);ERRCHK();
+	}
+	for (list<eleblank*>::iterator i = msh.begele() ; i != msh.endele() ; i++){
+		//update non wetting upwind
+		(*i)->fndUpN(md.P, md.Pc);
+		//get mats
+		lhs = &(*i)->lhsP(md.Lw,md.Ln);
+		rhs = &(*i)->rhsP(md.Ln,md.Pc, 0);
+		idx = &(*i)->idxGlob();
+		if (md.pshell){
+			//only the bvertices need the lhs rows
+			for (int k = 0 ; k < (*i)->nNode() ; k++){
+				node = &msh.node( (*idx)(k) );
+				if (node->bvertex) node->bvertex->addLhsP(*idx, *lhs, k);
+			}
+		}
+		else{
+			Error::code=MatSetValues(md.A,
+									 (*i)->nNode(), idx->memptr(),
+									 (*i)->nNode(), idx->memptr(),
+									 lhs->memptr(), ADD_VALUES);ERRCHK();
+		}
+		Error::code=VecSetValues(md.b,
+								 (*i)->nNode(), idx->memptr(),
+								 rhs->memptr(),ADD_VALUES);ERRCHK();
+	}
+	if (!md.pshell){
+		Error::code=MatAssemblyBegin(md.A, MAT_FINAL_ASSEMBLY);ERRCHK();
+		Error::code=MatAssemblyEnd(md.A, MAT_FINAL_ASSEMBLY);ERRCHK();
+	}
+	Error::code=VecAssemblyBegin(md.b);ERRCHK();
+	Error::code=VecAssemblyEnd(md.b);ERRCHK();
+
+	//force boundary condition
+	if (md.nrank > 1){
+		//constant p rows are zeroed together, after the other bvertices added to b
+		for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++)
+			if ( !(*i)->isPConst() ) (*i)->assemPDist(md.A, md.b);
+		Error::code=VecAssemblyBegin(md.b);ERRCHK();
+		Error::code=VecAssemblyEnd(md.b);ERRCHK();
+		for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++){
+			if ( !(*i)->isPConst() ) continue;
+			(*i)->assemPDist(md.A, md.b);
+			rows.push_back( (*i)->idx() );
+		}
+		Error::code=VecAssemblyBegin(md.b);ERRCHK();
+		Error::code=VecAssemblyEnd(md.b);ERRCHK();
+		Error::code=MatZeroRows(md.A, rows.size(), rows.data(), 1, NULL, NULL);ERRCHK();
+	}
+	else for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++){
+		if (md.pshell) (*i)->assemP(md.b);
+		else (*i)->assemP(md.A, md.b);
+	}
+	
+	//Solve the p equation
+	PetscTime(&w0);
+	if (md.pdirect) pdirect_factor(md);
+	Error::code=KSPSolve(md.ksp, md.b, md.Pvec);ERRCHK();
+	PetscTime(&w1);
+	md.wP += w1 - w0;
+	md.dpT = w1 - w0;
+	md.nPSolve++;
+	if (md.nrank > 1) dist_p(md);
+
+	//save the total mobility
+	md.LtP.resize(md.Lw.size());
+	for (int i = 0 ; i < (int)md.LtP.size() ; i++) md.LtP[i] = md.Lw[i] + md.Ln[i];
+
+	FuncEnd();
+}
+
+/** @brief assembles the S equation of the elements in partition p.
+
+	With threads the interface nodes are added to md.FsIf[p], so they can be
+	summed in the same order whatever thread finishes first.
+ */
+static void assem_s_part(MData &md, Mesh &msh, const int p, const bool updw){
+	FuncBegin();
+
+	const arma::vec *rhs;
+	const arma::ivec *idx;
+	const int n0 = ( md.pool ? msh.partnode(msh.npart()) : msh.nnode() );
+
+	if (md.pool) std::fill(md.FsIf.at(p).begin(), md.FsIf.at(p).end(), 0);
+	for (list<eleblank*>::iterator i = msh.begpartele(p) ; i != msh.endpartele(p) ; i++){
+		//update wetting upwind node
+		if (updw) (*i)->fndUpW(md.P);
+		//get mat and idx
+		rhs = &(*i)->rhsS(md.Lw, md.P, 0);
+		idx = &(*i)->idxGlob();
+            //assemble
+		for (int j = 0 ; j < (*i)->nNode();  j++){
+			if ( (*idx)(j) < n0 ) md.Fs.at( (*idx)(j) ) += (*rhs)(j) ;
+			else md.FsIf[p].at( (*idx)(j) - n0 ) += (*rhs)(j) ;
+		}
+	}
+
+	FuncEnd();
+}
+
+/** @brief finds the RHS of S equation (Fs) from the current P and Lw.
+
+	@param updw if false the wetting phase upwind nodes of the last call are used.
+ */
+static void assem_s(MData &md, Mesh &msh, const bool updw){
+	FuncBegin();
+
+	//assemble S equation
+	//make the flux zero
+	for (vector<Node*>::iterator i = msh.begownnode() ; i < msh.endghostnode() ; i++)
+		md.Fs.at( (*i)->idx ) = 0;
+	if (md.pool){
+		const int n0 = msh.partnode(msh.npart());
+		par_run(md, [&](const int p){ assem_s_part(md, msh, p, updw); });
+		for (int p = 0 ; p < msh.npart() ; p++)
+			for (int i = 0 ; i < (int)md.FsIf[p].size() ; i++)
+				md.Fs.at(n0 + i) += md.FsIf[p][i];
+	}
+	else assem_s_part(md, msh, 0, updw);
+	if (md.nrank > 1) dist_fs(md, msh);
+	
+	//force boundary condition
+	for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++){
+		(*i)->findQAll(md.Fs, md.P, md.Lw, md.Ln);
+		(*i)->assemS(md.Fs);
+	}
+
+	FuncEnd();
+}
+
+/** @brief max relative change in total mobility since the last p solve */
+static double cmp_dlt(MData &md){
+	FuncBegin();
+
+	double dlt = 0, lt = 0;
+	if (md.LtP.size() != md.Lw.size()) return 1e10;
+	for (int i = 0 ; i < (int)md.LtP.size() ; i++){
+		dlt = fmax( dlt, fabs(md.Lw[i] + md.Ln[i] - md.LtP[i]) );
+		lt = fmax( lt, md.LtP[i] );
+	}
+	dlt = dist_max(md, dlt);
+	lt = dist_max(md, lt);
+	return ( lt > 0 ? dlt / lt : dlt );
+
+	FuncEnd();
+}
+
+/** @brief total volume of the wetting phase in the reservoir */
+static double cmp_vw(MData &md, Mesh &msh){
+	FuncBegin();
+
+	double vw = 0;
+	for(vector<Node*>::iterator i = msh.begownnode() ; i < msh.endownnode() ; i++)
+		for(list<DuplData>::iterator j = (*i)->dd.begin() ; j != (*i)->dd.end() ; j++)
+			vw += md.VPhi.at(j->idx) * md.S.at(j->idx);
+	dist_reduce(md, &vw, 1, MPI_SUM);
+	return vw;
+
+	FuncEnd();
+}
+
+/** @brief adds the fluxes of a boundary vertex during dt to the totals */
+static void add_q(MData &md, const BVertexCQ &bv, const double dt){
+	md.qIn   += fmax( 0 , bv.mGamma()  ) * dt / md.dp;
+	md.qOut  -= fmin( 0 , bv.mGamma()  ) * dt / md.dp;
+	md.qWin  += fmax( 0 , bv.mGammaW() ) * dt / md.dp;
+	md.qWout -= fmin( 0 , bv.mGammaW() ) * dt / md.dp;
+}
+
+/** @brief updates S by md.dt, taking m sub-steps for the fast nodes.
+
+	md.dS should hold the master ds of each node for the whole md.dt. Nodes
+	with a ds larger than dsM are fast. The elements touching a fast node are
+	evaluated again in each sub-step with the new Lw of the fast nodes, while
+	the rest of Fs is only found once. The slow nodes of these elements get the
+	time average of their fluxes, so no wetting phase is lost at the interface.
+
+	@returns max ds of one (sub-)step.
+ */
+static double lts_march(MData &md, Mesh &msh, const int m){
+	FuncBegin();
+
+	const arma::vec *rhs;
+	const arma::ivec *idx;
+	const double dtf = md.dt / m;
+	double ds = 0;
+	vector<eleblank*> fele;
+	vector<int> fnode;
+	Node *node;
+
+	//find the fast nodes
+	md.ltsFast.assign(msh.nnode(), 0);
+	md.ltsNFast = 0;
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++){
+		if ( fabs(md.dS.at(i->dd.front().idx)) > md.dsM ){
+			md.ltsFast.at(i->idx) = 1;
+			md.ltsNFast++;
+		}
+	}
+	//find the fast elements and their nodes, slow ones are marked with 2
+	for (list<eleblank*>::iterator i = msh.begele() ; i != msh.endele() ; i++){
+		idx = &(*i)->idxGlob();
+		for (int j = 0 ; j < (*i)->nNode() ; j++){
+			if (md.ltsFast.at( (*idx)(j) ) == 1){
+				fele.push_back(*i);
+				break;
+			}
+		}
+	}
+	for (vector<eleblank*>::iterator i = fele.begin() ; i != fele.end() ; i++){
+		idx = &(*i)->idxGlob();
+		for (int j = 0 ; j < (*i)->nNode() ; j++){
+			if (md.ltsFast.at( (*idx)(j) ) == 0) md.ltsFast.at( (*idx)(j) ) = 2;
+			else continue;
+			fnode.push_back( (*idx)(j) );
+		}
+	}
+	for (int i = 0 ; i < msh.nnode() ; i++) if (md.ltsFast.at(i) == 1) fnode.push_back(i);
+
+	//element part of Fs, the slow boundaries are added at the end
+	md.ltsF = md.Fs;
+	for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++)
+		md.ltsF.at( (*i)->idx() ) -= (*i)->mGammaW();
+
+	//sub-steps
+	for (int k = 0 ; k < m ; k++){
+		//fluxes of the fast elements
+		for (vector<int>::iterator i = fnode.begin() ; i != fnode.end() ; i++) md.Fs.at(*i) = 0;
+		for (vector<eleblank*>::iterator i = fele.begin() ; i != fele.end() ; i++){
+			rhs = &(*i)->rhsS(md.Lw, md.P, 0);
+			idx = &(*i)->idxGlob();
+			for (int j = 0 ; j < (*i)->nNode();  j++)
+				md.Fs.at( (*idx)(j) ) += (*rhs)(j) ;
+		}
+		//replace the fluxes of the slow interface nodes with their average
+		for (vector<int>::iterator i = fnode.begin() ; i != fnode.end() ; i++){
+			if (md.ltsFast.at(*i) != 2) continue;
+			if (k == 0) md.ltsF.at(*i) -= md.Fs.at(*i);
+			md.ltsF.at(*i) += md.Fs.at(*i) / m;
+		}
+		//boundaries of the fast nodes
+		for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++){
+			if (md.ltsFast.at( (*i)->idx() ) != 1) continue;
+			(*i)->findQAll(md.Fs, md.P, md.Lw, md.Ln);
+			(*i)->assemS(md.Fs);
+			add_q(md, **i, dtf);
+		}
+		//update the fast nodes
+		for (vector<int>::iterator i = fnode.begin() ; i != fnode.end() ; i++){
+			if (md.ltsFast.at(*i) != 1) continue;
+			node = &msh.node(*i);
+			md.dS.at(node->dd.front().idx) = md.Fs.at(*i) * dtf / md.dn / md.SPhiV.at(*i);
+			ds = fmax( ds , fabs(md.dS.at(node->dd.front().idx)) );
+			md.S.at(node->dd.front().idx) += md.dS.at(node->dd.front().idx);
+			cmpnode_slave_s(md, *node);
+			cmpnode_sphiv(md, *node);
+			cmpnode_cappil_mobil(md, *node);
+		}
+	}
+
+	//boundaries of the slow nodes, with the averaged fluxes
+	for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++){
+		if (md.ltsFast.at( (*i)->idx() ) == 1) continue;
+		(*i)->findQAll(md.ltsF, md.P, md.Lw, md.Ln);
+		(*i)->assemS(md.ltsF);
+		add_q(md, **i, md.dt);
+	}
+	//update the slow nodes
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++){
+		if (md.ltsFast.at(i->idx) == 1) continue;
+		md.dS.at(i->dd.front().idx) = md.ltsF.at(i->idx) * md.dt / md.dn / md.SPhiV.at(i->idx);
+		ds = fmax( ds , fabs(md.dS.at(i->dd.front().idx)) );
+		md.S.at(i->dd.front().idx) += md.dS.at(i->dd.front().idx);
+		cmpnode_slave_s(md, *i);
+		cmpnode_sphiv(md, *i);
+		cmpnode_cappil_mobil(md, *i);
+	}
+	return ds;
+
+	FuncEnd();
+}
+
+/** @brief finds dt directly from the rate of change of S, smoothed with a PI rule.
+
+	ds of an explicit step is linear in dt, so the admissible dt is known from
+	Fs/SPhiV without any trials. The PI rule works on e = ds/(dsM*ltsMax) of the
+	last two steps and removes the saw tooth pattern of the retry loop. md.dt and
+	md.dS are set for the chosen step.
+
+	@returns max ds of the step.
+ */
+static double pi_dt(MData &md, Mesh &msh){
+	FuncBegin();
+
+	static const double kI = 0.3, kP = 0.4;
+	const double dsT = md.dsM * md.ltsMax;
+	double rate = 0, ds = 0, dtA, dt = md.dt;
+
+	vector<double> mx(md.nthread, 0);
+
+	//admissible dt
+	par_nodes(md, msh, [&](const int t, Node &nd){
+		mx[t] = fmax( mx[t], fabs(md.Fs.at(nd.idx) / md.dn / md.SPhiV.at(nd.idx)) );
+	});
+	rate = dist_max(md, *std::max_element(mx.begin(), mx.end()));
+	dtA = ( rate > 0 ? md.dtSafe * dsT / rate : md.dtM );
+
+	//PI rule, change at most by beta
+	if (md.dtE > 0)
+		dt *= pow(md.dtSafe / md.dtE, kI) * pow(md.dtEOld / md.dtE, kP);
+	dt = fmax( md.dt / md.beta, fmin(md.dt * md.beta, dt) );
+	if (dt > dtA){
+		dt = dtA;
+		md.nDtLim++;
+	}
+	md.dt = fmin(dt, md.dtM);
+	if (md.dt < md.dtm){
+		Error::mess << "min_dt error." << endl
+					<< "dt: " << md.dt << "\tdtm: " << md.dtm;
+		ERRSET();
+	}
+	md.dt = fmin(md.dt, md.tStop - md.t);
+
+	//find ds
+	std::fill(mx.begin(), mx.end(), 0);
+	par_nodes(md, msh, [&](const int t, Node &nd){
+		md.dS.at(nd.dd.front().idx) = md.Fs.at(nd.idx) * md.dt / md.dn / md.SPhiV.at(nd.idx);
+		mx[t] = fmax( mx[t] , fabs(md.dS.at(nd.dd.front().idx)) );
+	});
+	ds = dist_max(md, *std::max_element(mx.begin(), mx.end()));
+	md.dtEOld = ( md.dtE > 0 ? md.dtE : ds / dsT );
+	md.dtE = ds / dsT;
+	return ds;
+
+	FuncEnd();
+}
+
+/** @brief moves S by md.dt with forward euler, P is kept constant.
+
+	dt is found by the time step controller. Fast nodes are sub-cycled if local
+	time stepping is on.
+	@param flag set to true if dt can be increased in the next time step.
+	@returns max ds of the step.
+ */
+static double euler_march(MData &md, Mesh &msh, bool &flag){
+	FuncBegin();
+
+	double ds = 0;
+	vector<double> mx(md.nthread);
+
+	if (md.dtCtrl == MData::DtPI){
+		md.dnIt = 1;
+		ds = pi_dt(md, msh);
+	}
+	else do {
+		md.dnIt++;
+		std::fill(mx.begin(), mx.end(), 0);
+		par_nodes(md, msh, [&](const int t, Node &nd){
+			md.dS.at(nd.dd.front().idx) =	md.Fs.at(nd.idx) * md.dt /md.dn / md.SPhiV.at( nd.idx ) ;
+			mx[t] = fmax( mx[t] , fabs(md.dS.at(nd.dd.front().idx)) );
+		});
+		ds = dist_max(md, *std::max_element(mx.begin(), mx.end()));
+		if (ds > md.dsM * md.ltsMax){
+			md.dt /= md.beta;
+			md.nDtRej++;
+			if ( (md.dt < md.dtm) || ( md.dnIt > md.dnItM ) ){
+			Error::mess << "either min_dt or max_s_iter error." << endl
+						<< "dt: " << md.dt << "\tdtm: " << md.dtm
+						<< " dn_it: " << md.dnIt << "\tdn_max: " << md.dnItM;
+			ERRSET();
+			}
+		}
+		else {
+			if (ds < md.dsm * md.ltsMax) flag = true;
+			break;
+		}
+	}while(true);
+	
+	//sub-cycle the fast nodes if they need more than one step
+	md.ltsM = (int)ceil(ds / md.dsM);
+	if (md.ltsM > 1){
+		ds = lts_march(md, msh, md.ltsM);
+	}
+	else{
+		md.ltsM = 1;
+		md.ltsNFast = 0;
+		//update everything, the ghost nodes are received from their owners
+		par_nodes(md, msh, [&](const int, Node &nd){
+			md.S.at(nd.dd.front().idx) += md.dS.at(nd.dd.front().idx);
+			cmpnode_slave_s(md, nd);
+			cmpnode_sphiv(md, nd);
+			cmpnode_cappil_mobil(md, nd);
+		});
+		if (md.nrank > 1) dist_s(md, msh);
+		//update the fluxes
+		for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++)
+			add_q(md, **i, md.dt);
+	}
+	return ds;
+
+	FuncEnd();
+}
+
+/** @brief wetting phase volume of a node, SIGMA( phi_i * v_i * s_i ) */
+static double cmpnode_w(MData &md, Node &node){
+	FuncBegin();
+	double w = 0;
+	for (list<DuplData>::iterator i = node.dd.begin(); i != node.dd.end() ; i++)
+		w += md.VPhi.at(i->idx) * md.S.at(i->idx);
+	return w;
+	FuncEnd();
+}
+
+/** @brief sets the master saturations from x and updates everything found from them */
+static void simp_set(MData &md, Mesh &msh, Vec x){
+	FuncBegin();
+
+	const PetscScalar *xa;
+	Error::code=VecGetArrayRead(x, &xa);ERRCHK();
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++){
+		md.S.at(i->dd.front().idx) = xa[i->idx];
+		cmpnode_slave_s(md, *i);
+		cmpnode_sphiv(md, *i);
+		cmpnode_cappil_mobil(md, *i);
+	}
+	Error::code=VecRestoreArrayRead(x, &xa);ERRCHK();
+
+	FuncEnd();
+}
+
+/** @brief residual of the implicit S equation.
+
+	R = dn * (W(S) - W(S_old)) - dt * Fs(S) where W is the wetting phase volume
+	of each node. For constant saturation nodes R = S - S_old. The function is
+	called by Petsc so it returns an error code instead of throwing.
+*/
+static PetscErrorCode simp_residual(SNES snes, Vec x, Vec r, void *ctx){
+	MData &md = *(MData*)ctx;
+	Mesh &msh = *md.mesh;
+	PetscScalar *ra;
+	PetscErrorCode ierr;
+
+	try{
+		simp_set(md, msh, x);
+		assem_s(md, msh, false);
+	}
+	catch(...){
+		SETERRQ(PETSC_COMM_SELF, PETSC_ERR_LIB, "could not find the S residual");
+	}
+	ierr = VecGetArray(r, &ra);CHKERRQ(ierr);
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++)
+		ra[i->idx] = md.dn * ( cmpnode_w(md, *i) - md.Wn[i->idx] ) - md.dt * md.Fs[i->idx];
+	for (vector<int>::iterator i = md.sconst.begin() ; i != md.sconst.end() ; i++)
+		ra[*i] = md.S[ msh.node(*i).dd.front().idx ] - md.Sn[*i];
+	ierr = VecRestoreArray(r, &ra);CHKERRQ(ierr);
+
+	return 0;
+}
+
+/** @brief analytic jacobian of simp_residual.
+
+	The derivatives of the mobilities are found from KFunc::dw, KFunc::dnw and
+	JFunc::ds (for the slave dupls). The upwind nodes and P are constant.
+*/
+static PetscErrorCode simp_jacobian(SNES snes, Vec x, Mat J, Mat Jp, void *ctx){
+	MData &md = *(MData*)ctx;
+	Mesh &msh = *md.mesh;
+	arma::mat loc;
+	const arma::mat *jac;
+	const arma::ivec *idx;
+	double dsm;
+	PetscErrorCode ierr;
+
+	try{
+		simp_set(md, msh, x);
+		//mobility derivatives
+		for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++){
+			for (list<DuplData>::iterator j = i->dd.begin(); j != i->dd.end() ; j++){
+				dsm = ( j == i->dd.begin() ? 1 :
+						md.J->ds(md.S.at(i->dd.front().idx), i->dd.front().reg->pd, j->reg->pd) );
+				md.dLw.at(j->idx) = j->reg->kr->dw( md.S.at(j->idx) ) * dsm;
+				md.dLn.at(j->idx) = j->reg->kr->dnw( md.S.at(j->idx) ) / md.dm * dsm;
+			}
+		}
+		//elements
+		ierr = MatZeroEntries(Jp);CHKERRQ(ierr);
+		for (list<eleblank*>::iterator i = msh.begele() ; i != msh.endele() ; i++){
+			jac = &(*i)->jacS(md.dLw, md.P);
+			idx = &(*i)->idxGlob();
+			loc = *jac;
+			loc *= -md.dt;
+			ierr = MatSetValues(Jp,
+								(*i)->nNode(), idx->memptr(),
+								(*i)->nNode(), idx->memptr(),
+								loc.memptr(), ADD_VALUES);CHKERRQ(ierr);
+		}
+		//accumulation and boundaries
+		for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++){
+			ierr = MatSetValue(Jp, i->idx, i->idx, md.dn * md.SPhiV.at(i->idx), ADD_VALUES);CHKERRQ(ierr);
+		}
+		for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++){
+			if ((*i)->isSConst()) continue;
+			ierr = MatSetValue(Jp, (*i)->idx(), (*i)->idx(),
+							   -md.dt * (*i)->dQW(md.Lw, md.Ln, md.dLw, md.dLn), ADD_VALUES);CHKERRQ(ierr);
+		}
+	}
+	catch(...){
+		SETERRQ(PETSC_COMM_SELF, PETSC_ERR_LIB, "could not find the S jacobian");
+	}
+	ierr = MatAssemblyBegin(Jp, MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatAssemblyEnd(Jp, MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatZeroRows(Jp, md.sconst.size(), (md.sconst.size() ? &md.sconst[0] : NULL),
+					   1, NULL, NULL);CHKERRQ(ierr);
+	if (J != Jp){
+		ierr = MatAssemblyBegin(J, MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+		ierr = MatAssemblyEnd(J, MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	}
+
+	return 0;
+}
+
+/** @brief creates the SNES and the jacobian of the implicit S equation.
+
+	The jacobian has the same sparsity as A so it is duplicated from it. This
+	must be done before A is destroyed by pshell_setup. The SNES reads its
+	options with the s_ prefix, e.g. -s_snes_rtol, so that they do not mix with
+	the options of the p equation.
+ */
+static void simp_setup(MData &md, Mesh &msh){
+	FuncBegin();
+
+	Error::code=MatDuplicate(md.A, MAT_DO_NOT_COPY_VALUES, &md.Js);ERRCHK();
+	Error::code=MatSetOption(md.Js, MAT_ROW_ORIENTED, PETSC_FALSE);ERRCHK();
+	Error::code=MatSetOption(md.Js, MAT_NEW_NONZERO_LOCATION_ERR, PETSC_TRUE);ERRCHK();
+	Error::code=MatSetOption(md.Js, MAT_KEEP_NONZERO_PATTERN, PETSC_TRUE);ERRCHK();
+	Error::code=VecDuplicate(md.Pvec, &md.Sx);ERRCHK();
+	Error::code=VecDuplicate(md.Pvec, &md.Sr);ERRCHK();
+	md.Sn.resize(msh.nnode(), 0);
+	md.Wn.resize(msh.nnode(), 0);
+	md.dLw.resize(msh.ndd(), 0);
+	md.dLn.resize(msh.ndd(), 0);
+	md.sconst.clear();
+	for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++)
+		if ((*i)->isSConst()) md.sconst.push_back((*i)->idx());
+
+	Error::code=SNESCreate(PETSC_COMM_SELF, &md.snes);ERRCHK();
+	Error::code=SNESSetOptionsPrefix(md.snes, "s_");ERRCHK();
+	Error::code=SNESSetType(md.snes, SNESNEWTONLS);ERRCHK();
+	Error::code=SNESSetFunction(md.snes, md.Sr, simp_residual, &md);ERRCHK();
+	Error::code=SNESSetJacobian(md.snes, md.Js, md.Js, simp_jacobian, &md);ERRCHK();
+	Error::code=SNESSetFromOptions(md.snes);ERRCHK();
+
+	FuncEnd();
+}
+
+/** @brief moves S by md.dt with backward euler, P is kept constant.
+
+	If SNES does not converge, or ds is larger than sImpDsM, dt is divided by
+	beta and the step is tried again.
+	@param flag set to true if dt can be increased in the next time step.
+	@returns max ds of the step.
+ */
+static double simp_march(MData &md, Mesh &msh, bool &flag){
+	FuncBegin();
+
+	SNESConvergedReason reason;
+	PetscInt its;
+	PetscScalar *xa;
+	double ds;
+
+	//save the old state
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++){
+		md.Sn.at(i->idx) = md.S.at(i->dd.front().idx);
+		md.Wn.at(i->idx) = cmpnode_w(md, *i);
+	}
+
+	do{
+		md.dnIt++;
+		//start from the old saturations
+		Error::code=VecGetArray(md.Sx, &xa);ERRCHK();
+		for (int i = 0 ; i < msh.nnode() ; i++) xa[i] = md.Sn[i];
+		Error::code=VecRestoreArray(md.Sx, &xa);ERRCHK();
+		//solve
+		Error::code=SNESSolve(md.snes, NULL, md.Sx);ERRCHK();
+		Error::code=SNESGetConvergedReason(md.snes, &reason);ERRCHK();
+		Error::code=SNESGetIterationNumber(md.snes, &its);ERRCHK();
+		md.nSNESIt += its;
+		//check ds
+		ds = 0;
+		if (reason > 0){
+			Error::code=VecGetArray(md.Sx, &xa);ERRCHK();
+			for (int i = 0 ; i < msh.nnode() ; i++) ds = fmax(ds, fabs(xa[i] - md.Sn[i]));
+			Error::code=VecRestoreArray(md.Sx, &xa);ERRCHK();
+			if (ds <= md.sImpDsM) break;
+		}
+		md.dt /= md.beta;
+		md.nDtRej++;
+		if ( (md.dt < md.dtm) || ( md.dnIt > md.dnItM ) ){
+			Error::mess << "either min_dt or max_s_iter error." << endl
+						<< "dt: " << md.dt << "\tdtm: " << md.dtm
+						<< " dn_it: " << md.dnIt << "\tdn_max: " << md.dnItM
+						<< " snes reason: " << reason;
+			ERRSET();
+		}
+	}while(true);
+	flag = ( (its <= md.sImpIt) && (ds * md.beta < md.sImpDsM) );
+
+	//state and boundary fluxes at the new saturation
+	simp_set(md, msh, md.Sx);
+	assem_s(md, msh, false);
+	for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++)
+		add_q(md, **i, md.dt);
+	md.ltsM = 1;
+	md.ltsNFast = 0;
+	return ds;
+
+	FuncEnd();
+}
+
+/** @brief sets the master saturations from u and updates everything found from them */
+static void rk_set(MData &md, Mesh &msh, const vector<double> &u){
+	FuncBegin();
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++){
+		md.S.at(i->dd.front().idx) = u.at(i->idx);
+		cmpnode_slave_s(md, *i);
+		cmpnode_sphiv(md, *i);
+		cmpnode_cappil_mobil(md, *i);
+	}
+	FuncEnd();
+}
+
+/** @brief finds u + dt * Fs / dn / SPhiV, i.e. one forward euler step from the current Fs.
+
+	@returns max change.
+ */
+static double rk_euler(MData &md, Mesh &msh, const vector<double> &u, vector<double> &v){
+	FuncBegin();
+	double ds = 0, d;
+	for (int i = 0 ; i < msh.nnode() ; i++){
+		d = md.Fs.at(i) * md.dt / md.dn / md.SPhiV.at(i);
+		ds = fmax( ds , fabs(d) );
+		v.at(i) = u.at(i) + d;
+	}
+	return ds;
+	FuncEnd();
+}
+
+/** @brief moves S by md.dt with a strong stability preserving Runge-Kutta method.
+
+	SSP-RK2 (Heun) uses the first euler stage as its embedded first order
+	solution and SSP-RK3 (Shu-Osher) uses the SSP-RK2 built from its first two
+	stages. Their difference is the local error. If it is larger than rkTol dt
+	is reduced and the step is tried again, otherwise the next dt is found from
+	it and saved in dtNext. Each euler stage is still limited by dsM, which is
+	required for the stability of the scheme. P is kept constant.
+
+	@returns max ds of the step.
+ */
+static double rk_march(MData &md, Mesh &msh){
+	FuncBegin();
+
+	static const double b2[] = {.5, .5}, b3[] = {1./6, 1./6, 2./3};
+	const int order = ( md.sscheme == MData::SSSPRK3 ? 3 : 2 );
+	const double *b = ( order == 3 ? b3 : b2 );
+	const double q0[] = {md.qIn, md.qOut, md.qWin, md.qWout};
+	vector<double> &u0 = md.rkS0, &u1 = md.rkS1, &u2 = md.rkS2;
+	double ds = 0, err = 0, fac;
+	bool ok;
+
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++)
+		u0.at(i->idx) = md.S.at(i->dd.front().idx);
+
+	do{
+		md.dnIt++;
+		if (md.dnIt > 1){
+			//start over
+			rk_set(md, msh, u0);
+			assem_s(md, msh, false);
+			md.qIn = q0[0]; md.qOut = q0[1]; md.qWin = q0[2]; md.qWout = q0[3];
+		}
+		//stage 1: u1 = u0 + dt L(u0)
+		ok = ( rk_euler(md, msh, u0, u1) <= md.dsM );
+		for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++)
+			add_q(md, **i, b[0] * md.dt);
+		//stage 2: u2 = u1 + dt L(u1)
+		if (ok){
+			rk_set(md, msh, u1);
+			assem_s(md, msh, false);
+			ok = ( rk_euler(md, msh, u1, u2) <= md.dsM );
+			for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++)
+				add_q(md, **i, b[1] * md.dt);
+		}
+		if (ok && (order == 2) ){
+			//Heun: (u0 + u2) / 2, embedded: u1
+			err = 0;
+			for (int i = 0 ; i < msh.nnode() ; i++){
+				u2.at(i) = .5 * ( u0.at(i) + u2.at(i) );
+				err = fmax( err, fabs(u2.at(i) - u1.at(i)) );
+			}
+		}
+		else if (ok){
+			//Shu-Osher: u2 = 3/4 u0 + 1/4 u2,  embedded: 1/2 u0 + 1/2 u2
+			err = 0;
+			for (int i = 0 ; i < msh.nnode() ; i++){
+				u1.at(i) = .5 * ( u0.at(i) + u2.at(i) );
+				u2.at(i) = .75 * u0.at(i) + .25 * u2.at(i);
+			}
+			//stage 3: u3 = 1/3 u0 + 2/3 ( u2 + dt L(u2) ) stored in u2
+			rk_set(md, msh, u2);
+			assem_s(md, msh, false);
+			ok = ( rk_euler(md, msh, u2, u2) <= md.dsM );
+			for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++)
+				add_q(md, **i, b[2] * md.dt);
+			for (int i = 0 ; i < msh.nnode() ; i++){
+				u2.at(i) = u0.at(i) / 3. + 2. * u2.at(i) / 3.;
+				err = fmax( err, fabs(u2.at(i) - u1.at(i)) );
+			}
+		}
+		//accept or reject
+		if ( ok && (err <= md.rkTol) ) break;
+		fac = ( ok ? md.dtSafe * pow(md.rkTol / err, 1. / order) : 0 );
+		md.dt *= fmax( 1. / md.beta, fac );
+		md.nDtRej++;
+		if ( (md.dt < md.dtm) || ( md.dnIt > md.dnItM ) ){
+			Error::mess << "either min_dt or max_s_iter error." << endl
+						<< "dt: " << md.dt << "\tdtm: " << md.dtm
+						<< " dn_it: " << md.dnIt << "\tdn_max: " << md.dnItM
+						<< " rk_err: " << err;
+			ERRSET();
+		}
+	}while(true);
+
+	//new state
+	rk_set(md, msh, u2);
+	for (int i = 0 ; i < msh.nnode() ; i++) ds = fmax( ds, fabs(u2.at(i) - u0.at(i)) );
+	md.rkErr = err;
+	fac = ( err > 0 ? md.dtSafe * pow(md.rkTol / err, 1. / order) : md.beta );
+	md.dtNext = md.dt * fmax( 1. / md.beta, fmin(md.beta, fac) );
+	md.ltsM = 1;
+	md.ltsNFast = 0;
+	return ds;
+
+	FuncEnd();
+}
+
+/** @brief max |Fs / dn / SPhiV|, i.e. the rate of change of S at the current state */
+static double cmp_rate(MData &md, Mesh &msh){
+	FuncBegin();
+	double rate = 0;
+	for (vector<Node*>::iterator i = msh.begownnode() ; i < msh.endownnode() ; i++)
+		rate = fmax( rate, fabs(md.Fs.at((*i)->idx) / md.dn / md.SPhiV.at((*i)->idx)) );
+	return dist_max(md, rate);
+	FuncEnd();
+}
+
+/** @brief checks if the steady state is reached and acts on it.
+
+	The steady state is detected when, in the last steadyWin time steps, the rate
+	of change of S was less than steadyTol and the wetting phase that entered the
+	reservoir differed from the one that left it by less than steadyTol (relative).
+	Then the simulation is either stopped, or it goes on in pseudo-transient mode:
+	implicit S with dt growing as fast as the rate decreases (switched evolution
+	relaxation), until the rate is less than steadyPtcTol or steadyPtcMax steps
+	are taken. The time of this mode is not physical, so at its end t, the
+	fluxes and the settings it changed are set back to the ones of the steady
+	state, and the final state is written with them.
+ */
+static void steady_check(MData &md){
+	FuncBegin();
+
+	static const double ptcGrow = 10;
+	const int n = md.steadyWin + 1,
+		k = md.nStep % n,
+		k0 = (k + 1) % n;
+	double rate = 0, dqi, dqo;
+
+	//pseudo-transient mode
+	if (md.steadyState == MData::SteadyPTC){
+		if ( (md.stRate < md.steadyPtcTol) || (md.nStep - md.steadyStep >= md.steadyPtcMax) ){
+			cout << "Pseudo-transient continuation "
+				 << (md.stRate < md.steadyPtcTol ? "converged" : "stopped")
+				 << " after " << md.nStep - md.steadyStep << " steps, rate: " << md.stRate << endl;
+			md.steadyState = MData::SteadyDone;
+			md.t = md.tEnd = md.steadyT;
+			md.qIn = md.steadyQ[0]; md.qOut = md.steadyQ[1];
+			md.qWin = md.steadyQ[2]; md.qWout = md.steadyQ[3];
+			md.sscheme = (MData::SScheme)md.steadyScheme;
+			md.sImpDsM = md.steadyDsM;
+			md.ltsMax = md.steadyLts;
+			md.dtM = md.steadyDtM;
+		}
+		else
+			md.dtNext = md.dt * fmin( ptcGrow, md.stRateOld / fmax(md.stRate, 1e-300) );
+		md.stRateOld = md.stRate;
+		return;
+	}
+
+	//window of the last steps
+	md.stRates.at(k) = md.stRate;
+	md.stQWin.at(k) = md.qWin;
+	md.stQWout.at(k) = md.qWout;
+	if (md.nStep < n) return;
+	for (int i = 0 ; i < n ; i++) rate = fmax( rate, md.stRates.at(i) );
+	dqi = md.qWin - md.stQWin.at(k0);
+	dqo = md.qWout - md.stQWout.at(k0);
+	if ( (rate >= md.steadyTol) || (fabs(dqi - dqo) > md.steadyTol * (dqi + dqo)) ) return;
+
+	//steady state found
+	cout << "Steady state detected at t: " << md.t << " step: " << md.nStep
+		 << " clock: " << md.cT << " steps saved: about "
+		 << (long)( (md.tEnd - md.t) / md.dt ) << endl;
+	md.steadyStep = md.nStep;
+	if (md.steadyPtc){
+		md.steadyState = MData::SteadyPTC;
+		md.steadyT = md.t;
+		md.steadyQ[0] = md.qIn; md.steadyQ[1] = md.qOut;
+		md.steadyQ[2] = md.qWin; md.steadyQ[3] = md.qWout;
+		md.steadyScheme = md.sscheme;
+		md.steadyDsM = md.sImpDsM;
+		md.steadyLts = md.ltsMax;
+		md.steadyDtM = md.dtM;
+		md.sscheme = MData::SImplicit;
+		md.sImpDsM = 1;
+		md.ltsMax = 1;
+		md.dtM = md.tEnd = HUGE_VAL;
+		md.stRateOld = md.stRate;
+	}
+	else{
+		md.steadyState = MData::SteadyDone;
+		md.tEnd = md.t;
+	}
+
+	FuncEnd();
+}
+
+/** @brief forks a child of a run on one process, for parareal, the ensemble and the daemon.
+
+	MPI and PETSc are initialized before the fork and the child inherits them. That
+	is only safe when the child makes no MPI call that talks to another process: the
+	run must be on one process, so that md.comm is PETSC_COMM_SELF and every PETSc
+	object of the child is on PETSC_COMM_SELF, and the child leaves with _exit,
+	without PetscFinalize or MPI_Finalize. Some MPI transports do not allow a fork
+	at all, e.g. InfiniBand verbs; df2d should then be started without mpirun, or
+	with a shared memory/tcp transport.
+	@param what the child, for the error message.
+	@returns the pid from fork, 0 in the child.
+ */
+static pid_t fork_child(MData &md, const string &what){
+	FuncBegin();
+
+	pid_t pid;
+
+	if ( (md.nrank > 1) || (md.comm != PETSC_COMM_SELF) ){
+		Error::mess << "could not fork " << what << ", it is only done on one process";
+		ERRSET();
+	}
+	//the child must not write again what is buffered
+	cout.flush();
+	fflush(NULL);
+	pid = fork();
+	if (pid < 0){
+		Error::mess << "could not fork " << what;
+		ERRSET();
+	}
+	return pid;
+
+	FuncEnd();
+}
+
+/** @brief reads exactly n bytes from a pipe.
+	@returns false if the pipe was closed before.
+ */
+static bool pipe_read(int fd, void *buf, size_t n){
+	char *p = (char*)buf;
+	ssize_t r;
+	while (n > 0){
+		r = read(fd, p, n);
+		if (r <= 0) return false;
+		p += r;
+		n -= r;
+	}
+	return true;
+}
+
+/** @brief writes exactly n bytes to a pipe.
+	@returns false if the pipe was closed before.
+ */
+static bool pipe_write(int fd, const void *buf, size_t n){
+	const char *p = (const char*)buf;
+	ssize_t r;
+	while (n > 0){
+		r = write(fd, p, n);
+		if (r <= 0) return false;
+		p += r;
+		n -= r;
+	}
+	return true;
+}
+
+/** @brief parareal coarse propagator: moves the master saturations u from ta to tb.
+
+	P is solved once at ta and is kept constant. S is moved with the implicit
+	scheme using prCoarse equal time steps, as long as they converge. The flux
+	totals are not changed.
+ */
+static void parareal_coarse(MData &md, Mesh &msh, vector<double> &u,
+							const double ta, const double tb){
+	FuncBegin();
+
+	const double q0[] = {md.qIn, md.qOut, md.qWin, md.qWout};
+	const double dsM = md.sImpDsM;
+	const double dt = (tb - ta) / md.prCoarse;
+	bool flag;
+
+	rk_set(md, msh, u);
+	solve_p(md, msh);
+	assem_s(md, msh, true);
+	md.sImpDsM = 1;
+	for (md.t = ta ; md.t < tb - 1e-12 * (tb - ta) ; md.t += md.dt){
+		md.dt = fmin(dt, tb - md.t);
+		md.dnIt = 0;
+		simp_march(md, msh, flag);
+	}
+	md.sImpDsM = dsM;
+	md.qIn = q0[0]; md.qOut = q0[1]; md.qWin = q0[2]; md.qWout = q0[3];
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++)
+		u.at(i->idx) = md.S.at(i->dd.front().idx);
+
+	FuncEnd();
+}
+
+/** @brief an output inside a parareal slice, kept by the fine propagator */
+struct PrOutput{
+	double t;         /**< @brief time of the output */
+	double q[4];      /**< @brief qIn, qOut, qWin and qWout since the start of the slice */
+	vector<double> u; /**< @brief the master saturations */
+};
+
+/** @brief parareal fine propagator: moves the master saturations u from ta to tb.
+
+	Uses marchintime with all its options, starting from the initial dt. The
+	flux totals are set to the change during the slice. After every step that
+	goes past an output time, i.e. t0 + j * tWrite, the state is kept in o, as
+	writeintime would write it; the end of the slice is left to the caller.
+ */
+static void parareal_fine(MData &md, Mesh &msh, vector<double> &u, vector<PrOutput> &o,
+						  const double ta, const double tb, const double dt0){
+	FuncBegin();
+
+	double t1;
+
+	rk_set(md, msh, u);
+	md.LtP.clear();
+	md.qIn = md.qOut = md.qWin = md.qWout = 0;
+	md.t = ta;
+	md.tStop = tb;
+	md.dt = dt0;
+	o.clear();
+	while ( md.t < tb - 1e-12 * (tb - ta) ){
+		md.dt = fmin(md.dt, tb - md.t);
+		t1 = md.t;
+		driver::marchintime(md, msh);
+		if ( (md.tWrite > 0) && ( md.t < tb - 1e-12 * (tb - ta) ) &&
+			 ( floor( (md.t - md.t0) / md.tWrite ) > floor( (t1 - md.t0) / md.tWrite ) ) ){
+			PrOutput out = {md.t, {md.qIn, md.qOut, md.qWin, md.qWout}, vector<double>(msh.nnode())};
+			for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++)
+				out.u.at(i->idx) = md.S.at(i->dd.front().idx);
+			o.push_back(out);
+		}
+	}
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++)
+		u.at(i->idx) = md.S.at(i->dd.front().idx);
+
+	FuncEnd();
+}
+
+/** @brief runs the fine propagator on slices n0 .. n1-1 in child processes.
+
+	Elements and bvertices keep the upwind nodes and boundary fluxes of a run, so
+	the slices are run in forked processes instead of threads. Each child has its own copy of MData and Mesh and sends
+	back its u, its flux totals, its wall time and its outputs through a pipe. At most prNp
+	children run at the same time.
+	@param u the start of each slice, the end of each slice is written in f.
+	@param q the flux totals of each slice.
+	@param w the wall time of each slice.
+	@param o the outputs inside each slice.
+ */
+static void parareal_fines(MData &md, Mesh &msh, const int n0, const int n1,
+						   const vector<double> &T, const vector< vector<double> > &u,
+						   vector< vector<double> > &f, vector< vector<double> > &q,
+						   vector<double> &w, vector< vector<PrOutput> > &o, const double dt0){
+	FuncBegin();
+
+	vector<int> fd(n1 - n0, -1);
+	vector<pid_t> pid(n1 - n0, -1);
+	int p[2], status;
+	bool ok = true;
+
+	for (int b = n0 ; b < n1 ; b += md.prNp){
+		const int e = std::min(n1, b + md.prNp);
+		//start the children
+		for (int n = b ; n < e ; n++){
+			if (pipe(p) != 0){
+				Error::mess << "could not create a pipe for parareal slice " << n;
+				ERRSET();
+			}
+			stringstream what;
+			what << "parareal slice " << n;
+			pid[n - n0] = fork_child(md, what.str());
+			if (pid[n - n0] == 0){
+				close(p[0]);
+				try{
+					PetscLogDouble w0, w1;
+					vector<double> un(u[n]);
+					vector<PrOutput> on;
+					double qn[5];
+					int no;
+					PetscTime(&w0);
+					parareal_fine(md, msh, un, on, T[n], T[n+1], dt0);
+					PetscTime(&w1);
+					qn[0] = md.qIn; qn[1] = md.qOut; qn[2] = md.qWin; qn[3] = md.qWout;
+					qn[4] = w1 - w0;
+					no = on.size();
+					if ( !pipe_write(p[1], &un[0], un.size() * sizeof(double)) ||
+						 !pipe_write(p[1], qn, sizeof(qn)) || !pipe_write(p[1], &no, sizeof(no)) ) _exit(1);
+					for (int i = 0 ; i < no ; i++)
+						if ( !pipe_write(p[1], &on[i].t, sizeof(on[i].t)) ||
+							 !pipe_write(p[1], on[i].q, sizeof(on[i].q)) ||
+							 !pipe_write(p[1], &on[i].u[0], on[i].u.size() * sizeof(double)) ) _exit(1);
+				}
+				catch(...){
+					_exit(1);
+				}
+				close(p[1]);
+				_exit(0);
+			}
+			close(p[1]);
+			fd[n - n0] = p[0];
+		}
+		//collect their results
+		for (int n = b ; n < e ; n++){
+			double qn[5];
+			int no = 0;
+			f[n+1].resize(msh.nnode());
+			ok = ok && pipe_read(fd[n - n0], &f[n+1][0], msh.nnode() * sizeof(double));
+			ok = ok && pipe_read(fd[n - n0], qn, sizeof(qn));
+			ok = ok && pipe_read(fd[n - n0], &no, sizeof(no));
+			o[n].resize(ok ? no : 0);
+			for (int i = 0 ; i < (int)o[n].size() ; i++){
+				o[n][i].u.resize(msh.nnode());
+				ok = ok && pipe_read(fd[n - n0], &o[n][i].t, sizeof(o[n][i].t));
+				ok = ok && pipe_read(fd[n - n0], o[n][i].q, sizeof(o[n][i].q));
+				ok = ok && pipe_read(fd[n - n0], &o[n][i].u[0], msh.nnode() * sizeof(double));
+			}
+			close(fd[n - n0]);
+			waitpid(pid[n - n0], &status, 0);
+			ok = ok && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+			q[n].assign(qn, qn + 4);
+			w[n] = qn[4];
+		}
+		if (!ok){
+			Error::mess << "a parareal slice failed, between " << T[b] << " and " << T[e];
+			ERRSET();
+		}
+	}
+
+	FuncEnd();
+}
+
+/************************************************************************
+ * ensemble stuff
+ ************************************************************************/
+
+/** @brief directory of ensemble member m, ending with / */
+static string ensemble_dir(MData &md, const int m){
+	std::stringstream ss;
+	ss << md.dir << "member" << m << "/";
+	return ss.str();
+}
+
+/** @brief changes the regions of the mesh to the ones of an ensemble member.
+
+	Reads the $regiondata of dir/solver.config, if the file exists. Each region
+	must already be in the mesh with the same id and type. phi, kr and the
+	boundary values may change. pd, k and e are part of the geometry and the
+	master regions that are shared by all the members, so they must not.
+ */
+static void ensemble_regions(MData &md, Mesh &msh, const string &dir){
+	FuncBegin();
+
+	AsciiFile cfile;
+	string regtype, str;
+	double val, pd, phi, k, e;
+	int id;
+	KFunc *kr;
+	Region *reg;
+
+	if ( access( (dir + adrsol).c_str(), R_OK ) != 0 ) return;
+	cfile.open(dir + adrsol);
+	cfile.efind("$regiondata");
+	while ( cfile.find("$region") ){
+		cfile(); cfile("type"); cfile(regtype,"type_value");
+		cfile(); cfile("id"); cfile(id, "id_value");
+		//find the region
+		reg = NULL;
+		for (list<Region*>::iterator i = msh.begreg() ; i != msh.endreg() ; i++){
+			if ( ( (*i)->ID == id ) &&
+				 ( ( (regtype.compare("frac") == 0) && dynamic_cast<RegionPorousFrac*>(*i) ) ||
+				   ( (regtype.compare("mat") == 0) && dynamic_cast<RegionPorousMat*>(*i) ) ||
+				   ( (regtype.compare("bnd") == 0) && dynamic_cast<RegionBoundary*>(*i) ) ) )
+				reg = *i;
+		}
+		if (!reg){
+			Error::mess << "region " << regtype << " " << id << " is not in the mesh. "
+						<< cfile.fn << ", line: " << cfile.ln;
+			ERRSET();
+		}
+		//porous
+		if (regtype.compare("bnd") != 0){
+			RegionPorous *preg = static_cast<RegionPorous*>(reg);
+			bool same;
+			cfile(); cfile("phi"); cfile(phi, "phi_value");
+			cfile(); cfile("pd"); cfile(pd, "pd_value");
+			cfile(); cfile("kr"); kr = readregion_kr(cfile);
+			if (regtype.compare("frac") == 0){
+				RegionPorousFrac *freg = static_cast<RegionPorousFrac*>(reg);
+				cfile(); cfile("k"); cfile(k, "k_value");
+				cfile(); cfile("e"); cfile(e, "e_value");
+				same = (k == freg->k) && (e == freg->e);
+			}
+			else{
+				cfile(); cfile("k"); cfile(str, "k_value");
+				RegionPorousMat tmp(str);
+				RegionPorousMat *mreg = static_cast<RegionPorousMat*>(reg);
+				same = (tmp.k(0,0) == mreg->k(0,0)) && (tmp.k(0,1) == mreg->k(0,1)) &&
+					(tmp.k(1,0) == mreg->k(1,0)) && (tmp.k(1,1) == mreg->k(1,1));
+			}
+			if ( !same || (pd != preg->pd) ){
+				delete kr;
+				Error::mess << "pd, k and e of region " << id << " can not change in an ensemble member. "
+							<< cfile.fn << ", line: " << cfile.ln;
+				ERRSET();
+			}
+			preg->phi = phi;
+			delete preg->kr;
+			preg->kr = kr;
+		}
+		//bnd, the types decide the bvertex classes so they stay the same
+		else{
+			RegionBoundary *breg = static_cast<RegionBoundary*>(reg);
+			string pstr;
+			cfile(); cfile("stype"); cfile(str, "stype_value");
+			cfile(); cfile("ptype"); cfile(pstr, "ptype_value");
+			cfile(); cfile("value"); cfile(val, "value_value");
+			const bool same =
+				( str.compare( breg->stype == RegionBoundary::SSConst ? "sconst" : "gpczero" ) == 0 ) &&
+				( pstr.compare( breg->ptype == RegionBoundary::PPConst ? "pconst" : "qconst" ) == 0 );
+			if (!same){
+				Error::mess << "stype and ptype of region " << id << " can not change in an ensemble member. "
+							<< cfile.fn << ", line: " << cfile.ln;
+				ERRSET();
+			}
+			breg->val[0] = val;
+		}
+	}
+	for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++)
+		(*i)->updateValue(md.dp);
+
+	FuncEnd();
+}
+
+/** @brief runs ensemble member m, in a child process.
+
+	The mesh, its geometry and the sparsity of the p matrix were made once by
+	the parent and are shared. The member only changes the regions and the
+	initial condition and writes in its own directory, where the output of the
+	run goes to df2d.log.
+ */
+static void ensemble_member(MData &md, Mesh &msh, const int m){
+	FuncBegin();
+
+	const string dir = ensemble_dir(md, m);
+
+	if ( !freopen( (dir + "df2d.log").c_str(), "w", stdout ) ){
+		Error::mess << "could not write in " << dir;
+		ERRSET();
+	}
+	md.dir = dir;
+	mkdir( (dir + "result").c_str(), 0755 );
+	mkdir( (dir + "restart").c_str(), 0755 );
+	ensemble_regions(md, msh, dir);
+	if ( access( (dir + adrini).c_str(), R_OK ) == 0 ) driver::readinitial(md, msh);
+	driver::solve(md, msh);
+	cout << "Member " << m << " finished in " << md.cT << " seconds." << endl;
+	cout.flush();
+
+	FuncEnd();
+}
+
+/************************************************************************
+ * daemon stuff
+ ************************************************************************/
+
+/** @brief FNV-1a hash of n bytes, continuing from h */
+static uint64_t fnv_hash(const void *buf, const size_t n, uint64_t h = 14695981039346656037ULL){
+	const unsigned char *p = (const unsigned char*)buf;
+	for (size_t i = 0 ; i < n ; i++){
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/** @brief FNV-1a hash of a file, continuing from h. A missing file changes nothing */
+static uint64_t fnv_file(const string &adr, uint64_t h){
+	std::ifstream fl(adr.c_str(), std::ios::binary);
+	char buf[65536];
+	while (fl){
+		fl.read(buf, sizeof(buf));
+		h = fnv_hash(buf, fl.gcount(), h);
+	}
+	return h;
+}
+
+/** @brief the mesh files of md.meshtype */
+static vector<string> mesh_files(MData &md){
+	vector<string> f;
+	if (md.meshtype == MData::MeshGmsh) f.push_back(md.dir + adrmesh + ".msh");
+	else{
+		f.push_back(md.dir + adrmesh + ".node");
+		f.push_back(md.dir + adrmesh + ".ele");
+		f.push_back(md.dir + adrmesh + ".poly");
+	}
+	return f;
+}
+
+/** @brief hash of the mesh files of md.meshtype, continuing from h */
+static uint64_t meshfile_hash(MData &md, uint64_t h){
+	const vector<string> f = mesh_files(md);
+	for (size_t i = 0 ; i < f.size() ; i++) h = fnv_file(f[i], h);
+	return h;
+}
+
+/** @brief hash of what a constructed mesh depends on, besides the mesh files.
+
+	The mesh type, dp, gravity, the J model with its parameters as they are
+	and the parts of the regions that go into the geometry and the master
+	regions.
+ */
+static uint64_t geo_hash(MData &md, Mesh &regs){
+	FuncBegin();
+
+	std::ostringstream ss;
+	uint64_t h;
+
+	ss << std::setprecision(17) << md.meshtype << " " << md.dp << " " << md.grav.gw << " "
+	   << md.grav.gn << " " << md.grav.x0 << " " << md.grav.y0 << " " << md.grav.xdir << " "
+	   << md.grav.ydir << " " << md.J->name() << "\n";
+	const vector<double> jp = md.J->params();
+	for (list<Region*>::iterator i = regs.begreg() ; i != regs.endreg() ; i++){
+		RegionPorousMat *mreg = dynamic_cast<RegionPorousMat*>(*i);
+		RegionPorousFrac *freg = dynamic_cast<RegionPorousFrac*>(*i);
+		RegionBoundary *breg = dynamic_cast<RegionBoundary*>(*i);
+		ss << (*i)->ID << " ";
+		if (mreg) ss << "mat " << mreg->pd << " " << mreg->k(0,0) << " " << mreg->k(0,1) << " "
+					 << mreg->k(1,0) << " " << mreg->k(1,1) << "\n";
+		if (freg) ss << "frac " << freg->pd << " " << freg->k << " " << freg->e << "\n";
+		if (breg) ss << "bnd " << breg->stype << " " << breg->ptype << "\n";
+	}
+	h = fnv_hash(ss.str().data(), ss.str().size());
+	if (!jp.empty()) h = fnv_hash(&jp[0], jp.size() * sizeof(double), h);
+	return h;
+
+	FuncEnd();
+}
+
+/** @brief hash of everything a constructed mesh depends on.
+
+	The mesh files and geo_hash. Two cases with the same hash can run on the
+	same mesh once ensemble_regions has set phi, kr and the boundary values.
+ */
+static uint64_t mesh_hash(MData &md, Mesh &regs){
+	return meshfile_hash(md, geo_hash(md, regs));
+}
+
+/** @brief a constructed mesh kept by the daemon */
+struct MeshCache{
+	uint64_t hash; /**< @brief mesh_hash of the cases it was made for */
+	Mesh *msh;     /**< @brief the mesh, with its regions */
+	Mat A;         /**< @brief the p matrix, with the sparsity of the mesh */
+};
+
+/** @brief runs one daemon job in a child process, like df2d -d dir would.
+
+	The mesh is taken from the cache of the daemon, only the regions, the fixed
+	data, the options and the initial condition are read.
+ */
+static void daemon_job(MData &md, MeshCache &mc){
+	FuncBegin();
+
+	md.A = mc.A;
+	driver::readoptions(md);
+	ensemble_regions(md, *mc.msh, md.dir);
+	driver::readinitial(md, *mc.msh);
+	driver::solve(md, *mc.msh);
+	cout << "Simulation finished successfully in " << md.cT << " seconds." << endl
+		 << "Time steps: " << md.nStep << " pressure solves: " << md.nPSolve << endl;
+	cout.flush();
+
+	FuncEnd();
+}
+
+/** @brief reads the job file name.job of the daemon, which has the case directory */
+static string daemon_case(MData &md, const string &name){
+	FuncBegin();
+
+	std::ifstream fl( (md.dmnDir + name + ".run").c_str() );
+	string dir;
+	std::getline(fl, dir);
+	if (dir.empty()){
+		Error::mess << "job " << name << " has no case directory";
+		ERRSET();
+	}
+	if (dir[dir.size() - 1] != '/') dir += '/';
+	return dir;
+
+	FuncEnd();
+}
+
+/************************************************************************
+ * checkpoint and state cache stuff
+ ************************************************************************/
+
+static const char statemagic[] = "df2dstate4"; /**< @brief first bytes of a state file */
+static const string adrckpt = "restart/checkpoint";
+
+/** @brief adds x to the hash h */
+template<class T>
+static void hash_add(uint64_t &h, const T &x){
+	h = fnv_hash(&x, sizeof(x), h);
+}
+
+/** @brief adds a string to the hash h */
+static void hash_add(uint64_t &h, const string &x){
+	h = fnv_hash(x.data(), x.size(), h);
+}
+
+/** @brief adds the parameters of a J or kr model to the hash h, as they are */
+static void hash_params(uint64_t &h, const vector<double> &p){
+	for (size_t i = 0 ; i < p.size() ; i++) hash_add(h, p[i]);
+}
+
+/** @brief hash of the nodes and elements, continuing from h.
+
+	The nodes are taken in the order of the mesh file and the elements are
+	summed up, so the idx and the element order found for threads or processes
+	do not matter.
+ */
+static uint64_t geom_hash(Mesh &msh, uint64_t h){
+	FuncBegin();
+
+	const Node *n0 = &(*msh.begnode());
+	uint64_t he = 0, h1;
+
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++){
+		hash_add(h, i->x); hash_add(h, i->y);
+	}
+	for (list<eleblank*>::iterator i = msh.begele() ; i != msh.endele() ; i++){
+		h1 = fnv_hash(NULL, 0);
+		for (int j = 0 ; j < (*i)->nNode() ; j++){
+			hash_add(h1, (*i)->dupl(j)->reg->ID);
+			hash_add(h1, (int)( &msh.node( (*i)->idxGlob()(j) ) - n0 ));
+		}
+		he += h1;
+	}
+	hash_add(h, he);
+	return h;
+
+	FuncEnd();
+}
+
+/** @brief adds the PETSc options to the hash h, i.e. petsc.config and the command line.
+
+	The options of df2d, -d and -s are left out, the ones that decide the
+	states are added from md by input_hash, and so are the ones that only
+	print, e.g. -ksp_monitor or -log_view.
+ */
+static void hash_options(uint64_t &h){
+	FuncBegin();
+
+	char *all;
+	string tok;
+	bool skip = false;
+
+	Error::code=PetscOptionsGetAll(&all);ERRCHK();
+	stringstream ss(all);
+	Error::code=PetscFree(all);ERRCHK();
+	while (ss >> tok){
+		//an option is a dash and a letter, a value such as -1e-3 is not
+		if ( (tok.size() > 1) && (tok[0] == '-') && isalpha((unsigned char)tok[1]) )
+			skip = ( (tok == swidir) || (tok == swisetf) || (tok.compare(0, 6, "-df2d_") == 0) ||
+					 (tok.find("monitor") != string::npos) || (tok.find("view") != string::npos) ||
+					 (tok.compare(0, 4, "-log") == 0) || (tok == "-info") || (tok == "-help") ||
+					 (tok == "-options_left") );
+		if (!skip) hash_add(h, tok);
+	}
+
+	FuncEnd();
+}
+
+/** @brief hash of everything that decides the states of a run, except when it stops.
+
+	The build, the fixed data without stoptime and the file numbers, the
+	options of the time marching and of the p solver, the PETSc options, the
+	number of threads and processes, the regions, the nodes and elements and
+	the initial saturation. kr and J only take part through their names.
+ */
+static uint64_t input_hash(MData &md, Mesh &msh){
+	FuncBegin();
+
+	uint64_t h = fnv_hash(statemagic, sizeof(statemagic));
+
+	//build, solvers and PETSc options
+	hash_add(h, string(__DATE__ " " __TIME__ " " __VERSION__));
+	hash_add(h, PETSC_VERSION_MAJOR); hash_add(h, PETSC_VERSION_MINOR); hash_add(h, PETSC_VERSION_SUBMINOR);
+	hash_add(h, md.pdirect); hash_add(h, md.pdirectLag); hash_add(h, md.pdirectPackage);
+	hash_add(h, md.pshell); hash_add(h, md.nthread); hash_add(h, md.nrank);
+	hash_options(h);
+
+	//fixed data and options
+	hash_add(h, md.dm); hash_add(h, md.dn); hash_add(h, md.dp);
+	hash_add(h, md.grav.gw); hash_add(h, md.grav.gn); hash_add(h, md.grav.x0);
+	hash_add(h, md.grav.y0); hash_add(h, md.grav.xdir); hash_add(h, md.grav.ydir);
+	hash_add(h, md.t); hash_add(h, md.dt); hash_add(h, md.dtM); hash_add(h, md.dtm);
+	hash_add(h, md.dsM); hash_add(h, md.dsm); hash_add(h, md.beta); hash_add(h, md.dnItM);
+	hash_add(h, md.J->name()); hash_params(h, md.J->params());
+	hash_add(h, md.sscheme); hash_add(h, md.dtCtrl); hash_add(h, md.dtSafe);
+	hash_add(h, md.ltsMax); hash_add(h, md.pUpdateTol); hash_add(h, md.rkTol);
+	hash_add(h, md.sImpIt); hash_add(h, md.sImpDsM);
+	hash_add(h, md.steadyTol); hash_add(h, md.steadyWin); hash_add(h, md.steadyPtc);
+	hash_add(h, md.steadyPtcTol); hash_add(h, md.steadyPtcMax);
+	//regions
+	for (list<Region*>::iterator i = msh.begreg() ; i != msh.endreg() ; i++){
+		RegionPorous *preg = dynamic_cast<RegionPorous*>(*i);
+		RegionPorousMat *mreg = dynamic_cast<RegionPorousMat*>(*i);
+		RegionPorousFrac *freg = dynamic_cast<RegionPorousFrac*>(*i);
+		RegionBoundary *breg = dynamic_cast<RegionBoundary*>(*i);
+		hash_add(h, (*i)->ID);
+		if (preg){
+			hash_add(h, preg->phi); hash_add(h, preg->pd); hash_add(h, preg->kr->name());
+			hash_params(h, preg->kr->params());
+		}
+		if (mreg)
+			for (int k = 0 ; k < 4 ; k++) hash_add(h, (double)mreg->k(k % 2, k / 2));
+		if (freg){
+			hash_add(h, freg->k); hash_add(h, freg->e);
+		}
+		if (breg){
+			hash_add(h, breg->stype); hash_add(h, breg->ptype); hash_add(h, breg->val[0]);
+		}
+	}
+	//mesh and initial condition
+	h = geom_hash(msh, h);
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++)
+		hash_add(h, md.S.at(i->dd.front().idx));
+	return h;
+
+	FuncEnd();
+}
+
+/** @brief the scalars of the state of a run, the same list for writing and reading */
+static void state_fields(MData &md, vector<double*> &d, vector<int*> &n){
+	double *dd[] = {&md.t, &md.dt, &md.dtE, &md.dtEOld, &md.dtNext, &md.qIn, &md.qOut,
+					&md.qWin, &md.qWout, &md.Vw0, &md.stRate, &md.stRateOld, &md.rkErr, &md.cT};
+	int *nn[] = {&md.nIt, &md.nPSolve, &md.nPFactor, &md.nStep, &md.ltsM, &md.ltsNFast,
+				 &md.nSNESIt, &md.nDtRej, &md.nDtLim, &md.steadyStep, &md.nFile};
+	d.assign(dd, dd + sizeof(dd) / sizeof(dd[0]));
+	n.assign(nn, nn + sizeof(nn) / sizeof(nn[0]));
+}
+
+/** @brief the settings steady_check changes, but md.sscheme, the same list for
+	writing and reading. They are only restored once the steady state was found,
+	otherwise the ones of solver.config and the options are kept, e.g. a larger
+	stoptime.
+*/
+static void state_steady(MData &md, vector<double*> &d, vector<int*> &n){
+	double *dd[] = {&md.tEnd, &md.dtM, &md.sImpDsM, &md.steadyT, &md.steadyDsM, &md.steadyDtM,
+					&md.steadyQ[0], &md.steadyQ[1], &md.steadyQ[2], &md.steadyQ[3]};
+	int *nn[] = {&md.ltsMax, &md.steadyLts, &md.steadyScheme};
+	d.assign(dd, dd + sizeof(dd) / sizeof(dd[0]));
+	n.assign(nn, nn + sizeof(nn) / sizeof(nn[0]));
+}
+
+/** @brief writes the complete state of a run on one process to adr.
+
+	The scalars of state_fields, the steady state, its window and the
+	settings of state_steady, then S and LtP of all the DuplData and P, in
+	the order of the mesh file and in full precision. The file is written
+	under another name and renamed, so a run that is killed never leaves
+	half of one.
+	@param hash what the state belongs to, checked by state_peek
+ */
+static void state_write(MData &md, Mesh &msh, const string &adr, const uint64_t hash){
+	FuncBegin();
+
+	std::ofstream fl( (adr + ".tmp").c_str(), std::ios::binary );
+	vector<double*> d, sd;
+	vector<int*> n, sn;
+	const int nn = msh.nnode(), nd = msh.ndd(), st = md.steadyState,
+		lt = ( md.LtP.size() == md.Lw.size() ), nw = md.stRates.size(), ss = md.sscheme;
+
+	state_fields(md, d, n);
+	state_steady(md, sd, sn);
+	fl.write(statemagic, sizeof(statemagic));
+	fl.write((const char*)&hash, sizeof(hash));
+	fl.write((const char*)&nn, sizeof(nn));
+	fl.write((const char*)&nd, sizeof(nd));
+	for (int i = 0 ; i < (int)d.size() ; i++) fl.write((const char*)d[i], sizeof(double));
+	for (int i = 0 ; i < (int)n.size() ; i++) fl.write((const char*)n[i], sizeof(int));
+	fl.write((const char*)&st, sizeof(st));
+	fl.write((const char*)&lt, sizeof(lt));
+	fl.write((const char*)&nw, sizeof(nw));
+	for (int i = 0 ; i < nw ; i++){
+		fl.write((const char*)&md.stRates[i], sizeof(double));
+		fl.write((const char*)&md.stQWin.at(i), sizeof(double));
+		fl.write((const char*)&md.stQWout.at(i), sizeof(double));
+	}
+	for (int i = 0 ; i < (int)sd.size() ; i++) fl.write((const char*)sd[i], sizeof(double));
+	for (int i = 0 ; i < (int)sn.size() ; i++) fl.write((const char*)sn[i], sizeof(int));
+	fl.write((const char*)&ss, sizeof(ss));
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++){
+		fl.write((const char*)&md.P[i->idx], sizeof(double));
+		for (list<DuplData>::iterator j = i->dd.begin() ; j != i->dd.end() ; j++){
+			fl.write((const char*)&md.S.at(j->idx), sizeof(double));
+			if (lt) fl.write((const char*)&md.LtP.at(j->idx), sizeof(double));
+		}
+	}
+	fl.close();
+	if ( !fl || ( rename( (adr + ".tmp").c_str(), adr.c_str() ) != 0 ) ){
+		Error::mess << adr << " could not be written.";
+		ERRSET();
+	}
+
+	FuncEnd();
+}
+
+/** @brief finds the time of the state in adr.
+	@returns false if adr is not a state of hash on a mesh of this size.
+ */
+static bool state_peek(Mesh &msh, const string &adr, const uint64_t hash, double &t){
+	FuncBegin();
+
+	std::ifstream fl(adr.c_str(), std::ios::binary);
+	char magic[sizeof(statemagic)];
+	uint64_t h;
+	int nn, nd;
+
+	fl.read(magic, sizeof(magic));
+	fl.read((char*)&h, sizeof(h));
+	fl.read((char*)&nn, sizeof(nn));
+	fl.read((char*)&nd, sizeof(nd));
+	fl.read((char*)&t, sizeof(t));
+	return fl && (memcmp(magic, statemagic, sizeof(magic)) == 0) && (h == hash) &&
+		(nn == msh.nnode()) && (nd == msh.ndd());
+
+	FuncEnd();
+}
+
+/** @brief sets the run to the state in adr, which state_peek accepted.
+
+	The node data are found from S as at the start of a run, the upwind nodes
+	from the saved P, so the run goes on exactly as it would have. The steady
+	state window must be as long as the one of this run.
+ */
+static void state_read(MData &md, Mesh &msh, const string &adr){
+	FuncBegin();
+
+	std::ifstream fl(adr.c_str(), std::ios::binary);
+	vector<double*> d, sd;
+	vector<int*> n, sn;
+	vector<double> dv, p(msh.nnode()), ltp(msh.ndd()), win, sdv;
+	vector<int> nv, idx(msh.nnode()), snv;
+	int st, lt, nw, ss;
+
+	state_fields(md, d, n);
+	state_steady(md, sd, sn);
+	dv.resize(d.size());
+	nv.resize(n.size());
+	sdv.resize(sd.size());
+	snv.resize(sn.size());
+	fl.seekg(sizeof(statemagic) + sizeof(uint64_t) + 2 * sizeof(int));
+	fl.read((char*)&dv[0], sizeof(double) * dv.size());
+	fl.read((char*)&nv[0], sizeof(int) * nv.size());
+	fl.read((char*)&st, sizeof(st));
+	fl.read((char*)&lt, sizeof(lt));
+	fl.read((char*)&nw, sizeof(nw));
+	if ( fl && (nw != (int)md.stRates.size()) ){
+		Error::mess << adr << " was written with a steady state window of " << nw - 1
+					<< " steps, this run has " << md.steadyWin;
+		ERRSET();
+	}
+	win.resize(3 * md.stRates.size());
+	if (!win.empty()) fl.read((char*)&win[0], sizeof(double) * win.size());
+	fl.read((char*)&sdv[0], sizeof(double) * sdv.size());
+	fl.read((char*)&snv[0], sizeof(int) * snv.size());
+	fl.read((char*)&ss, sizeof(ss));
+	for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++){
+		idx.at(i - msh.begnode()) = i->idx;
+		fl.read((char*)&p.at(i - msh.begnode()), sizeof(double));
+		for (list<DuplData>::iterator j = i->dd.begin() ; j != i->dd.end() ; j++){
+			fl.read((char*)&md.S.at(j->idx), sizeof(double));
+			if (lt) fl.read((char*)&ltp.at(j->idx), sizeof(double));
+		}
+	}
+	if (!fl){
+		Error::mess << adr << " could not be read.";
+		ERRSET();
+	}
+
+	//node data from S, then P and the wetting upwind nodes of the last p solve
+	driver::initdata(md, msh);
+	Error::code=VecSetValues(md.Pvec, msh.nnode(), &idx[0], &p[0], INSERT_VALUES);ERRCHK();
+	Error::code=VecAssemblyBegin(md.Pvec);ERRCHK();
+	Error::code=VecAssemblyEnd(md.Pvec);ERRCHK();
+	for (list<eleblank*>::iterator i = msh.begele() ; i != msh.endele() ; i++)
+		(*i)->fndUpW(md.P);
+	for (int i = 0 ; i < (int)d.size() ; i++) *d[i] = dv[i];
+	for (int i = 0 ; i < (int)n.size() ; i++) *n[i] = nv[i];
+	md.steadyState = (MData::SteadyState)st;
+	for (int i = 0 ; i < nw ; i++){
+		md.stRates[i] = win[3*i];
+		md.stQWin[i] = win[3*i+1];
+		md.stQWout[i] = win[3*i+2];
+	}
+	if (md.steadyState != MData::SteadyNo){
+		for (int i = 0 ; i < (int)sd.size() ; i++) *sd[i] = sdv[i];
+		for (int i = 0 ; i < (int)sn.size() ; i++) *sn[i] = snv[i];
+		md.sscheme = (MData::SScheme)ss;
+	}
+	if (md.pdirect) md.nPFactor = 0;   //the factor is not kept, the next p solve finds it
+	if (lt) md.LtP.swap(ltp);
+	else md.LtP.clear();
+
+	FuncEnd();
+}
+
+/** @brief name of the cache file of output n, without the directory */
+static string cache_name(MData &md, const int n){
+	std::ostringstream ss;
+	ss << "cache." << std::hex << std::setw(16) << std::setfill('0') << md.inHash
+	   << std::dec << "." << n;
+	return ss.str();
+}
+
+/** @brief keeps the state of the run after output md.nFile-1, for the inputs md.inHash.
+	Only the latest state of the inputs is kept, the older ones are removed.
+*/
+static void cache_write(MData &md, Mesh &msh){
+	FuncBegin();
+
+	const string dir = md.dir + "restart/", last = cache_name(md, md.nFile - 1);
+	const string pre = last.substr(0, 23);
+	DIR *dp;
+	struct dirent *de;
+	string name;
+
+	state_write(md, msh, dir + last, md.inHash);
+	if ( !(dp = opendir(dir.c_str())) ) return;
+	while ( (de = readdir(dp)) ){
+		name = de->d_name;
+		if ( (name.compare(0, pre.size(), pre) == 0) && (name != last) ) unlink((dir + name).c_str());
+	}
+	closedir(dp);
+
+	FuncEnd();
+}
+
+/** @brief drops the lines of a result table from the first one whose first column is at least n.
+	The header and the empty lines before it are kept.
+ */
+static void table_truncate(const string &adr, const double n){
+	FuncBegin();
+
+	std::ifstream fl(adr.c_str());
+	string line;
+	std::streamoff off = 0;
+	double v;
+
+	if (!fl.is_open()) return;
+	while (std::getline(fl, line)){
+		std::istringstream ss(line);
+		if ( (ss >> v) && (v >= n) ){
+			fl.close();
+			if (truncate(adr.c_str(), off) != 0){
+				Error::mess << adr << " could not be truncated.";
+				ERRSET();
+			}
+			return;
+		}
+		off += line.size() + 1;
+	}
+
+	FuncEnd();
+}
+
+/** @brief drops the lines a resumed run writes again from result.flow and result.dt.
+
+	result.flow has a line for every output from md.nFile on, result.dt one for
+	every step after md.nStep.
+ */
+static void result_truncate(MData &md){
+	FuncBegin();
+
+	if (md.rank != 0) return;
+	table_truncate(md.dir + adrresult + ".flow", md.nFile);
+	md.dtF.flush();
+	table_truncate(md.dir + adrresult + ".dt", md.nStep + 1);
+
+	FuncEnd();
+}
+
+/** @brief continues the run from the latest cached state of the same inputs.
+
+	Only states up to tEnd are used. The result files are appended to, after
+	the lines written after the state was saved are dropped.
+	@returns true if a state was found.
+ */
+static bool cache_resume(MData &md, Mesh &msh){
+	FuncBegin();
+
+	const string dir = md.dir + "restart/";
+	const string pre = cache_name(md, 0).substr(0, 23);
+	DIR *dp = opendir(dir.c_str());
+	struct dirent *de;
+	string name, best;
+	double tbest = -HUGE_VAL, t;
+
+	if (!dp) return false;
+	while ( (de = readdir(dp)) ){
+		name = de->d_name;
+		if ( (name.compare(0, pre.size(), pre) != 0) ||
+			 (name.find(".tmp") != string::npos) ) continue;
+		if ( state_peek(msh, dir + name, md.inHash, t) && (t <= md.tEnd) && (t > tbest) ){
+			tbest = t;
+			best = name;
+		}
+	}
+	closedir(dp);
+	if (best.empty()) return false;
+
+	state_read(md, msh, dir + best);
+	result_truncate(md);
+	cout << "Resumed from " << dir + best << " at t: " << md.t
+		 << " step: " << md.nStep << endl;
+	return true;
+
+	FuncEnd();
+}
+
+/** @brief writes restart/checkpoint if -df2d_checkpoint or -df2d_checkpoint_wall asks for it */
+static void checkpoint_write(MData &md, Mesh &msh){
+	FuncBegin();
+
+	PetscLogDouble w;
+
+	PetscTime(&w);
+	if (md.ckptW0 == 0) md.ckptW0 = w;
+	if ( ( (md.ckptSteps > 0) && (md.nStep % md.ckptSteps == 0) ) ||
+		 ( (md.ckptWall > 0) && (w - md.ckptW0 >= md.ckptWall) ) ){
+		state_write(md, msh, md.dir + adrckpt, geom_hash(msh, fnv_hash(NULL, 0)));
+		md.ckptW0 = w;
+	}
+
+	FuncEnd();
+}
+
+/** @brief continues the run from restart/checkpoint, which must be of the same mesh */
+static void checkpoint_resume(MData &md, Mesh &msh){
+	FuncBegin();
+
+	const string adr = md.dir + adrckpt;
+	double t;
+
+	if ( !state_peek(msh, adr, geom_hash(msh, fnv_hash(NULL, 0)), t) ){
+		Error::mess << adr << " is missing, or was not written for this mesh.";
+		ERRSET();
+	}
+	state_read(md, msh, adr);
+	result_truncate(md);
+	cout << "Resumed from " << adr << " at t: " << md.t
+		 << " step: " << md.nStep << endl;
+
+	FuncEnd();
+}
+
+/************************************************************************
+ * mesh image stuff
+ ************************************************************************/
+
+static const string adrimg = "mesh.img";
+static const char imgmagic[8] = "df2dimg"; /**< @brief first bytes of a mesh image */
+static const int imgversion = 2;           /**< @brief changes when the layout of the image changes */
+static const int imgnfile = 3;             /**< @brief max number of mesh files */
+
+/** @brief header of a mesh image.
+
+	It is followed by the doubles: x and y of the nodes, MeshGeo::ele and
+	MeshGeo::bvx; then by the ints: the elements as in MeshRecord::ele,
+	MeshGeo::ndd, dreg and bnb and, if nnz is not zero, MeshGeo::ia and ja.
+	Everything is in the order of the mesh files and in the byte order of the
+	machine that wrote it.
+ */
+struct MeshImageHead{
+	char magic[8];     /**< @brief imgmagic */
+	int version;       /**< @brief imgversion */
+	int eleSize;       /**< @brief MeshRecord::eleSize */
+	uint64_t src;      /**< @brief hash of the mesh files the image was made from */
+	uint64_t geo;      /**< @brief geo_hash of the case the image was made for */
+	int64_t fsize[imgnfile];  /**< @brief size of each mesh file, when src was found */
+	int64_t fmtime[imgnfile]; /**< @brief modification time of each mesh file in ns, when src was found */
+	int nnode;         /**< @brief number of nodes */
+	int nele;          /**< @brief number of elements, including the boundary ones */
+	int meshtype;      /**< @brief MData::meshtype of the mesh files */
+	int ngeo;          /**< @brief size of MeshGeo::ele */
+	int nbv;           /**< @brief number of bvertices */
+	int ndd;           /**< @brief size of MeshGeo::dreg */
+	int nnz;           /**< @brief size of MeshGeo::ja, 0 if the sparsity is not stored */
+};
+
+/** @brief size in bytes of an image with the header h */
+static size_t image_size(const MeshImageHead &h){
+	return sizeof(h) + sizeof(double) * ( 2 * (size_t)h.nnode + h.ngeo + (size_t)BVertexCQ::nGeo * h.nbv ) +
+		sizeof(int) * ( (size_t)h.eleSize * h.nele + h.nnode + h.ndd + 2 * (size_t)h.nbv +
+						( h.nnz ? h.nnode + 1 + (size_t)h.nnz : 0 ) );
+}
+
+/** @brief size and modification time of the mesh files, -1 for a missing one */
+static void mesh_file_stats(MData &md, int64_t size[], int64_t mtime[]){
+	const vector<string> f = mesh_files(md);
+	struct stat st;
+	for (int i = 0 ; i < imgnfile ; i++){
+		size[i] = mtime[i] = -1;
+		if ( (i < (int)f.size()) && (stat(f[i].c_str(), &st) == 0) ){
+			size[i] = st.st_size;
+			mtime[i] = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+		}
+	}
+}
+
+/** @brief true if the mesh image h is of the current mesh files.
+
+	The files are only hashed again when their size or time is not the one
+	stored. If the hash still matches, the new size and time are stored in the
+	image, so the next runs do not hash them.
+ */
+static bool mesh_image_src(MData &md, const string &adr, const MeshImageHead &h){
+	FuncBegin();
+
+	int64_t size[imgnfile], mtime[imgnfile];
+
+	mesh_file_stats(md, size, mtime);
+	if ( std::equal(size, size + imgnfile, h.fsize) && std::equal(mtime, mtime + imgnfile, h.fmtime) )
+		return true;
+	if (h.src != meshfile_hash(md, 0)) return false;
+	const int fd = open(adr.c_str(), O_WRONLY);
+	if (fd >= 0){
+		if ( (pwrite(fd, size, sizeof(size), offsetof(MeshImageHead, fsize)) != (ssize_t)sizeof(size)) ||
+			 (pwrite(fd, mtime, sizeof(mtime), offsetof(MeshImageHead, fmtime)) != (ssize_t)sizeof(mtime)) )
+			cout << adr << ": the times of the mesh files could not be stored." << endl;
+		close(fd);
+	}
+	return true;
+
+	FuncEnd();
+}
+
+/** @brief adds the nodes and elements of the mesh image to msh, and reads geo.
+
+	The image is mapped into memory and the nodes and elements are added
+	straight from it, so nothing is parsed. geo is copied out of it, for
+	constructGeoParams to set the mesh from.
+	@param gh geo_hash of the case
+	@returns false if there is no image, or it was made from other mesh files,
+	for another case or by another version, in which case nothing is added.
+ */
+static bool mesh_image_read(MData &md, Mesh &msh, MeshGeo &geo, const uint64_t gh){
+	FuncBegin();
+
+	const string adr = md.dir + adrimg;
+	const int fd = open(adr.c_str(), O_RDONLY);
+	struct stat st;
+	void *p;
+	const MeshImageHead *h;
+
+	if (fd < 0) return false;
+	if ( (fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(MeshImageHead)) ){
+		close(fd);
+		return false;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) return false;
+	h = (const MeshImageHead*)p;
+	if ( (memcmp(h->magic, imgmagic, sizeof(imgmagic)) != 0) || (h->version != imgversion) ||
+		 (h->eleSize != MeshRecord::eleSize) || (h->meshtype != md.meshtype) ||
+		 (image_size(*h) != (size_t)st.st_size) || (h->geo != gh) ||
+		 !mesh_image_src(md, adr, *h) ){
+		munmap(p, st.st_size);
+		cout << adr << " is not of the current mesh files or case, reading them." << endl;
+		return false;
+	}
+	madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+	const double *xy = (const double*)(h + 1);
+	const double *ele = xy + 2 * h->nnode;
+	const double *bvx = ele + h->ngeo;
+	const int *cell = (const int*)(bvx + BVertexCQ::nGeo * h->nbv);
+	const int *ndd = cell + (size_t)h->eleSize * h->nele;
+	const int *dreg = ndd + h->nnode;
+	const int *bnb = dreg + h->ndd;
+	const int *ia = bnb + 2 * h->nbv;
+	const int *ja = ia + h->nnode + 1;
+	msh.reserveNodes(h->nnode);
+	for (int i = 0 ; i < h->nnode ; i++) msh.addNode(xy[2*i], xy[2*i+1], i);
+	for (int i = 0 ; i < h->nele ; i++, cell += h->eleSize)
+		msh.addElement(cell[0], cell + 2, (CellType)cell[1]);
+	geo.ele.assign(ele, ele + h->ngeo);
+	geo.bvx.assign(bvx, bvx + BVertexCQ::nGeo * h->nbv);
+	geo.ndd.assign(ndd, ndd + h->nnode);
+	geo.dreg.assign(dreg, dreg + h->ndd);
+	geo.bnb.assign(bnb, bnb + 2 * h->nbv);
+	geo.ia.clear();
+	geo.ja.clear();
+	if (h->nnz){
+		geo.ia.assign(ia, ia + h->nnode + 1);
+		geo.ja.assign(ja, ja + h->nnz);
+	}
+	munmap(p, st.st_size);
+	return true;
+
+	FuncEnd();
+}
+
+/** @brief writes the mesh image of the mesh files read into rec, and of geo.
+
+	It is only written on one process, where constructGeoParams fills all of
+	geo. gh is the geo_hash of the case, found before the regions were sorted.
+	The image is written under another name and renamed, so other runs never
+	map half of one.
+ */
+static void mesh_image_write(MData &md, const MeshRecord &rec, const MeshGeo &geo, const uint64_t gh){
+	FuncBegin();
+
+	const string adr = md.dir + adrimg;
+	MeshImageHead h;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, imgmagic, sizeof(imgmagic));
+	h.version = imgversion;
+	h.eleSize = MeshRecord::eleSize;
+	mesh_file_stats(md, h.fsize, h.fmtime);
+	h.src = meshfile_hash(md, 0);
+	h.geo = gh;
+	h.nnode = rec.xy.size() / 2;
+	h.nele = rec.ele.size() / MeshRecord::eleSize;
+	h.meshtype = md.meshtype;
+	h.ngeo = geo.ele.size();
+	h.nbv = geo.bnb.size() / 2;
+	h.ndd = geo.dreg.size();
+	h.nnz = geo.ja.size();
+
+	std::ofstream fl( (adr + ".tmp").c_str(), std::ios::binary );
+	fl.write((const char*)&h, sizeof(h));
+	fl.write((const char*)&rec.xy[0], sizeof(double) * rec.xy.size());
+	fl.write((const char*)geo.ele.data(), sizeof(double) * geo.ele.size());
+	fl.write((const char*)geo.bvx.data(), sizeof(double) * geo.bvx.size());
+	fl.write((const char*)&rec.ele[0], sizeof(int) * rec.ele.size());
+	fl.write((const char*)geo.ndd.data(), sizeof(int) * geo.ndd.size());
+	fl.write((const char*)geo.dreg.data(), sizeof(int) * geo.dreg.size());
+	fl.write((const char*)geo.bnb.data(), sizeof(int) * geo.bnb.size());
+	if (h.nnz){
+		fl.write((const char*)geo.ia.data(), sizeof(int) * geo.ia.size());
+		fl.write((const char*)geo.ja.data(), sizeof(int) * geo.ja.size());
+	}
+	fl.close();
+	if ( !fl || ( rename( (adr + ".tmp").c_str(), adr.c_str() ) != 0 ) ){
+		Error::mess << adr << " could not be written.";
+		ERRSET();
+	}
+	cout << "Mesh image " << adr << " was written." << endl;
+
+	FuncEnd();
+}
+
+/************************************************************************
+ * asynchronous output stuff
+ ************************************************************************/
+
+/** @brief writes the output of one time: a line of result.flow, a restart
+	file and a visual file, as md.outFields selects.
+
+	Only S, P, Pc, Lw, Ln and a few scalars of md are used, and the mesh is
+	only read, so it can run on the output thread with a copy of them.
+	@param vw wetting phase volume
+*/
+static void write_output(MData &md, Mesh &msh, const double vw){
+	FuncBegin();
+
+	fstream fl;
+	stringstream ss;
+	fl << left;
+
+	//open result.flow file
+	if (md.outFields & MData::OutFlow){
+		ss << md.dir+adrresult << ".flow";
+		fl.open(ss.str().c_str(),fstream::app | fstream::out);
+		if (!fl.is_open()){
+			Error::mess << ss.str() << " could not be openned.";
+			ERRSET();
+		}
+
+		//write header
+		if(fl.tellp() == 0)
+			fl << setw(5) << "# n"
+			   << setw(15) << "t"
+			   << setw(15) << "Q_in"
+			   << setw(15) << "Q_out"
+			   << setw(15) << "Q_w_in"
+			   << setw(15) << "Q_w_out"
+			   << setw(15) << "V_w" << endl ;
+		if (md.nFile == 0) fl << endl;
+
+		//write data
+		fl << setw(5) << md.nFile
+		   << setw(15) << md.t
+		   << setw(15) << md.qIn
+		   << setw(15) << md.qOut
+		   << setw(15) << md.qWin
+		   << setw(15) << md.qWout
+		   << setw(15) << vw << endl;
+
+		//close the file
+		fl.close();
+	}
+
+	//write restart file, a series keeps it in its frames
+	ss.str("");
+	ss << md.dir+adrrestart << "." << md.nFile;
+	if ( !md.series && (md.outFields & MData::OutRestart) ) driver::writeinitial(md, msh, ss.str(), true, false);
+	//write visual file
+	ss.str("");
+	ss << md.dir+adrresult << "." << md.nFile;
+	driver::writevisual(ss.str().c_str(), md, msh);
+
+	FuncEnd();
+}
+
+/** @brief the fields of one output time, copied from the run */
+struct Snapshot{
+	MData md;               /**< @brief S, Pc, Lw, Ln if md.outFields needs them, the scalars write_output uses and P pointing to p */
+	std::vector<double> p;  /**< @brief pressure by idx */
+	double vw;              /**< @brief wetting phase volume */
+	Snapshot():vw(0){ md.initialize(); }
+	/** @brief P must not be restored as a PETSc array, it is p */
+	~Snapshot(){ md.P = NULL; }
+};
+
+/** @ingroup dr_module
+ * @brief writes the output files on a thread of its own.
+ *
+ * The run copies its fields into a free snapshot and goes on, the thread
+ * computes the velocities, formats and writes the files. There are n
+ * snapshots, so acquire() waits while n outputs are still being written.
+ * The snapshots are written in the order they are pushed. The thread is an
+ * Error::worker, so its errors do not touch the Error of the main thread:
+ * the first one is kept in the queue and raised on the main thread, by the
+ * next acquire() or flush().
+ */
+class OutputQueue{
+	Mesh &msh_;                           /**< @brief the mesh, only read */
+	std::vector<Snapshot> buf_;           /**< @brief the snapshots */
+	std::deque<Snapshot*> todo_;          /**< @brief snapshots waiting to be written, oldest first */
+	std::vector<Snapshot*> free_;         /**< @brief snapshots that can be filled */
+	std::mutex mx_;                       /**< @brief guards the fields below */
+	std::condition_variable cv_;          /**< @brief a snapshot was pushed or written, or the end */
+	bool failed_;                         /**< @brief an output threw */
+	std::string error_;                   /**< @brief where and why the first output failed */
+	bool stop_;                           /**< @brief the queue is being destroyed */
+	std::thread th_;                      /**< @brief the output thread */
+
+	/** @brief loop of the output thread, writes what is left before stopping */
+	void work(){
+		Error::worker = true;
+		std::unique_lock<std::mutex> lk(mx_);
+		for (;;){
+			cv_.wait(lk, [&]{ return stop_ || !todo_.empty(); });
+			if (todo_.empty()) return;
+			Snapshot *s = todo_.front();
+			todo_.pop_front();
+			lk.unlock();
+			bool ok = true;
+			try{ write_output(s->md, msh_, s->vw); }
+			catch(...){ ok = false; }
+			lk.lock();
+			if ( !ok && !failed_ ){
+				failed_ = true;
+				error_ = Error::trace;
+			}
+			Error::trace.clear();
+			free_.push_back(s);
+			cv_.notify_all();
+		}
+	}
+	/** @brief raises the error of the thread, if there was one. mx_ is locked */
+	void check(){
+		FuncBegin();
+		if (failed_){
+			failed_ = false;
+			Error::mess << "the output thread failed to write an output";
+			if (!error_.empty()) Error::mess << ": " << error_;
+			error_.clear();
+			ERRSET();
+		}
+		FuncEnd();
+	}
+public:
+	/** @brief starts the output thread with n snapshots */
+	OutputQueue(Mesh &msh, const int n):msh_(msh), buf_(n), failed_(false), stop_(false){
+		for (int i = 0 ; i < n ; i++) free_.push_back(&buf_[i]);
+		th_ = std::thread(&OutputQueue::work, this);
+	}
+	/** @brief writes what is in the queue and stops the thread */
+	~OutputQueue(){
+		{
+			std::lock_guard<std::mutex> lk(mx_);
+			stop_ = true;
+		}
+		cv_.notify_all();
+		th_.join();
+	}
+	/** @brief a snapshot to fill, waits until one is free */
+	Snapshot* acquire(){
+		FuncBegin();
+		std::unique_lock<std::mutex> lk(mx_);
+		cv_.wait(lk, [&]{ return !free_.empty(); });
+		check();
+		Snapshot *s = free_.back();
+		free_.pop_back();
+		return s;
+		FuncEnd();
+	}
+	/** @brief queues a filled snapshot to be written */
+	void push(Snapshot *s){
+		{
+			std::lock_guard<std::mutex> lk(mx_);
+			todo_.push_back(s);
+		}
+		cv_.notify_all();
+	}
+	/** @brief waits until everything pushed is written */
+	void flush(){
+		FuncBegin();
+		std::unique_lock<std::mutex> lk(mx_);
+		cv_.wait(lk, [&]{ return free_.size() == buf_.size(); });
+		check();
+		FuncEnd();
 	}
-	FuncEnd();
-}
-
-
+};
 
 /***************************************************************************
  * driver namespace
@@ -542,7 +3915,6 @@ namespace driver{
 	void initialize(int *argc,char **argv[], MData &md){
 		FuncBegin();
 		int i;
-		PetscBool setf;
 		string adrfullpetsc;
 		
 		//initialize md
@@ -565,13 +3937,275 @@ namespace driver{
 		//initialize petsc and read running mode
 		adrfullpetsc = md.dir + adrpetsc;
 		Error::code=PetscInitialize(argc,argv,adrfullpetsc.c_str(),help);ERRCHK();
+		readoptions(md);
+
+		FuncEnd();
+	}
+
+	void readoptions(MData &md){
+		FuncBegin();
+		PetscBool setf;
+		PetscInt ival;
+		PetscReal rval;
+		char sval[PETSC_MAX_PATH_LEN];
+
 		Error::code=PetscOptionsHasName(NULL,swisetf,&setf);ERRCHK();
 		md.setfield = (setf == PETSC_TRUE ? 1 : 0);
+		//read pressure solver mode
+		Error::code=PetscOptionsHasName(NULL,swipdirect,&setf);ERRCHK();
+		md.pdirect = (setf == PETSC_TRUE ? 1 : 0);
+		Error::code=PetscOptionsGetInt(NULL,swipdirectlag,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.pdirectLag = (int)ival;
+		if (md.pdirectLag < 1){
+			Error::mess << swipdirectlag << " should be at least 1, found: " << md.pdirectLag;
+			ERRSET();
+		}
+		Error::code=PetscOptionsGetString(NULL,swipdirectpkg,sval,PETSC_MAX_PATH_LEN,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.pdirectPackage = sval;
+		Error::code=PetscOptionsGetReal(NULL,swipupdate,&rval,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.pUpdateTol = rval;
+		Error::code=PetscOptionsGetInt(NULL,swiltsmax,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.ltsMax = (int)ival;
+		if (md.ltsMax < 1){
+			Error::mess << swiltsmax << " should be at least 1, found: " << md.ltsMax;
+			ERRSET();
+		}
+		Error::code=PetscOptionsGetString(NULL,swidtctrl,sval,PETSC_MAX_PATH_LEN,&setf);ERRCHK();
+		if (setf == PETSC_TRUE){
+			if ( strcmp(sval, "pi") == 0 ) md.dtCtrl = MData::DtPI;
+			else if ( strcmp(sval, "retry") == 0 ) md.dtCtrl = MData::DtRetry;
+			else{
+				Error::mess << swidtctrl << " should be pi or retry, found: " << sval;
+				ERRSET();
+			}
+		}
+		Error::code=PetscOptionsGetReal(NULL,swidtsafe,&rval,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.dtSafe = rval;
+		if ( (md.dtSafe <= 0) || (md.dtSafe > 1) ){
+			Error::mess << swidtsafe << " should be in (0,1], found: " << md.dtSafe;
+			ERRSET();
+		}
+		Error::code=PetscOptionsGetString(NULL,swisscheme,sval,PETSC_MAX_PATH_LEN,&setf);ERRCHK();
+		if (setf == PETSC_TRUE){
+			if ( strcmp(sval, "euler") == 0 ) md.sscheme = MData::SEuler;
+			else if ( strcmp(sval, "implicit") == 0 ) md.sscheme = MData::SImplicit;
+			else if ( strcmp(sval, "ssprk2") == 0 ) md.sscheme = MData::SSSPRK2;
+			else if ( strcmp(sval, "ssprk3") == 0 ) md.sscheme = MData::SSSPRK3;
+			else{
+				Error::mess << swisscheme << " should be euler, implicit, ssprk2 or ssprk3, found: " << sval;
+				ERRSET();
+			}
+		}
+		Error::code=PetscOptionsGetReal(NULL,swisimpds,&rval,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.sImpDsM = rval;
+		Error::code=PetscOptionsGetReal(NULL,swirktol,&rval,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.rkTol = rval;
+		if (md.rkTol <= 0){
+			Error::mess << swirktol << " should be positive, found: " << md.rkTol;
+			ERRSET();
+		}
+		Error::code=PetscOptionsGetReal(NULL,swisteadytol,&rval,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.steadyTol = rval;
+		md.steadyPtcTol = md.steadyTol * 1e-3;
+		Error::code=PetscOptionsGetReal(NULL,swisteadyptc,&rval,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.steadyPtcTol = rval;
+		Error::code=PetscOptionsGetInt(NULL,swisteadyptcmax,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.steadyPtcMax = (int)ival;
+		if (md.steadyPtcMax < 1){
+			Error::mess << swisteadyptcmax << " should be at least 1, found: " << md.steadyPtcMax;
+			ERRSET();
+		}
+		Error::code=PetscOptionsGetInt(NULL,swisteadywin,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.steadyWin = (int)ival;
+		if (md.steadyWin < 1){
+			Error::mess << swisteadywin << " should be at least 1, found: " << md.steadyWin;
+			ERRSET();
+		}
+		Error::code=PetscOptionsGetString(NULL,swisteadyact,sval,PETSC_MAX_PATH_LEN,&setf);ERRCHK();
+		if (setf == PETSC_TRUE){
+			if ( strcmp(sval, "stop") == 0 ) md.steadyPtc = 0;
+			else if ( strcmp(sval, "ptc") == 0 ) md.steadyPtc = 1;
+			else{
+				Error::mess << swisteadyact << " should be stop or ptc, found: " << sval;
+				ERRSET();
+			}
+		}
+		Error::code=PetscOptionsGetInt(NULL,swipr,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.prSlices = (int)ival;
+		md.prNp = md.prSlices;
+		Error::code=PetscOptionsGetInt(NULL,swiprnp,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.prNp = (int)ival;
+		Error::code=PetscOptionsGetInt(NULL,swiprcoarse,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.prCoarse = (int)ival;
+		Error::code=PetscOptionsGetReal(NULL,swiprtol,&rval,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.prTol = rval;
+		if ( (md.prSlices < 1) || (md.prNp < 1) || (md.prCoarse < 1) ){
+			Error::mess << swipr << ", " << swiprnp << " and " << swiprcoarse
+						<< " should be at least 1";
+			ERRSET();
+		}
+		Error::code=PetscOptionsHasName(NULL,swipshell,&setf);ERRCHK();
+		md.pshell = (setf == PETSC_TRUE ? 1 : 0);
+		if (md.pshell && md.pdirect){
+			Error::mess << swipshell << " and " << swipdirect << " can not be used together";
+			ERRSET();
+		}
+		//distributed mode, when started with mpirun -np N
+		Error::code=MPI_Comm_size(PETSC_COMM_WORLD, &md.nrank);ERRCHK();
+		Error::code=MPI_Comm_rank(PETSC_COMM_WORLD, &md.rank);ERRCHK();
+		if (md.nrank > 1){
+			md.comm = PETSC_COMM_WORLD;
+			md.quiet = (md.rank != 0);
+			if (md.rank != 0) cout.setstate(std::ios::failbit); //only process 0 reports
+			if ( md.setfield || md.pdirect || md.pshell || (md.sscheme != MData::SEuler) ||
+				 (md.ltsMax > 1) || (md.prSlices > 1) || ( (md.steadyTol > 0) && md.steadyPtc ) ){
+				Error::mess << "with more than one process only the euler saturation scheme is supported, "
+							<< "without " << swisetf << ", " << swipdirect << ", " << swipshell << ", "
+							<< swiltsmax << ", " << swipr << " and the ptc steady action";
+				ERRSET();
+			}
+		}
+		//threads, one mesh partition each
+		Error::code=PetscOptionsGetInt(NULL,swithreads,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.nthread = (int)ival;
+		if (md.nthread < 1){
+			Error::mess << swithreads << " should be at least 1, found: " << md.nthread;
+			ERRSET();
+		}
+		if ( (md.nthread > 1) && ( (md.nrank > 1) || (md.prSlices > 1) ) ){
+			Error::mess << swithreads << " can not be used with more than one process or with " << swipr;
+			ERRSET();
+		}
+		//ensemble of runs on the same mesh
+		Error::code=PetscOptionsGetInt(NULL,swiens,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.ensN = (int)ival;
+		md.ensNp = md.ensN;
+		Error::code=PetscOptionsGetInt(NULL,swiensnp,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.ensNp = (int)ival;
+		if ( (md.ensN < 0) || ( (md.ensN > 0) && (md.ensNp < 1) ) ){
+			Error::mess << swiens << " should not be negative and " << swiensnp << " should be at least 1";
+			ERRSET();
+		}
+		if ( (md.ensN > 0) && ( md.setfield || (md.nrank > 1) || (md.prSlices > 1) ) ){
+			Error::mess << swiens << " can not be used with " << swisetf << ", " << swipr
+						<< " or more than one process";
+			ERRSET();
+		}
+		//cache of the states
+		Error::code=PetscOptionsHasName(NULL,swicacheoff,&setf);ERRCHK();
+		md.cacheOff = (setf == PETSC_TRUE ? 1 : 0);
+		//binary mesh image
+		Error::code=PetscOptionsHasName(NULL,swimeshimg,&setf);ERRCHK();
+		md.meshImg = (setf == PETSC_TRUE ? 1 : 0);
+		//checkpoints
+		Error::code=PetscOptionsGetInt(NULL,swickpt,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.ckptSteps = (int)ival;
+		Error::code=PetscOptionsGetReal(NULL,swickptwall,&rval,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.ckptWall = rval;
+		Error::code=PetscOptionsHasName(NULL,swiresume,&setf);ERRCHK();
+		md.resume = (setf == PETSC_TRUE ? 1 : 0);
+		if ( (md.ckptSteps < 0) || (md.ckptWall < 0) ){
+			Error::mess << swickpt << " and " << swickptwall << " should not be negative";
+			ERRSET();
+		}
+		if ( (md.ckptSteps || md.ckptWall || md.resume) && ( (md.nrank > 1) || (md.prSlices > 1) ) ){
+			Error::mess << swickpt << ", " << swickptwall << " and " << swiresume
+						<< " can only be used on one process and without " << swipr;
+			ERRSET();
+		}
+		//output thread
+		Error::code=PetscOptionsGetInt(NULL,swioutasync,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.outAsync = (int)ival;
+		if (md.outAsync < 0){
+			Error::mess << swioutasync << " should not be negative, found: " << md.outAsync;
+			ERRSET();
+		}
+		if ( md.outAsync && (md.prSlices > 1) ){   //the thread would not survive the forks of the fine solves
+			Error::mess << swioutasync << " can not be used with " << swipr;
+			ERRSET();
+		}
+		//compressed visual fields, error bounds of S, P and the velocities
+		ival = 3;
+		Error::code=PetscOptionsGetRealArray(NULL,swilossy,md.lossyTol,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE){
+			md.lossy = 1;
+			for (int i = (int)ival ; i < 3 ; i++) md.lossyTol[i] = ( ival ? md.lossyTol[ival-1] : 1e-4 );
+			if ( (md.lossyTol[0] < 0) || (md.lossyTol[1] < 0) || (md.lossyTol[2] < 0) ){
+				Error::mess << swilossy << " error bounds should not be negative";
+				ERRSET();
+			}
+		}
+		//series of keyframes and deltas, and the changes the deltas keep
+		Error::code=PetscOptionsGetInt(NULL,swidelta,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.deltaKey = (int)ival;
+		ival = 3;
+		Error::code=PetscOptionsGetRealArray(NULL,swideltatol,md.deltaTol,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE)
+			for (int i = (int)ival ; i < 3 ; i++) md.deltaTol[i] = ( ival ? md.deltaTol[ival-1] : 0 );
+		if ( (md.deltaKey < 0) || (md.deltaTol[0] < 0) || (md.deltaTol[1] < 0) || (md.deltaTol[2] < 0) ){
+			Error::mess << swidelta << " and " << swideltatol << " should not be negative";
+			ERRSET();
+		}
+		if (md.deltaKey && md.lossy){
+			Error::mess << swidelta << " can not be used with " << swilossy;
+			ERRSET();
+		}
+		//daemon
+		Error::code=PetscOptionsGetString(NULL,swidmn,sval,PETSC_MAX_PATH_LEN,&setf);ERRCHK();
+		if (setf == PETSC_TRUE){
+			md.dmnDir = sval;
+			if (md.dmnDir.empty() || (md.dmnDir[md.dmnDir.size() - 1] != '/')) md.dmnDir += '/';
+		}
+		Error::code=PetscOptionsGetInt(NULL,swidmnnp,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.dmnNp = (int)ival;
+		Error::code=PetscOptionsGetInt(NULL,swidmncache,&ival,&setf);ERRCHK();
+		if (setf == PETSC_TRUE) md.dmnCache = (int)ival;
+		if ( (md.dmnNp < 1) || (md.dmnCache < 1) ){
+			Error::mess << swidmnnp << " and " << swidmncache << " should be at least 1";
+			ERRSET();
+		}
+		if ( !md.dmnDir.empty() && ( (md.nrank > 1) || md.setfield || (md.ensN > 0) ) ){
+			Error::mess << swidmn << " can not be used with " << swisetf << ", " << swiens
+						<< " or more than one process";
+			ERRSET();
+		}
 		//report
 		cout << "\nWorking directory found: " << md.dir << endl
 			 << "Main data initialized successfuly" << endl
 			 << "Petsc initialized successfuly" << endl
-			 << "Running mode: " << (md.setfield ? "SetField" : "Solver" ) << endl;
+			 << "Running mode: " << (md.setfield ? "SetField" : "Solver" ) << endl
+			 << "Pressure solver: " << (md.pdirect ? "Direct" : (md.pshell ? "MatrixFree" : "KSP") ) ;
+		if (md.pdirect) cout << " |package: " << md.pdirectPackage
+							 << " |lag: " << md.pdirectLag;
+		cout << endl;
+		if (md.pUpdateTol > 0)
+			cout << "Pressure update: when total mobility changes more than "
+				 << md.pUpdateTol << endl;
+		cout << "Saturation scheme: " ;
+		switch (md.sscheme){
+		case MData::SEuler: cout << "Euler"; break;
+		case MData::SImplicit: cout << "Implicit"; break;
+		case MData::SSSPRK2: cout << "SSP-RK2 |tol: " << md.rkTol; break;
+		case MData::SSSPRK3: cout << "SSP-RK3 |tol: " << md.rkTol; break;
+		}
+		cout << endl;
+		cout << "Time step controller: " << (md.dtCtrl == MData::DtPI ? "PI" : "Retry") << endl;
+		if (md.steadyTol > 0)
+			cout << "Steady state: rate < " << md.steadyTol << " in " << md.steadyWin
+				 << " steps, then " << (md.steadyPtc ? "pseudo-transient" : "stop") << endl;
+		if (md.prSlices > 1)
+			cout << "Parareal: " << md.prSlices << " slices |processes: " << md.prNp
+				 << " |coarse steps: " << md.prCoarse << " |tol: " << md.prTol << endl;
+		if (md.ltsMax > 1)
+			cout << "Local time stepping: up to " << md.ltsMax << " sub-steps" << endl;
+		if (md.nrank > 1)
+			cout << "Distributed: " << md.nrank << " processes" << endl;
+		if (md.nthread > 1)
+			cout << "Threads: " << md.nthread << endl;
+		if (md.outAsync > 0)
+			cout << "Output thread: " << md.outAsync << " snapshots" << endl;
+		if (md.ensN > 0)
+			cout << "Ensemble: " << md.ensN << " members |processes: " << md.ensNp << endl;
 	
 		FuncEnd();
 	}
@@ -757,6 +4391,7 @@ namespace driver{
 		//visualtype
 		fl(); fl("visualtype"); fl(tstr,"visualtype_value");
 		if ( tstr.compare("vtk") == 0 )	md.visualtype = MData::VisualVtk;
+		else if ( tstr.compare("xdmf") == 0 ) md.visualtype = MData::VisualXdmf;
 		else if ( tstr.compare("tecplot") == 0 ){
 			Error::mess << "tecplot not supported yet. "
 						<< fl.fn << " line " << fl.ln ;
@@ -773,10 +4408,39 @@ namespace driver{
 			ERRSET();
 		}
 		fl(); fl("visualduplicate"); fl(md.visualduplicate, "visualduplicate_value");
+		if ( (md.lossy || md.deltaKey) && (md.visualtype != MData::VisualXdmf) ){
+			Error::mess << (md.lossy ? swilossy : swidelta) << " needs visualtype xdmf. " << fl.fn;
+			ERRSET();
+		}
+
+		//the outputs written, all of them unless a line after visualduplicate lists them
+		md.outFields = MData::OutAll;
+		tstr.clear();
+		if (fl.next()) fl.ss >> tstr;
+		if ( tstr.compare("outputfields") == 0 ){
+			md.outFields = 0;
+			while ( (fl.ss >> tstr) && (tstr[0] != '#') ){
+				int k;
+				for (k = 0 ; (k < visual_nfield) && tstr.compare(visual_names[k]) ; k++);
+				if (k < visual_nfield) md.outFields |= 1 << k;
+				else if ( tstr.compare("restart") == 0 ) md.outFields |= MData::OutRestart;
+				else if ( tstr.compare("flow") == 0 ) md.outFields |= MData::OutFlow;
+				else if ( tstr.compare("all") == 0 ) md.outFields |= MData::OutAll;
+				else{
+					Error::mess << "outputfields_" << tstr << " not supported. "
+								<< fl.fn << " line " << fl.ln ;
+					ERRSET();
+				}
+			}
+			if (md.outFields == 0){
+				Error::mess << "outputfields lists no output. " << fl.fn << " line " << fl.ln;
+				ERRSET();
+			}
+		}
 
 		//set values which were not read
 		md.t0 = md.t;
-		md.nFile0 = md.nFile;
+		md.nFile0 = md.nFileRun = md.nFile;
 		md.tWrite = (md.tEnd - md.t0) / (md.NFile - 1);
 
 		//report
@@ -803,6 +4467,7 @@ namespace driver{
 			 << "JModel: " << md.J->name() << endl
 			 << "MeshType: " << md.meshtype << endl
 			 << "VisualType: " << md.visualtype << endl
+			 << "OutputFields: " << md.outFields << endl
 			 << "TWrite: " << md.tWrite << endl;
 				
 		FuncEnd();
@@ -811,30 +4476,46 @@ namespace driver{
 	void readmesh(MData &md, Mesh &msh){
 		FuncBegin();
 
+		MeshRecord rec;
+		MeshGeo geo;
+		PetscLogDouble w0, w1;
+		PetscTime(&w0);
+		//before constructGeoParams sorts the regions
+		const uint64_t gh = ( md.meshImg ? geo_hash(md, msh) : 0 );
+		const bool img = md.meshImg && mesh_image_read(md, msh, geo, gh);
+
 		//read the file
-		switch(md.meshtype){
-		case MData::MeshTriangle:
-			readmesh_triangle(md,msh);
-			break;
-		case MData::MeshGmsh:
-			readmesh_gmsh(md,msh);
-			break;
-		default:
-			Error::mess << "invalid mesh" ;
-			ERRSET();
-		}
+		if (!img) readmesh_files(md, msh, md.meshImg ? &rec : NULL);
 		//construct the mesh
-		msh.constructGeoParams(md.J->cmp, md.dp, md.A, md.grav);
+		msh.constructGeoParams(md.J->cmp, md.dp, md.A, md.grav, md.comm, md.nthread,
+							   ( img || (md.meshImg && (md.nrank == 1)) ) ? &geo : NULL);
+		PetscTime(&w1);
+		if (md.meshImg && !img && (md.nrank == 1)) mesh_image_write(md, rec, geo, gh);
 		//report
-		cout << "\nMesh file(s) was read successfuly." << endl;
+		if (img) cout << "\nMesh image " << md.dir + adrimg << " was read successfuly." << endl;
+		else cout << "\nMesh file(s) was read successfuly." << endl;
+		cout << "Mesh read and constructed in " << w1 - w0 << " s" << endl;
+		if (md.nrank > 1)
+			cout << "Mesh partitioned: " << msh.nownnode() << " nodes and "
+				 << msh.endghostnode() - msh.endownnode() << " ghost nodes on process 0" << endl;
+		if (msh.npart() > 1)
+			cout << "Mesh partitioned: " << msh.npart() << " parts with "
+				 << msh.nnode() - msh.partnode(msh.npart()) << " interface nodes" << endl;
 		
 		FuncEnd();
 	}
 	
+	void readmeshfile(MData &md, Mesh &msh){
+		FuncBegin();
+		readmesh_files(md, msh, NULL);
+		FuncEnd();
+	}
+
 	void readinitial(MData &md, Mesh &msh){
 		FuncBegin();
 		
-		AsciiFile fl;
+		MapFile fl;
+		vector<MapLine> lines;
 	    char mod;
 		double s0;
 		bool uni;
@@ -858,13 +4539,15 @@ namespace driver{
 						<< " mod \"" << mod << "\" is invalid";
 			ERRSET();
 		}	
-		for (vector<Node>::iterator i = msh.begnode() ; i != msh.endnode() ; i++){
-			if (uni){
+		if (uni){
+			for (vector<Node>::iterator i = msh.begnode() ; i != msh.endnode() ; i++)
 				md.S.at(i->dd.front().idx) = s0;
-			}
-			else{
-				fl(); fl( md.S.at(i->dd.front().idx) ,"non-uni s value");
-			}
+		}
+		else{
+			fl.lines(msh.nnode(), lines);
+			parse_lines(md, fl, lines, [&](MapLine &l, const int i) -> const char*{
+				return ( l(md.S[ msh.begnode()[i].dd.front().idx ]) ? NULL : "non-uni s value" );
+			});
 		}
 		
 		//print
@@ -928,7 +4611,7 @@ namespace driver{
 		//write the initialcondition
 		writeinitial(md,msh,md.dir+adrini,false,false );
 		//write a vtk file
-		writevisual((md.dir+"newfield.vtk").c_str(),md,msh);
+		writevisual((md.dir + (md.visualtype == MData::VisualVtk ? "newfield.vtk" : "newfield")).c_str(),md,msh);
 		
 		//print
 		cout << "Field was set and saved successfully in " << md.dir+adrini << endl;	
@@ -940,7 +4623,33 @@ namespace driver{
 	void preparedata (MData &md, Mesh &msh){
 		FuncBegin();
 
-		const arma::rowvec *vol;
+		allocdata(md, msh);
+		initdata(md, msh);
+		//dt history file
+		md.dtF << left;
+		if (md.rank == 0){
+			md.dtF.open((md.dir + adrresult + ".dt").c_str(), fstream::app | fstream::out);
+			if (!md.dtF.is_open()){
+				Error::mess << md.dir + adrresult + ".dt" << " could not be openned.";
+				ERRSET();
+			}
+		}
+		if (md.dtF.is_open() && (md.dtF.tellp() == 0))
+			md.dtF << setw(10) << "# n"
+				   << setw(15) << "t"
+				   << setw(15) << "dt"
+				   << setw(15) << "ds"
+				   << setw(10) << "dn_it"
+				   << setw(10) << "n_rej"
+				   << setw(10) << "n_lim" << endl;
+		//report
+		std::cout << "External data initialized successfuly ..." << std::endl;
+		FuncEnd();
+	}
+
+	void allocdata (MData &md, Mesh &msh){
+		FuncBegin();
+
 	    md.Pc.resize(msh.ndd(),0);
 		md.SPhiV.resize(msh.nnode(),0);
 		md.VPhi.resize(msh.ndd(),0);
@@ -950,16 +4659,51 @@ namespace driver{
 		md.dS.resize(msh.ndd(),0);
 		md.DgH.resize(msh.nnode(),0); //gravity
 		//Vectors
-		Error::code=VecCreateSeq(PETSC_COMM_SELF, msh.nnode(), &md.Pvec);ERRCHK();	
+		if (md.nrank > 1){
+			Error::code=VecCreateMPI(md.comm, msh.nownnode(), msh.nnode(), &md.Pvec);ERRCHK();
+			dist_setup(md, msh);
+		}
+		else{
+			Error::code=VecCreateSeq(PETSC_COMM_SELF, msh.nnode(), &md.Pvec);ERRCHK();
+		}
 		Error::code=VecDuplicate(md.Pvec, &md.b);ERRCHK();
-		Error::code=VecGetArrayRead(md.Pvec, &md.P);ERRCHK();
+		Error::code=VecGetArrayRead( (md.Ploc ? md.Ploc : md.Pvec), &md.P);ERRCHK();
 		Error::code=VecSet(md.Pvec, 0);ERRCHK();                //gravity - starts with zero, might cause problems.
+		//threads
+		if (md.nthread > 1){
+			md.pool = new ThreadPool(md.nthread);
+			md.FsIf.assign(md.nthread, vector<double>(msh.nnode() - msh.partnode(msh.npart()), 0));
+		}
 		//KSP
-		Error::code=KSPCreate(PETSC_COMM_SELF, &md.ksp);ERRCHK();
+		Error::code=KSPCreate(md.comm, &md.ksp);ERRCHK();
 		Error::code=KSPSetOperators(md.ksp, md.A, md.A);ERRCHK();
+		md.mesh = &msh;
+		if ( (md.sscheme == MData::SImplicit) || ( (md.steadyTol > 0) && md.steadyPtc ) ||
+			 (md.prSlices > 1) )
+			simp_setup(md, msh);
+		md.stRates.resize(md.steadyWin + 1, 0);
+		md.stQWin.resize(md.steadyWin + 1, 0);
+		md.stQWout.resize(md.steadyWin + 1, 0);
+		md.rkS0.resize(msh.nnode(), 0);
+		md.rkS1.resize(msh.nnode(), 0);
+		md.rkS2.resize(msh.nnode(), 0);
+		if (md.pshell) pshell_setup(md, msh);
+		if (md.pdirect) pdirect_setup(md);     //the defaults, petsc.config and the command line go over them
 		Error::code=KSPSetFromOptions(md.ksp);ERRCHK();
-		//SphiV
-		for (list<eleblank*>::iterator i = msh.begele() ; i != msh.endele() ; i++ ){
+		if (md.pshell) pshell_check(md);
+
+		FuncEnd();
+	}
+
+	void initdata (MData &md, Mesh &msh){
+		FuncBegin();
+
+		const arma::rowvec *vol;
+		Error::code=VecSet(md.Pvec, 0);ERRCHK();
+		if (md.nrank > 1) dist_p(md);
+		//SphiV, all the elements around the owned nodes are needed
+		std::fill(md.VPhi.begin(), md.VPhi.end(), 0);
+		for (list<eleblank*>::iterator i = msh.begele() ; i != msh.endeleall() ; i++ ){
 			//calc SphiV
 			for (int j = 0 ; j < (*i)->nNode() ; j++ ){
 				vol = &(*i)->matVolume();
@@ -978,8 +4722,9 @@ namespace driver{
 			(*i)->fndUpW(md.P);
 			(*i)->fndUpN(md.P,md.Pc);
 		}
-		//report
-		std::cout << "External data initialized successfuly ..." << std::endl;
+		md.Vw0 = cmp_vw(md, msh);
+		PetscTime(&md.wT0);
+
 		FuncEnd();
 	}
 	
@@ -987,114 +4732,57 @@ namespace driver{
 		FuncBegin();
 
 		//set initial values
-		bool flag = false;
-		double ds = 0 ;
+		bool flag = false, solvep;
+		double ds = 0 , mb;
+		const double q0[] = {md.qIn, md.qOut, md.qWin, md.qWout};
 		int it ; double res;
-		const arma::vec *rhs;
-	    const arma::mat *lhs;
-		const arma::ivec *idx;
-		md.dcT = clock();
+		PetscLogDouble mem, w0, w1;
+		PetscTime(&w0);
 		md.dnIt = 0;
 
-		//assemble P equation
-		Error::code=VecSet(md.b, 0);ERRCHK();
-		Error::code=MatZeroEntries(md.A);ERRCHK();
-		for (list<eleblank*>::iterator i = msh.begele() ; i != msh.endele() ; i++){
-			//update non wetting upwind
-			(*i)->fndUpN(md.P, md.Pc);
-			//get mats
-			lhs = &(*i)->lhsP(md.Lw,md.Ln);
-			rhs = &(*i)->rhsP(md.Ln,md.Pc, 0);
-			idx = &(*i)->idxGlob();	
-			Error::code=MatSetValues(md.A,
-									 (*i)->nNode(), idx->memptr(),
-									 (*i)->nNode(), idx->memptr(),
-									 lhs->memptr(), ADD_VALUES);ERRCHK();
-			Error::code=VecSetValues(md.b,
-									 (*i)->nNode(), idx->memptr(),
-									 rhs->memptr(),ADD_VALUES);ERRCHK();
-		}
-		Error::code=MatAssemblyBegin(md.A, MAT_FINAL_ASSEMBLY);ERRCHK();
-		Error::code=MatAssemblyEnd(md.A, MAT_FINAL_ASSEMBLY);ERRCHK();
-		Error::code=VecAssemblyBegin(md.b);ERRCHK();
-		Error::code=VecAssemblyEnd(md.b);ERRCHK();
-
-		//force boundary condition
-		for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++)
-			(*i)->assemP(md.A, md.b);
-		
-		//Solve the p equation
-		Error::code=KSPSolve(md.ksp, md.b, md.Pvec);ERRCHK();
-		
-		//assemble S equation
-		//make the flux zero
-		for (int i = 0 ; i < msh.nnode() ; i++) md.Fs.at(i) = 0;
-		for (list<eleblank*>::iterator i = msh.begele() ; i != msh.endele() ; i++){
-			//update wetting upwind node
-			(*i)->fndUpW(md.P);
-			//get mat and idx
-			rhs = &(*i)->rhsS(md.Lw, md.P, 0);
-			idx = &(*i)->idxGlob();
-            //assemble
-			for (int j = 0 ; j < (*i)->nNode();  j++)
-				md.Fs.at( (*idx)(j) ) += (*rhs)(j) ;
-		}
+		//solve the p equation only if the total mobility has changed enough
+		md.dLt = cmp_dlt(md);
+		solvep = ( md.pUpdateTol <= 0 ) || ( md.nPSolve == 0 ) || ( md.dLt > md.pUpdateTol );
+		if (solvep) solve_p(md, msh);
 		
-		//force boundary condition
-		for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++){
-			(*i)->findQAll(md.Fs, md.P, md.Lw, md.Ln);
-			(*i)->assemS(md.Fs);
-		}
+		//assemble S equation, the upwind nodes are kept with p
+		assem_s(md, msh, solvep);
+		if (md.steadyTol > 0) md.stRate = cmp_rate(md, msh);
 		
 		//solve for ds
-		do {
-			md.dnIt++;
-			ds = 0;
-			for (vector<Node>::iterator j = msh.begnode() ; j < msh.endnode() ; j++){
-				md.dS.at(j->dd.front().idx) =	md.Fs.at(j->idx) * md.dt /md.dn / md.SPhiV.at( j->idx ) ;
-				ds = fmax( ds , fabs(md.dS.at(j->dd.front().idx)) );
-			}			
-			if (ds > md.dsM){
-				md.dt /= md.beta;
-				if ( (md.dt < md.dtm) || ( md.dnIt > md.dnItM ) ){
-				Error::mess << "either min_dt or max_s_iter error." << endl
-							<< "dt: " << md.dt << "\tdtm: " << md.dtm
-							<< " dn_it: " << md.dnIt << "\tdn_max: " << md.dnItM;
-				ERRSET();
-				}
-			}
-			else {
-				if (ds < md.dsm) flag = true;
-				break;
-			}
-		}while(true);
-		
-		//update everything
-		for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++){
-			md.S.at(i->dd.front().idx) += md.dS.at(i->dd.front().idx);
-			cmpnode_slave_s(md, *i);
-		    cmpnode_sphiv(md, *i);
-			cmpnode_cappil_mobil(md, *i);
-		}
-
-	//update the fluxes
-	for (list<BVertexCQ*>::iterator i = msh.begbvertex() ; i != msh.endbvertex() ; i++){
-		md.qIn   += fmax( 0 , (*i)->mGamma()  ) * md.dt / md.dp;
-		md.qOut  -= fmin( 0 , (*i)->mGamma()  ) * md.dt / md.dp;
-		md.qWin  += fmax( 0 , (*i)->mGammaW() ) * md.dt / md.dp;
-		md.qWout -= fmin( 0 , (*i)->mGammaW() ) * md.dt / md.dp;
-	}
+		if (md.sscheme == MData::SImplicit) ds = simp_march(md, msh, flag);
+		else if (md.sscheme == MData::SEuler) ds = euler_march(md, msh, flag);
+		else ds = rk_march(md, msh);
+		if (md.nrank > 1) dist_q(md, q0);
 	
 	//update time step
 	md.t += md.dt;
     md.nIt += md.dnIt;
-	md.dcT = (clock()-md.dcT) / CLOCKS_PER_SEC;
+	md.nStep++;
+	mb = cmp_vw(md, msh) - md.Vw0 - (md.qWin - md.qWout) * md.dp / md.dn;
+	if (md.dtF.is_open())
+		md.dtF << setw(10) << md.nStep
+			   << setw(15) << md.t
+			   << setw(15) << md.dt
+			   << setw(15) << ds
+			   << setw(10) << md.dnIt
+			   << setw(10) << md.nDtRej
+			   << setw(10) << md.nDtLim << endl;
+	PetscTime(&w1);
+	md.dcT = w1 - w0;
 	md.cT += md.dcT ;
 	Error::code = KSPGetResidualNorm(md.ksp,&res);ERRCHK();
 	Error::code = KSPGetIterationNumber(md.ksp,&it);ERRCHK();
+	Error::code = PetscMemoryGetCurrentUsage(&mem);ERRCHK();
 	if (flag ) md.dt = fmin ( md.dtM, md.dt * md.beta );
+	if (md.steadyTol > 0) steady_check(md);
+	if (md.dtNext > 0){
+		md.dt = fmin ( md.dtM, md.dtNext );
+		md.dtNext = 0;
+	}
 
 	//report
+	if (md.quiet) return;
 	cout << left ;
 	cout << setw(10) << "t_COMP: " << setw(15) << md.t 
 						<< setw(10)<< "t_clock: " << setw(15)<< md.cT 
@@ -1104,73 +4792,437 @@ namespace driver{
 						<< setw(10)<< "dn_it: " << setw(15)<< md.dnIt <<endl
 						<< setw(10)<< "ds_max: "<< setw(15) << ds
 						<< setw(10)<< "ksp it: "<< setw(15) << it 
-						<< setw(10)<< "ksp res: " << setw(15)<< res << "\n\n";
+						<< setw(10)<< "ksp res: " << setw(15)<< res <<endl
+						<< setw(10)<< "p_clock: " << setw(15) << md.dpT
+						<< setw(10)<< "mem_MB: " << setw(15) << mem / 1048576.
+						<< setw(10)<< "p_it: " << setw(15)<< md.nPSolve <<endl
+						<< setw(10)<< "dLt: " << setw(15)<< md.dLt
+						<< setw(10)<< "n_step: " << setw(15)<< md.nStep
+						<< setw(10)<< "mb_err: " << setw(15)<< mb <<endl
+						<< setw(10)<< "lts_m: " << setw(15)<< md.ltsM
+						<< setw(10)<< "n_fast: " << setw(15)<< md.ltsNFast
+						<< setw(10)<< "newt_it: " << setw(15)<< md.nSNESIt
+						<< setw(10)<< "rk_err: " << setw(15)<< md.rkErr << "\n\n";
 
 		FuncEnd();
 	}
 	
+	void parareal(MData &md, Mesh &msh){
+		FuncBegin();
+
+		const int N = md.prSlices;
+		const double dt0 = md.dt;
+		const double q0[] = {md.qIn, md.qOut, md.qWin, md.qWout};
+		vector<double> T(N+1), w(N, 0), g;
+		vector< vector<double> > U(N+1), G(N+1), F(N+1), q(N, vector<double>(4, 0));
+		vector< vector<PrOutput> > o(N);
+		PetscLogDouble w0, w1;
+		double err = 0, serial = 0;
+		int k;
+
+		PetscTime(&w0);
+		//the children must not write in the dt file together
+		md.dtF.close();
+		md.quiet = 1;
+		md.steadyTol = 0;
+		for (int n = 0 ; n <= N ; n++) T[n] = md.t + (md.tEnd - md.t) * n / N;
+		U[0].resize(msh.nnode());
+		for (vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++)
+			U[0].at(i->idx) = md.S.at(i->dd.front().idx);
+
+		//first guess from the coarse propagator
+		for (int n = 0 ; n < N ; n++){
+			G[n+1] = U[n];
+			parareal_coarse(md, msh, G[n+1], T[n], T[n+1]);
+			U[n+1] = G[n+1];
+		}
+
+		//iterations, after k iterations the first k slices are exact
+		for (k = 0 ; k < N ; k++){
+			parareal_fines(md, msh, k, N, T, U, F, q, w, o, dt0);
+			if (k == 0) for (int n = 0 ; n < N ; n++) serial += w[n];
+			//correction U(n+1) = G(U(n)) + F(U_old(n)) - G(U_old(n))
+			err = 0;
+			for (int n = k ; n < N ; n++){
+				if (n == k) g = G[n+1];
+				else{
+					g = U[n];
+					parareal_coarse(md, msh, g, T[n], T[n+1]);
+				}
+				for (int i = 0 ; i < msh.nnode() ; i++){
+					double un = fmin(1, fmax(0, g[i] + F[n+1][i] - G[n+1][i]));
+					err = fmax( err, fabs(un - U[n+1][i]) );
+					U[n+1][i] = un;
+				}
+				G[n+1] = g;
+			}
+			cout << "Parareal iteration: " << k + 1 << " max change: " << err << endl;
+			if (err < md.prTol) break;
+		}
+		md.prIt = std::min(k + 1, N);
+		PetscTime(&w1);
+
+		//write the outputs of the fine solves and the ends of the slices, every tWrite
+		//as marching does, P is solved again for the saturations written
+		md.quiet = 0;
+		md.qIn = q0[0]; md.qOut = q0[1]; md.qWin = q0[2]; md.qWout = q0[3];
+		for (int n = 0 ; n < N ; n++){
+			const double qa[] = {md.qIn, md.qOut, md.qWin, md.qWout};
+			for (size_t i = 0 ; i < o[n].size() ; i++){
+				rk_set(md, msh, o[n][i].u);
+				solve_p(md, msh);
+				md.t = o[n][i].t;
+				md.qIn = qa[0] + o[n][i].q[0]; md.qOut = qa[1] + o[n][i].q[1];
+				md.qWin = qa[2] + o[n][i].q[2]; md.qWout = qa[3] + o[n][i].q[3];
+				writeintime(md, msh, false);
+			}
+			rk_set(md, msh, U[n+1]);
+			solve_p(md, msh);
+			md.t = T[n+1];
+			md.qIn = qa[0] + q[n][0]; md.qOut = qa[1] + q[n][1]; md.qWin = qa[2] + q[n][2]; md.qWout = qa[3] + q[n][3];
+			writeintime(md, msh, n == N - 1);
+		}
+		md.cT = w1 - w0;
+		cout << "Parareal: slices: " << N << " iterations: " << md.prIt
+			 << " max change: " << err << endl
+			 << "Parareal: wall time: " << md.cT << " serial fine time: " << serial
+			 << " speedup: " << serial / md.cT << endl;
+
+		FuncEnd();
+	}
+
+	void solve(MData &md, Mesh &msh){
+		FuncBegin();
+
+		//states of a run with the same inputs are kept, to go on from them
+		if ( !md.cacheOff && (md.nrank == 1) && (md.prSlices == 1) )
+			md.inHash = input_hash(md, msh);
+		preparedata(md,msh);
+		if (md.resume) checkpoint_resume(md, msh);
+		else if (md.inHash) cache_resume(md, msh);
+		md.nFileRun = md.nFile;
+		//the output thread writes what is left if the run stops with an error
+		std::unique_ptr<SeriesWriter> series;
+		if ( md.deltaKey && (md.rank == 0) ){
+			int npts, nele, nmix;
+			xdmf_sizes(md, msh, npts, nele, nmix);
+			series.reset(new SeriesWriter(md.dir + adrresult, md.deltaKey, md.nFile, npts, nele, nmix));
+		}
+		md.series = series.get();
+		std::unique_ptr<OutputQueue> outq;
+		if ( md.outAsync && (md.rank == 0) ) outq.reset(new OutputQueue(msh, md.outAsync));
+		md.outq = outq.get();
+		if (md.prSlices > 1){               //parallel in time
+			parareal(md, msh);
+		}
+		else while ( md.t < md.tEnd){
+			marchintime(md, msh);        //solve the system once in time
+			writeintime(md, msh,false);  //write the data if required
+			if (md.ckptSteps || md.ckptWall) checkpoint_write(md, msh);
+		}
+		if (md.steadyState == MData::SteadyDone)
+			writeintime(md, msh, true); //the final steady state
+		if (outq) outq->flush();        //the files are all written before the run ends
+		md.outq = NULL;
+		md.series = NULL;
+		writescaling(md, msh);          //wall times for the scaling table
+
+		FuncEnd();
+	}
+
+	void ensemble(MData &md, Mesh &msh){
+		FuncBegin();
+
+		vector<pid_t> pid(md.ensN, -1);
+		vector<int> ok(md.ensN, 0);
+		PetscLogDouble w0, w1;
+		int next = 0, nrun = 0, status, nfail = 0;
+		pid_t p;
+
+		PetscTime(&w0);
+		cout << "\nRunning " << md.ensN << " ensemble members, the output of each one is in its df2d.log" << endl;
+		while ( (next < md.ensN) || (nrun > 0) ){
+			//start members until ensNp are running
+			while ( (next < md.ensN) && (nrun < md.ensNp) ){
+				stringstream what;
+				what << "ensemble member " << next;
+				pid[next] = fork_child(md, what.str());
+				if (pid[next] == 0){
+					try{
+						ensemble_member(md, msh, next);
+					}
+					catch(...){
+						cout.flush();
+						_exit(1);
+					}
+					_exit(0);
+				}
+				next++;
+				nrun++;
+			}
+			//wait for any of them
+			p = waitpid(-1, &status, 0);
+			if (p < 0) break;
+			for (int m = 0 ; m < md.ensN ; m++){
+				if (pid[m] != p) continue;
+				ok[m] = WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+				nrun--;
+				cout << "Member " << m << (ok[m] ? " finished" : " failed") << endl;
+			}
+		}
+		PetscTime(&w1);
+		md.cT = w1 - w0;
+		for (int m = 0 ; m < md.ensN ; m++) if (!ok[m]) nfail++;
+		cout << "Ensemble finished: " << md.ensN - nfail << " of " << md.ensN << " members in "
+			 << md.cT << " seconds." << endl;
+		if (nfail){
+			Error::mess << nfail << " ensemble members failed, see member*/df2d.log";
+			ERRSET();
+		}
+
+		FuncEnd();
+	}
+
+	void daemon(MData &md){
+		FuncBegin();
+
+		list<MeshCache> cache;            //most recently used first
+		std::map<pid_t, string> run;
+		DIR *dp;
+		struct dirent *de;
+		vector<string> jobs;
+		string name;
+		int status, njob = 0, nhit = 0;
+		pid_t pid;
+
+		cout << "\nDaemon waiting for jobs in " << md.dmnDir << " |processes: " << md.dmnNp
+			 << " |meshes kept: " << md.dmnCache << endl;
+		while (true){
+			//finished jobs
+			while ( (pid = waitpid(-1, &status, WNOHANG)) > 0 ){
+				if (run.find(pid) == run.end()) continue;
+				name = run[pid];
+				run.erase(pid);
+				const bool ok = WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+				rename( (md.dmnDir + name + ".run").c_str(),
+						(md.dmnDir + name + (ok ? ".done" : ".fail")).c_str() );
+				cout << "Job " << name << (ok ? " finished" : " failed") << endl;
+			}
+			//stop when asked to and nothing runs
+			if ( (access( (md.dmnDir + "stop").c_str(), F_OK ) == 0) && run.empty() ) break;
+			//new jobs, oldest name first
+			jobs.clear();
+			if ( (int)run.size() < md.dmnNp && (dp = opendir(md.dmnDir.c_str())) ){
+				while ( (de = readdir(dp)) ){
+					name = de->d_name;
+					if ( (name.size() > 4) && (name.compare(name.size() - 4, 4, ".job") == 0) )
+						jobs.push_back( name.substr(0, name.size() - 4) );
+				}
+				closedir(dp);
+				std::sort(jobs.begin(), jobs.end());
+			}
+			if ( jobs.empty() || (access( (md.dmnDir + "stop").c_str(), F_OK ) == 0) ){
+				usleep(100000);
+				continue;
+			}
+			for (int j = 0 ; (j < (int)jobs.size()) && ( (int)run.size() < md.dmnNp ) ; j++){
+				name = jobs[j];
+				//claim the job, another daemon might have taken it
+				if ( rename( (md.dmnDir + name + ".job").c_str(), (md.dmnDir + name + ".run").c_str() ) != 0 )
+					continue;
+				njob++;
+				MData jd;
+				Mesh *regs = NULL;
+				jd.initialize();
+				try{
+					//read what the mesh depends on, and find it in the cache
+					jd.dir = daemon_case(md, name);
+					jd.nthread = md.nthread;
+					regs = new Mesh;
+					readregion(jd, *regs);
+					readfixed(jd);
+					const uint64_t h = mesh_hash(jd, *regs);
+					list<MeshCache>::iterator c = cache.begin();
+					while ( (c != cache.end()) && (c->hash != h) ) c++;
+					if (c != cache.end()){
+						cache.splice(cache.begin(), cache, c);
+						delete regs;
+						nhit++;
+					}
+					else{
+						readmesh(jd, *regs);
+						MeshCache mc = {h, regs, jd.A};
+						jd.A = (Mat) NULL;
+						cache.push_front(mc);
+						if ( (int)cache.size() > md.dmnCache ){
+							delete cache.back().msh;
+							MatDestroy(&cache.back().A);
+							cache.pop_back();
+						}
+					}
+					regs = NULL;
+					//run it
+					pid = fork_child(md, "job " + name);
+					if (pid == 0){
+						try{
+							if ( !freopen( (md.dmnDir + name + ".log").c_str(), "w", stdout ) ) _exit(1);
+							daemon_job(jd, cache.front());
+						}
+						catch(...){
+							cout.flush();
+							_exit(1);
+						}
+						_exit(0);
+					}
+					run[pid] = name;
+					cout << "Job " << name << " started: " << jd.dir << endl;
+				}
+				catch(Error &e){
+					if (regs) delete regs;
+					std::ofstream fl( (md.dmnDir + name + ".log").c_str() );
+					fl << Error::mess.str() << endl;
+					Error::mess.str("");
+					rename( (md.dmnDir + name + ".run").c_str(), (md.dmnDir + name + ".fail").c_str() );
+					cout << "Job " << name << " failed" << endl;
+				}
+				jd.A = (Mat) NULL;
+				jd.finalize();
+			}
+		}
+		for (list<MeshCache>::iterator c = cache.begin() ; c != cache.end() ; c++){
+			delete c->msh;
+			MatDestroy(&c->A);
+		}
+		cout << "Daemon stopped after " << njob << " jobs, " << nhit << " of them on a kept mesh." << endl;
+
+		FuncEnd();
+	}
+
 	void writeintime(MData &md, Mesh &msh, bool force){
     	FuncBegin();
 
+		//pseudo time is meaningless
+		if ( (md.steadyState == MData::SteadyPTC) && !force ) return;
+
 		if ( force || ( (md.t - md.t0) > (md.nFile - md.nFile0) * md.tWrite ) ){
-			fstream fl;
-			stringstream ss;
 			double vw;
-			fl << left;
-			
-			//open result.flow file
-			ss << md.dir+adrresult << ".flow";
-			fl.open(ss.str().c_str(),fstream::app | fstream::out);
-			if (!fl.is_open()){
-				Error::mess << ss.str() << " could not be openned.";
-				ERRSET();
+
+			//only process 0 writes, with the data of all the processes
+			vw = ( md.outFields & MData::OutFlow ? cmp_vw(md, msh) : 0 );
+			if (md.nrank > 1) dist_gather(md, msh);
+			if (md.rank != 0){
+				md.nFile++;
+				return;
 			}
-			
-			//write header
-			if(fl.tellp() == 0)
-				fl << setw(5) << "# n"
-				   << setw(15) << "t"
-				   << setw(15) << "Q_in"
-				   << setw(15) << "Q_out"
-				   << setw(15) << "Q_w_in"
-				   << setw(15) << "Q_w_out"
-				   << setw(15) << "V_w" << endl ;
-			if (md.nFile == 0) fl << endl;
-			
-			//find V_w
-			vw = 0;
-			for(vector<Node>::iterator i = msh.begnode() ; i < msh.endnode() ; i++)
-				for(std::list<DuplData>::iterator j = i->dd.begin() ; j != i->dd.end() ; j++)
-					vw += md.VPhi.at(j->idx) * md.S.at(j->idx);
-			
-			//write data
-			fl << setw(5) << md.nFile
-			   << setw(15) << md.t
-			   << setw(15) << md.qIn
-			   << setw(15) << md.qOut
-			   << setw(15) << md.qWin
-			   << setw(15) << md.qWout
-			   << setw(15) << vw << endl;
-			
-			//close the file
-			fl.close();
-			
-			//write restart file
-			ss.str("");
-			ss << md.dir+adrrestart << "." << md.nFile;
-			writeinitial(md, msh, ss.str(), true, false);
-			//write visual file
-			ss.str("");
-			ss << md.dir+adrresult << "." << md.nFile;
-			writevisual(ss.str().c_str(), md, msh);
-			
+
+			if (md.outq){
+				//copy what is written and go on, the output thread writes it
+				const int of = md.outFields;
+				const bool w = of & (MData::OutQw | MData::OutQtotal), n = of & (MData::OutQn | MData::OutQtotal);
+				Snapshot *s = md.outq->acquire();
+				if (of & (MData::OutSwNode | MData::OutSwCell | MData::OutRestart)) s->md.S = md.S;
+				else s->md.S.clear();
+				if (n) s->md.Pc = md.Pc; else s->md.Pc.clear();
+				if (w) s->md.Lw = md.Lw; else s->md.Lw.clear();
+				if (n) s->md.Ln = md.Ln; else s->md.Ln.clear();
+				if ( (of & MData::OutPw) || w || n ) s->p.assign(md.P, md.P + msh.nnode());
+				else s->p.clear();
+				s->md.P = ( s->p.empty() ? NULL : &s->p[0] );
+				s->md.outFields = of;
+				s->md.t = md.t; s->md.nFile = md.nFile; s->md.nFile0 = md.nFile0; s->md.nFileRun = md.nFileRun; s->md.dp = md.dp; s->md.dir = md.dir;
+				s->md.qIn = md.qIn; s->md.qOut = md.qOut; s->md.qWin = md.qWin; s->md.qWout = md.qWout;
+				s->md.visualtype = md.visualtype; s->md.visualduplicate = md.visualduplicate;
+				s->md.lossy = md.lossy; std::copy(md.lossyTol, md.lossyTol + 3, s->md.lossyTol);
+				s->md.series = md.series; std::copy(md.deltaTol, md.deltaTol + 3, s->md.deltaTol);
+				s->vw = vw;
+				md.outq->push(s);
+			}
+			else write_output(md, msh, vw);
+
 			//increase file number
 			md.nFile++;
+			if (md.inHash) cache_write(md, msh);
 		}
 		
 		FuncEnd();
 	}
 	
+	void writescaling(MData &md, Mesh &msh){
+		FuncBegin();
+
+		fstream fl;
+		stringstream ss;
+		string line;
+		PetscLogDouble w;
+		double wall[3], nloc[2], imb[2], wall1 = 0, x;
+		int np, nn, ns;
+
+		//the slowest and the most loaded process
+		PetscTime(&w);
+		wall[0] = w - md.wT0;
+		wall[1] = md.wP;
+		wall[2] = md.wH;
+		nloc[0] = msh.nownnode();
+		nloc[1] = std::distance(msh.begele(), msh.endele());
+		dist_reduce(md, wall, 3, MPI_MAX);
+		dist_reduce(md, nloc, 2, MPI_MAX);
+		imb[0] = nloc[0] * md.nrank / msh.nnode();
+		imb[1] = nloc[1] * md.nrank / msh.nele();
+		if (md.rank != 0) return;
+
+		//wall time of the same run on one process, from the older lines
+		ss << md.dir+adrresult << ".scaling";
+		fl.open(ss.str().c_str(), fstream::in);
+		while ( fl.is_open() && std::getline(fl, line) ){
+			stringstream ls(line);
+			if ( (line.size() == 0) || (line[0] == '#') ) continue;
+			if ( (ls >> np >> nn >> ns >> x) && (np == 1) && (nn == msh.nnode()) && (ns == md.nStep) )
+				wall1 = x;
+		}
+		fl.close();
+		if (md.nrank == 1) wall1 = wall[0];
+
+		//one line for this run
+		fl.clear();
+		fl << left;
+		fl.open(ss.str().c_str(), fstream::app | fstream::out);
+		if (!fl.is_open()){
+			Error::mess << ss.str() << " could not be openned.";
+			ERRSET();
+		}
+		if (fl.tellp() == 0)
+			fl << setw(6) << "# np"
+			   << setw(10) << "n_node"
+			   << setw(10) << "n_step"
+			   << setw(15) << "wall"
+			   << setw(15) << "wall_p"
+			   << setw(15) << "wall_halo"
+			   << setw(10) << "node_imb"
+			   << setw(10) << "ele_imb"
+			   << setw(10) << "speedup"
+			   << setw(10) << "eff" << endl;
+		fl << setw(6) << md.nrank
+		   << setw(10) << msh.nnode()
+		   << setw(10) << md.nStep
+		   << setw(15) << wall[0]
+		   << setw(15) << wall[1]
+		   << setw(15) << wall[2]
+		   << setw(10) << imb[0]
+		   << setw(10) << imb[1]
+		   << setw(10) << ( wall1 > 0 ? wall1 / wall[0] : 0 )
+		   << setw(10) << ( wall1 > 0 ? wall1 / wall[0] / md.nrank : 0 ) << endl;
+		fl.close();
+
+		cout << "Processes: " << md.nrank << " wall time: " << wall[0]
+			 << " p solve: " << wall[1] << " halo exchange: " << wall[2] << endl
+			 << "Load imbalance (max/mean) nodes: " << imb[0] << " elements: " << imb[1] << endl;
+		if (wall1 > 0)
+			cout << "Speedup to one process: " << wall1 / wall[0]
+				 << " efficiency: " << wall1 / wall[0] / md.nrank << endl;
+
+		FuncEnd();
+	}
+
 	void writeinitial(MData &md, Mesh &msh,const string& adr,
 					  const bool restart, const bool octave){
 		FuncBegin();
@@ -1214,6 +5266,9 @@ namespace driver{
 		case MData::VisualTecplot:
 			writevisual_tecplot(address, md, msh);
 			break;
+		case MData::VisualXdmf:
+			writevisual_xdmf(address, md, msh);
+			break;
 		}
 
 		FuncEnd();
@@ -22,6 +22,10 @@ namespace driver{
 		@ingroup dr_module
 	 */
 	void initialize(int *argc, char **argv[], MData &md);
+	/** @brief read the -df2d_ options from petsc, which must be initialized
+		@ingroup dr_module
+	*/
+	void readoptions(MData &md);
 	/** @brief read the region data 
 		@ingroup dr_module
 	*/
@@ -34,6 +38,10 @@ namespace driver{
 		@ingroup dr_module
 	*/
 	void readmesh(MData &md, Mesh &msh);
+	/** @brief read the mesh files only, for a Simulator to construct
+		@ingroup dr_module
+	*/
+	void readmeshfile(MData &md, Mesh &msh);
 	/** @brief read initial condition 
 		@ingroup dr_module
 	*/
@@ -46,15 +54,43 @@ namespace driver{
 		@ingroup dr_module
 	*/
 	void preparedata (MData &md, Mesh &msh);
+	/** @brief create the vectors and solvers of preparedata, once for a mesh
+		@ingroup dr_module
+	*/
+	void allocdata (MData &md, Mesh &msh);
+	/** @brief set the data found from S at the start of a run, can be called again
+		@ingroup dr_module
+	*/
+	void initdata (MData &md, Mesh &msh);
 	/** @brief march in time 
 		@ingroup dr_module
 	*/
 	void marchintime(MData &md, Mesh &msh);
+	/** @brief march from t to tEnd with the parareal method and write the results
+		@ingroup dr_module
+	*/
+	void parareal(MData &md, Mesh &msh);
+	/** @brief prepare the data, march from t to tEnd and write the results
+		@ingroup dr_module
+	*/
+	void solve(MData &md, Mesh &msh);
+	/** @brief run the ensemble members member0/ ... on the mesh that was read once
+		@ingroup dr_module
+	*/
+	void ensemble(MData &md, Mesh &msh);
+	/** @brief run the jobs put in md.dmnDir until a file named stop appears there
+		@ingroup dr_module
+	*/
+	void daemon(MData &md);
 	/** @brief write the results if the time has come 
 		@ingroup dr_module
 		@param force if force is true the data will be written anyways
 	*/
 	void writeintime(MData &md, Mesh &msh, bool force);
+	/** @brief append the wall times of the run to the strong-scaling table result.scaling
+		@ingroup dr_module
+	*/
+	void writescaling(MData &md, Mesh &msh);
 	
 
 	/** @brief write initial condition and restart file 
@@ -11,6 +11,7 @@
 #include "element_bone.hpp"
 #include "error.hpp"
 #include <sstream>
+#include <algorithm>
 
 /****************************************************************************
  * Element - first level
@@ -40,20 +41,11 @@ inline Element* Element::neww(RegionPorous *reg, Node *nd[], const CellType cell
  * ElementBase - second level
  ****************************************************************************/
 
-/** @cond */
 template<CellType C>
-arma::mat::fixed<Cell<C>::nPoint,Cell<C>::nPoint> ElementBase<C>::matLdCn_;
-template<CellType C>
-arma::vec::fixed<Cell<C>::nPoint> ElementBase<C>::vecLdCn_[nSafe_];
-template<CellType C>
-arma::vec::fixed<Cell<C>::nFace> ElementBase<C>::vecLdFc_[nSafe_];    
-template<CellType C>
-arma::ivec::fixed<Cell<C>::nPoint> ElementBase<C>::ivecLdCn_;
-template<CellType C>
-arma::mat::fixed<2, Cell<C>::nPoint> ElementBase<C>::KD_;              
-template<CellType C>
-arma::rowvec::fixed<Cell<C>::nPoint> ElementBase<C>::V_;             
-/** @endcond */
+inline typename ElementBase<C>::Scratch& ElementBase<C>::scr_(){
+	static thread_local Scratch s;
+	return s;
+}
 
 template<CellType C>
 inline CellType ElementBase<C>::cellType() const{
@@ -79,8 +71,8 @@ inline int ElementBase<C>::nFace() const{
 template<CellType C>
 inline const arma::ivec& ElementBase<C>::idxGlob(){
 	FuncBegin();
-	for (int i = 0 ; i < nNode() ; i++) ivecLdCn_(i) = nd_[i]->idx;
-	return ivecLdCn_;
+	for (int i = 0 ; i < nNode() ; i++) scr_().ivecLdCn_(i) = nd_[i]->idx;
+	return scr_().ivecLdCn_;
 	FuncEnd();
 }
 
@@ -88,8 +80,8 @@ template<CellType C>
 inline const arma::vec& ElementBase<C>::lDatCnDis (const std::vector<double> &dat, const uint i){
 	FuncBegin();
 	fml::chkIdx(i, nSafe_);
-	fml::locFromGlob(dat.size(), dat, nNode(), dd_, vecLdCn_[i]);
-	return vecLdCn_[i];
+	fml::locFromGlob(dat.size(), dat, nNode(), dd_, scr_().vecLdCn_[i]);
+	return scr_().vecLdCn_[i];
 	FuncEnd();
 }
 
@@ -97,8 +89,8 @@ template<CellType C>
 inline const arma::vec& ElementBase<C>::lDatCnCon (const std::vector<double> &dat, const uint i){
 	FuncBegin();
 	fml::chkIdx(i, nSafe_);
-	fml::locFromGlob(dat.size(), dat, nNode(), nd_, vecLdCn_[i]);
-	return vecLdCn_[i];
+	fml::locFromGlob(dat.size(), dat, nNode(), nd_, scr_().vecLdCn_[i]);
+	return scr_().vecLdCn_[i];
 	FuncEnd();
 }
 
@@ -106,8 +98,8 @@ template<CellType C>
 inline const arma::vec& ElementBase<C>::lDatCnCon (const double* dat, const uint i){
 	FuncBegin();
 	fml::chkIdx(i, nSafe_);
-	fml::locFromGlob(-1, dat, nNode(), nd_, vecLdCn_[i]); //no bound checking for arrays
-	return vecLdCn_[i];
+	fml::locFromGlob(-1, dat, nNode(), nd_, scr_().vecLdCn_[i]); //no bound checking for arrays
+	return scr_().vecLdCn_[i];
 	FuncEnd();
 }
 
@@ -116,8 +108,8 @@ inline const arma::vec& ElementBase<C>::lDatUpDis (const std::vector<double> &da
 	FuncBegin();
 	fml::chkIdx(i, nSafe_);
 	for (int j = 0 ; j < nFace() ; j++)
-		vecLdFc_[i](j) = dat.at( dd_[ idx[j] ]->idx );
-	return vecLdFc_[i];
+		scr_().vecLdFc_[i](j) = dat.at( dd_[ idx[j] ]->idx );
+	return scr_().vecLdFc_[i];
 	FuncEnd();
 }
 
@@ -192,25 +184,20 @@ const DuplData* ElementBase<C>::dupl(const int i) const{
 /*****************************************************************************
  * ElementPoly n>=3 - third level
  ****************************************************************************/
-/** @cond */
 template<CellType C>
-arma::rowvec::fixed< Cell<C>::nPoint > ElementPoly<C>::N_;
-template<CellType C>
-arma::mat::fixed <Cell<C>::nPoint, 2> ElementPoly<C>::B_;
-template<CellType C>
-arma::mat::fixed <2, Cell<C>::nPoint> ElementPoly<C>::X_;
-template<CellType C>
-arma::mat::fixed <2, 2> ElementPoly<C>::J_;                      
-/** @endcond */
+inline typename ElementPoly<C>::ScratchPoly& ElementPoly<C>::scrp_(){
+	static thread_local ScratchPoly s;
+	return s;
+}
 
 template < CellType C>
 inline const arma::mat& ElementPoly<C>::matKD(){
 	FuncBegin();
 
 	matJ( Cell<C>::center(0), Cell<C>::center(1) ); // B is found implicitly
-	f::KD_ = f::reg_->k * arma::trans( B_ * arma::inv(J_) );
+	f::scr_().KD_ = f::reg_->k * arma::trans( scrp_().B_ * arma::inv(scrp_().J_) );
 	
-	return f::KD_;	
+	return f::scr_().KD_;	
 	FuncEnd();
 }
 
@@ -218,12 +205,7 @@ inline const arma::mat& ElementPoly<C>::matKD(){
 template < CellType C>
 inline const arma::rowvec& ElementPoly<C>::matVolume(){
 	FuncBegin();
-	
-	for (int i = 0 ; i < f::nNode() ; i++){
-		f::V_(i) =	Cell<C>::rawVol * det ( matJ( Cell<C>::vIp(0,i), Cell<C>::vIp(1,i) ) ) / f::nNode();
-	}
-	
-	return f::V_;	
+	return vol_;
 	FuncEnd();
 }
 
@@ -264,11 +246,11 @@ inline const arma::mat& ElementPoly<C>::lhsP(const std::vector<double> &Lw,
 		f::lDatUpDis(Lw,f::upwetidx_,f::nSafe_ - 1) + f::lDatUpDis(Ln,f::upnonidx_,f::nSafe_ - 2);
 
 	for (int i = 0 ; i < f::nNode() ; i++)
-		f::matLdCn_.row(i) =
+		f::scr_().matLdCn_.row(i) =
 			lloc(i) * H_.row(i) -
 			lloc( Cell<C>::idxPlus1(i) ) * H_.row( Cell<C>::idxPlus1(i) );
 
-	return f::matLdCn_;
+	return f::scr_().matLdCn_;
 	FuncEnd();
 }
 
@@ -283,12 +265,12 @@ inline const arma::vec& ElementPoly<C>::rhsP(const std::vector<double> &Ln,
 	const arma::vec &pcloc = f::lDatCnDis(Pc , f::nSafe_ - 1);
 	
 	for (int j = 0 ; j < f::nNode() ; j++){
-		f::vecLdCn_[i](j) = -arma::as_scalar ( ( lnloc(j) * H_.row(j) -
+		f::scr_().vecLdCn_[i](j) = -arma::as_scalar ( ( lnloc(j) * H_.row(j) -
 												 lnloc(Cell<C>::idxPlus1(j)) * H_.row(Cell<C>::idxPlus1(j) ) ) *
 											   pcloc );	
 	}
 
-	return f::vecLdCn_[i];
+	return f::scr_().vecLdCn_[i];
 	FuncEnd();
 }
 
@@ -302,12 +284,30 @@ inline const arma::vec& ElementPoly<C>::rhsS(const std::vector<double> &Lw,
 	const arma::vec &lwloc = f::lDatUpDis(Lw, f::upwetidx_, f::nSafe_ - 1);
 	const arma::vec &ploc = f::lDatCnCon(P , f::nSafe_ - 1);
 	for (int j = 0 ; j < f::nNode() ; j++)
-		f::vecLdCn_[i](j) = arma::as_scalar (
+		f::scr_().vecLdCn_[i](j) = arma::as_scalar (
 			( lwloc( j )                   * H_.row( j ) -
 			  lwloc( Cell<C>::idxPlus1(j) )* H_.row( Cell<C>::idxPlus1(j) ) ) *
 			ploc );
 
-	return f::vecLdCn_[i];
+	return f::scr_().vecLdCn_[i];
+	FuncEnd();
+}
+
+template < CellType C>
+inline const arma::mat& ElementPoly<C>::jacS(const std::vector<double> &dLw,
+									  const double *P){
+	FuncBegin();
+
+	double q;
+	const arma::vec &ploc = f::lDatCnCon(P , f::nSafe_ - 1);
+	f::scr_().matLdCn_.zeros();
+	for (int j = 0 ; j < f::nNode() ; j++){
+		q = arma::as_scalar( H_.row(j) * ploc ) * dLw.at( f::dd_[ f::upwetidx_[j] ]->idx );
+		f::scr_().matLdCn_( j , f::upwetidx_[j] ) += q;
+		f::scr_().matLdCn_( Cell<C>::idxMin1(j) , f::upwetidx_[j] ) -= q;
+	}
+
+	return f::scr_().matLdCn_;
 	FuncEnd();
 }
 
@@ -315,8 +315,8 @@ template < CellType C>
 inline const arma::rowvec& ElementPoly<C>::matN(const double z, const double e){
 	FuncBegin();
 	
-	Cell<C>::N(z,e,N_);
-	return N_;
+	Cell<C>::N(z,e,scrp_().N_);
+	return scrp_().N_;
 		
 	FuncEnd();
 }
@@ -325,8 +325,8 @@ template < CellType C>
 inline const arma::mat& ElementPoly<C>::matB(const double z, const double e){
 	FuncBegin();
 
-	Cell<C>::B(z,e,B_);
-	return B_;
+	Cell<C>::B(z,e,scrp_().B_);
+	return scrp_().B_;
 	
 	FuncEnd();
 }
@@ -336,11 +336,11 @@ inline const arma::mat& ElementPoly<C>::matX(){
 	FuncBegin();
 
 	for (int i = 0 ; i < f::nNode() ; i++) {
-		X_(0,i) = f::nd_[i]->x;
-		X_(1,i) = f::nd_[i]->y;
+		scrp_().X_(0,i) = f::nd_[i]->x;
+		scrp_().X_(1,i) = f::nd_[i]->y;
 	}
 
-	return X_;
+	return scrp_().X_;
 	FuncEnd();
 }
 
@@ -348,9 +348,9 @@ template < CellType C>
 inline const arma::mat& ElementPoly<C>::matJ(const double z, const double e){
 	FuncBegin();
 
-	J_ = matX() * matB(z,e);
+	scrp_().J_ = matX() * matB(z,e);
 	
-	return J_;
+	return scrp_().J_;
 	FuncEnd();
 }
 
@@ -380,12 +380,33 @@ inline void ElementPoly<C>::constructGeoParams(){
 
 	for (int i = 0 ; i < f::nNode() ; i++){
 		matJ( Cell<C>::fIp(0,i) , Cell<C>::fIp(1,i) ); //mat b is found automatically
-		H_.row(i) = arma::trans( B_ * arma::inv(J_) * f::reg_->k.t() * fml::Rot * J_ * Cell<C>::del.col(i) );
+		H_.row(i) = arma::trans( scrp_().B_ * arma::inv(scrp_().J_) * f::reg_->k.t() * fml::Rot * scrp_().J_ * Cell<C>::del.col(i) );
 	}
+	for (int i = 0 ; i < f::nNode() ; i++)
+		vol_(i) = Cell<C>::rawVol * det ( matJ( Cell<C>::vIp(0,i), Cell<C>::vIp(1,i) ) ) / f::nNode();
 	
 	FuncEnd();
 }
 
+template < CellType C>
+inline int ElementPoly<C>::nGeo() const{
+	return Cell<C>::nPoint * (Cell<C>::nPoint + 1);
+}
+
+template < CellType C>
+inline void ElementPoly<C>::geoParams(double *v) const{
+	const int n = Cell<C>::nPoint;
+	std::copy(H_.memptr(), H_.memptr() + n * n, v);
+	std::copy(vol_.memptr(), vol_.memptr() + n, v + n * n);
+}
+
+template < CellType C>
+inline void ElementPoly<C>::setGeoParams(const double *v){
+	const int n = Cell<C>::nPoint;
+	std::copy(v, v + n * n, H_.memptr());
+	std::copy(v + n * n, v + n * (n + 1), vol_.memptr());
+}
+
 template < CellType C>
 inline std::string ElementPoly<C>::name(const std::vector<double> *S,
 										const double *P, const std::vector<double> *Pc,
@@ -412,19 +433,19 @@ inline const arma::mat& elefrac::matKD(){
 	l = fml::lineLength(nd_[0]->x, nd_[0]->y, nd_[1]->x, nd_[1]->y);
 	dx = nd_[1]->x - nd_[0]->x;
 	dy = nd_[1]->y - nd_[0]->y;
-	KD_(0,0) = - ( KD_(0,1) = reg_->k * dx / l / l );
-	KD_(1,0) = - ( KD_(1,1) = reg_->k * dy / l / l );
+	scr_().KD_(0,0) = - ( scr_().KD_(0,1) = reg_->k * dx / l / l );
+	scr_().KD_(1,0) = - ( scr_().KD_(1,1) = reg_->k * dy / l / l );
 	
-	return KD_;
+	return scr_().KD_;
 	FuncEnd();
 }
 
 inline const arma::rowvec& elefrac::matVolume(){
 	FuncBegin();
 
-	V_(0) = V_(1) = .5 * fml::lineLength(nd_[0]->x, nd_[0]->y, nd_[1]->x, nd_[1]->y) * reg_->e;
+	scr_().V_(0) = scr_().V_(1) = vol_;
 	
-	return V_;
+	return scr_().V_;
 	FuncEnd();
 }
 
@@ -447,11 +468,11 @@ inline const arma::mat& elefrac::lhsP(const std::vector<double> &Lw,
 	FuncBegin();
 
 	arma::vec::fixed<cellin::nFace> lloc = lDatUpDis(Lw, upwetidx_,nSafe_-1) + lDatUpDis(Ln, upnonidx_, nSafe_- 2);
-	matLdCn_(0,0) = matLdCn_(1,1) =
-		- ( matLdCn_(0,1) = matLdCn_(1,0) = lloc(0) * KE_L_ );
+	scr_().matLdCn_(0,0) = scr_().matLdCn_(1,1) =
+		- ( scr_().matLdCn_(0,1) = scr_().matLdCn_(1,0) = lloc(0) * KE_L_ );
 	
 	
-	return matLdCn_;
+	return scr_().matLdCn_;
 	FuncEnd();
 }
 
@@ -463,9 +484,9 @@ inline const arma::vec& elefrac::rhsP(const std::vector<double> &Ln,
 	fml::chkIdx (i , nSafe_ - 1 );
 	const arma::vec &pcloc = lDatCnDis(Pc, nSafe_-1); 
 	const arma::vec &lnloc = lDatUpDis(Ln, upnonidx_, nSafe_-1); 
-	vecLdCn_[i](0) = -( vecLdCn_[i](1) = lnloc(0) * KE_L_ * ( pcloc(1) - pcloc(0) ) );
+	scr_().vecLdCn_[i](0) = -( scr_().vecLdCn_[i](1) = lnloc(0) * KE_L_ * ( pcloc(1) - pcloc(0) ) );
 
-	return vecLdCn_[i];
+	return scr_().vecLdCn_[i];
 	FuncEnd();
 }
 
@@ -477,17 +498,32 @@ inline const arma::vec& elefrac::rhsS(const std::vector<double> &Lw,
 	fml::chkIdx (i , nSafe_ - 1 );
 	const arma::vec &ploc = lDatCnCon(P, nSafe_-1); 
 	const arma::vec &lwloc = lDatUpDis(Lw, upwetidx_, nSafe_-1); 
-	vecLdCn_[i](0) = -( vecLdCn_[i](1) = lwloc(0) * KE_L_ * ( ploc(0) - ploc(1) ) );
+	scr_().vecLdCn_[i](0) = -( scr_().vecLdCn_[i](1) = lwloc(0) * KE_L_ * ( ploc(0) - ploc(1) ) );
+	
+	return scr_().vecLdCn_[i];
+	FuncEnd();
+}
+
+inline const arma::mat& elefrac::jacS(const std::vector<double> &dLw,
+							   const double *P){
+	FuncBegin();
+
+	const arma::vec &ploc = lDatCnCon(P, nSafe_-1); 
+	scr_().matLdCn_.zeros();
+	scr_().matLdCn_(0, upwetidx_[0]) = -( scr_().matLdCn_(1, upwetidx_[0]) =
+								   dLw.at(dd_[upwetidx_[0]]->idx) * KE_L_ * ( ploc(0) - ploc(1) ) );
 	
-	return vecLdCn_[i];
+	return scr_().matLdCn_;
 	FuncEnd();
 }
 
-inline elefrac::ElementPoly(RegionPorous* reg, Node *nd[]):ElementBase<CellLine>(reg,nd), KE_L_(0) {}
+inline elefrac::ElementPoly(RegionPorous* reg, Node *nd[]):ElementBase<CellLine>(reg,nd), KE_L_(0), vol_(0) {}
 
 inline void elefrac::constructGeoParams(){
 	FuncBegin();
-	KE_L_ =  reg_->k * reg_->e / fml::lineLength(nd_[0]->x, nd_[0]->y, nd_[1]->x, nd_[1]->y) ;
+	const double l = fml::lineLength(nd_[0]->x, nd_[0]->y, nd_[1]->x, nd_[1]->y);
+	KE_L_ =  reg_->k * reg_->e / l ;
+	vol_ = .5 * l * reg_->e;
 	FuncEnd();
 }
 
@@ -62,9 +62,9 @@ public:
 		@param Pc the vector of cappilary pressure
 	 */
 	virtual void fndUpN(double const *P, const std::vector<double> &Pc) = 0;
-	/** @brief finds the volume of sub-control volumes in the element.
+	/** @brief the volume of sub-control volumes in the element.
 		
-		@returns a rowvec containing the volume of each sub-CV
+		@returns a rowvec containing the volume of each sub-CV, as constructGeoParams found it
 	*/
 	virtual const arma::rowvec& matVolume() = 0; 
 	/** @brief find the D matrix.
@@ -159,6 +159,17 @@ public:
 	    refer to the note in lDatCnDis.
 	 */
 	virtual const arma::vec& rhsS(const std::vector<double> &Lw, const double *P, const uint i) = 0;
+	/** @brief local jacobian of rhsS with respect to the master saturations.
+		
+		@param dLw vector containing the derivative of each wetting phase mobility
+		with respect to the master saturation of its node.
+		@param P pointer to pressure data
+
+		@note
+		the upwind nodes found by the last fndUpW are used. refer to the note in
+		lDatCnDis.
+	 */
+	virtual const arma::mat& jacS(const std::vector<double> &dLw, const double *P) = 0;
 	/** @brief creates dupldata list for nodes and link it to element */
 	virtual void constructDuplData() = 0;
 	/** @brief checks the orientation of the bvertices if the element has any.
@@ -167,6 +178,12 @@ public:
 	virtual void constructBVertices(int *res) = 0;
 	/** @brief creates other internal data. like H matrices for polygons and ke_l for lines */
 	virtual void constructGeoParams() = 0;
+	/** @brief number of doubles geoParams writes */
+	virtual int nGeo() const = 0;
+	/** @brief writes what constructGeoParams found to v, nGeo doubles */
+	virtual void geoParams(double *v) const = 0;
+	/** @brief sets what constructGeoParams would find from v, written by geoParams */
+	virtual void setGeoParams(const double *v) = 0;
 	/** @brief destructor for no compiler-warning.
 	 */
 	virtual ~Element() {}
@@ -208,12 +225,21 @@ protected:
 		upnonidx_[ Cell<C>::nFace ];       /**< @brief upwind index for non-wetting phase */
 	
 	const static uint nSafe_ = 5;            /**< @brief number of internal local data vectors */
-	static arma::mat::fixed<Cell<C>::nPoint,Cell<C>::nPoint> matLdCn_;   /**< @brief corner node local matrix */
-	static arma::vec::fixed<Cell<C>::nPoint> vecLdCn_[nSafe_];   /**< @brief corner node local data double */ 
-	static arma::vec::fixed<Cell<C>::nFace> vecLdFc_[nSafe_];    /**< @brief face local data double */
-	static arma::ivec::fixed<Cell<C>::nPoint> ivecLdCn_;         /**< @brief corner node local data int */
-	static arma::mat::fixed<2, Cell<C>::nPoint> KD_;              /**< @brief derivative matrix: KD*P = K\\nabla\\cdot P */
-	static arma::rowvec::fixed<Cell<C>::nPoint> V_;              /**< @brief volume row vector */
+	/** @brief local data that the element functions fill and return a reference to.
+
+		There is one set per thread, so that partitions of the mesh can be assembled
+		at the same time.
+	 */
+	struct Scratch{
+		arma::mat::fixed<Cell<C>::nPoint,Cell<C>::nPoint> matLdCn_;   /**< @brief corner node local matrix */
+		arma::vec::fixed<Cell<C>::nPoint> vecLdCn_[nSafe_];   /**< @brief corner node local data double */ 
+		arma::vec::fixed<Cell<C>::nFace> vecLdFc_[nSafe_];    /**< @brief face local data double */
+		arma::ivec::fixed<Cell<C>::nPoint> ivecLdCn_;         /**< @brief corner node local data int */
+		arma::mat::fixed<2, Cell<C>::nPoint> KD_;              /**< @brief derivative matrix: KD*P = K\\nabla\\cdot P */
+		arma::rowvec::fixed<Cell<C>::nPoint> V_;              /**< @brief volume row vector */
+	};
+	/** @brief scratch data of the calling thread */
+	static Scratch& scr_();
 	/** @brief initializes all data to zero and null and sets region and nodes	 */
 	ElementBase(RegionPorous* reg, Node *nd[]);
 	/** @brief string name for that part of element which is related to ElementBase  */
@@ -258,34 +284,40 @@ protected:
 		This member is not static and is saved for each element.
 	 */
 	arma::mat::fixed< Cell<C>::nPoint , Cell<C>::nPoint > H_; /**< @brief H  matrix */
-	/** @brief N matrix same as the \\psi matrix in the thesis.
+	arma::rowvec::fixed< Cell<C>::nPoint > vol_;              /**< @brief volume of each sub-CV */
+	/** @brief local matrices of the reference element, one set per thread. */
+	struct ScratchPoly{
+		/** @brief N matrix same as the \\psi matrix in the thesis.
 
-		This static variable saves some memmory for the N matrix. Whenever
-		an element's matN() function is called it will fill this static
-		variable and return a reference to it. 
-	 */
-	static arma::rowvec::fixed< Cell<C>::nPoint > N_;        
-	/** @brief B matrix same as the \\frac{d\\psi}{d \\xi} matrix in the thesis.
+			This variable saves some memmory for the N matrix. Whenever
+			an element's matN() function is called it will fill this
+			variable and return a reference to it. 
+		 */
+		arma::rowvec::fixed< Cell<C>::nPoint > N_;        
+		/** @brief B matrix same as the \\frac{d\\psi}{d \\xi} matrix in the thesis.
 
-		This static variable saves some memmory for the B matrix. Whenever
-		an element's matB() function is called it will fill this static
-		variable and return a reference to it. 
-	 */
-	static arma::mat::fixed <Cell<C>::nPoint, 2> B_;         
-	/** @brief X matrix same as the thesis.
+			This variable saves some memmory for the B matrix. Whenever
+			an element's matB() function is called it will fill this
+			variable and return a reference to it. 
+		 */
+		arma::mat::fixed <Cell<C>::nPoint, 2> B_;         
+		/** @brief X matrix same as the thesis.
 
-		This static variable saves some memmory for the X matrix. Whenever
-		an element's matX() function is called it will fill this static
-		variable and return a reference to it. 
-	 */
-	static arma::mat::fixed <2, Cell<C>::nPoint> X_;         
-	/** @brief J matrix same as the thesis.
+			This variable saves some memmory for the X matrix. Whenever
+			an element's matX() function is called it will fill this
+			variable and return a reference to it. 
+		 */
+		arma::mat::fixed <2, Cell<C>::nPoint> X_;         
+		/** @brief J matrix same as the thesis.
 
-		This static variable saves some memmory for the J matrix. Whenever
-		an element's matJ() function is called it will fill this static
-		variable and return a reference to it. 
-	 */
-	static arma::mat::fixed <2, 2> J_;                      
+			This variable saves some memmory for the J matrix. Whenever
+			an element's matJ() function is called it will fill this
+			variable and return a reference to it. 
+		 */
+		arma::mat::fixed <2, 2> J_;                      
+	};
+	/** @brief scratch matrices of the calling thread */
+	static ScratchPoly& scrp_();
  
 public:
 	void fndUpW(double const *P);
@@ -296,6 +328,7 @@ public:
 	const arma::mat& lhsP(const std::vector<double> &Lw, const std::vector<double> &Ln);
 	const arma::vec& rhsP(const std::vector<double> &Ln, const std::vector<double> &Pc, const uint i);
 	const arma::vec& rhsS(const std::vector<double> &Lw, const double *P, const uint i);
+	const arma::mat& jacS(const std::vector<double> &dLw, const double *P);
 	/** @brief Shape function rowvec.
 	 * @note modifies no one
 	 */
@@ -317,6 +350,9 @@ public:
 	ElementPoly(RegionPorous* reg, Node *nd[]);
 	void constructBVertices(int *res);
 	void constructGeoParams();
+	int nGeo() const;
+	void geoParams(double *v) const;
+	void setGeoParams(const double *v);
 	std::string name(const std::vector<double> *S = NULL,
 					 const double *P = NULL, const std::vector<double> *Pc = NULL,
 					 const std::vector<double> *Lw = NULL, const std::vector<double> *Ln = NULL);
@@ -338,6 +374,7 @@ template<>
 class ElementPoly<CellLine>: public ElementBase<CellLine>{
 protected:
     double KE_L_;             /**< @brief k*e/l a paremeter used to create local matrices */
+	double vol_;              /**< @brief volume of each sub-CV, l*e/2 */
  
 public:
 	void fndUpW(double const *P);
@@ -348,6 +385,7 @@ public:
 	const arma::mat& lhsP(const std::vector<double> &Lw, const std::vector<double> &Ln);
 	const arma::vec& rhsP(const std::vector<double> &Ln, const std::vector<double> &Pc, const uint i);
 	const arma::vec& rhsS(const std::vector<double> &Lw, const double *P, const uint i);
+	const arma::mat& jacS(const std::vector<double> &dLw, const double *P);
 	
 	/** @brief initializes to null and zero and sets nodes and reg.
 	 */
@@ -355,6 +393,9 @@ public:
 	
 	void constructBVertices(int *res) {}
 	void constructGeoParams();
+	int nGeo() const { return 2; }
+	void geoParams(double *v) const { v[0] = KE_L_; v[1] = vol_; }
+	void setGeoParams(const double *v) { KE_L_ = v[0]; vol_ = v[1]; }
 
 	std::string name(const std::vector<double> *S = NULL,
 					 const double *P = NULL, const std::vector<double> *Pc = NULL,
@@ -6,15 +6,27 @@
 
 #include "error.hpp"
 
-int Error::code = 1 ;
-int Error::line = -2;
-std::string Error::func = "";
-std::string Error::file = "";
-bool Error::ini = false;
-std::ostringstream Error::mess;
+thread_local int Error::code = 1 ;
+thread_local int Error::line = -2;
+thread_local std::string Error::func = "";
+thread_local std::string Error::file = "";
+thread_local bool Error::ini = false;
+thread_local std::ostringstream Error::mess;
+thread_local bool Error::worker = false;
+thread_local std::string Error::trace = "";
 
 void Error::sendtopetsc()
 {
+	if (worker){
+		if (trace.empty()){
+			std::ostringstream ss;
+			ss << file << ":" << line << " " << func << ": " << mess.str();
+			if (!ini) ss << "petsc error " << code;
+			trace = ss.str();
+		}
+		mess.str("");
+		return;
+	}
 	PetscError(PETSC_COMM_SELF,
 						 line,
 						 func.c_str(),
@@ -15,27 +15,38 @@
 #include <petscsys.h>
 
 /** @brief Data and functions for an error.
+ *
+ * The fields are per thread, so an error on a worker thread does not
+ * touch the one of the main thread. Workers only keep their first error in
+ * trace, for the thread that waits on them to raise it.
  *  @ingroup dr_module
  */
 class Error
 {
 public:
 	/** @brief Petsc error code . */
-  static int code ;
+  static thread_local int code ;
 	/** @brief The line at which the error has occured.
 	 *
 	 * due to the nature of try catch only works for the first time.
 	 */
-	static int line ;
+	static thread_local int line ;
 	/** @brief The func in which the error has occured. */
-	static std::string func;
+	static thread_local std::string func;
 	/** @brief The file at which error has occured. */
-	static std::string file;
+	static thread_local std::string file;
 	/** @brief Show if we are at the beginning of the error propagation.  */
-	static bool ini;
+	static thread_local bool ini;
 	/** @brief Description of why the error has occured.  */
-	static std::ostringstream mess;
-	/** @brief Send the error to Petsc so it can be printed.  */
+	static thread_local std::ostringstream mess;
+	/** @brief True on a worker thread, which must not call Petsc. */
+	static thread_local bool worker;
+	/** @brief The first error of a worker thread: file, line, func and mess. */
+	static thread_local std::string trace;
+	/** @brief Send the error to Petsc so it can be printed.
+	 *
+	 * On a worker it is kept in trace instead.
+	 */
 	static void sendtopetsc();
 	/** @brief Print the data on screen for debugging. */
 	static void print();	    
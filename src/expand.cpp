@@ -0,0 +1,70 @@
+/** @file expand.cpp
+	.cpp file of df2d-expand, which expands the compressed visual fields.
+
+	Usage: df2d-expand <file.dfz> ...
+
+	With -df2d_output_lossy and visualtype xdmf every output writes its fields
+	to result.n.dfz. This writes result.n.bin next to it, the file result.xmf
+	points to, so the outputs can be opened with Paraview or VisIt. The size
+	of each file, the compression ratio and the error bound of each field are
+	printed.
+*/
+
+#include "lossy.hpp"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstring>
+#include <sys/stat.h>
+
+/** The main function. */
+int main(int argc, char *argv[]){
+	std::vector<lossy::FieldHead> h;
+	std::vector< std::vector<float> > f;
+	struct stat st;
+	double in = 0, out = 0;
+	int nfail = 0;
+
+	if (argc < 2){
+		std::cout << "Usage: " << argv[0] << " <file.dfz> ..." << std::endl;
+		return 1;
+	}
+	for (int i = 1 ; i < argc ; i++){
+		std::string adr(argv[i]), bin;
+		if ( (adr.size() > 4) && (adr.compare(adr.size() - 4, 4, ".dfz") == 0) )
+			bin = adr.substr(0, adr.size() - 4) + ".bin";
+		else
+			bin = adr + ".bin";
+		if ( (stat(adr.c_str(), &st) != 0) || !lossy::read(adr, h, f) ){
+			std::cout << adr << " could not be read, or is damaged." << std::endl;
+			nfail++;
+			continue;
+		}
+
+		//the fields one after the other, as the xdmf visual type writes them
+		std::ofstream fl(bin.c_str(), std::ios::binary | std::ios::trunc);
+		double n = 0;
+		for (size_t k = 0 ; k < f.size() ; k++){
+			if (!f[k].empty()) fl.write((const char*)&f[k][0], f[k].size() * sizeof(float));
+			n += f[k].size() * sizeof(float);
+		}
+		fl.close();
+		if (fl.fail()){
+			std::cout << bin << " could not be written." << std::endl;
+			nfail++;
+			continue;
+		}
+		in += st.st_size;
+		out += n;
+
+		std::cout << adr << ": " << st.st_size << " -> " << (long)n << " bytes, ratio "
+				  << std::fixed << std::setprecision(2) << n / std::max((double)st.st_size, 1.) << ", bounds";
+		for (size_t k = 0 ; k < h.size() ; k++)
+			std::cout << " " << std::scientific << std::setprecision(1) << h[k].eb;
+		std::cout << std::endl;
+	}
+	if (argc > 2)
+		std::cout << "total: " << (long)in << " -> " << (long)out << " bytes, ratio "
+				  << std::fixed << std::setprecision(2) << out / std::max(in, 1.) << std::endl;
+	return ( nfail ? 1 : 0 );
+}
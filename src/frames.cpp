@@ -0,0 +1,180 @@
+/** @file frames.cpp
+	.cpp file of df2d-frames, which rebuilds the outputs of a series.
+
+	Usage: df2d-frames <base> [vtk|bin|restart] [n ...]
+
+	With -df2d_output_delta and visualtype xdmf the outputs are kept as a
+	series of keyframes and deltas in <base>.dts, e.g. result/result.dts.
+	Without a command the outputs in it are listed. Otherwise every output n
+	given, or all of them, is rebuilt from the keyframe before it and written
+	as
+	\li vtk: <base>.n.vtk, the usual vtk file, with the mesh of <base>.mesh.bin
+	\li bin: <base>.n.bin, the fields <base>.xmf points to
+	\li restart: restart.n in the current folder, as the run writes it
+*/
+
+#include "series.hpp"
+#include "visit_writer.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+
+/** @brief the mesh of the visual files, as vtk takes it */
+struct VtkMesh{
+	std::vector<float> pts, reg, bnd;
+	std::vector<int> cells, conn;
+};
+
+/** @brief reads <base>.mesh.bin and turns its xdmf mixed topology into vtk cells */
+static void read_mesh(const std::string &base, const Series &s, VtkMesh &m){
+	FuncBegin();
+
+	std::ifstream fl((base + ".mesh.bin").c_str(), std::ios::binary);
+	std::vector<int> mix(s.nmix);
+
+	m.pts.resize(3 * s.npts);
+	m.reg.resize(s.nele);
+	m.bnd.resize(s.npts);
+	fl.read((char*)m.pts.data(), m.pts.size() * sizeof(float));
+	fl.read((char*)mix.data(), mix.size() * sizeof(int));
+	fl.read((char*)m.reg.data(), m.reg.size() * sizeof(float));
+	fl.read((char*)m.bnd.data(), m.bnd.size() * sizeof(float));
+	if (!fl.good()){
+		Error::mess << base << ".mesh.bin could not be read, or is not the mesh of " << s.dts();
+		ERRSET();
+	}
+	for (int i = 0 ; i < s.nmix ; ){
+		int np;
+		switch (mix[i++]){
+		case 2: m.cells.push_back(VISIT_LINE); np = ( i < s.nmix ? mix[i++] : 0 ); break;
+		case 4: m.cells.push_back(VISIT_TRIANGLE); np = 3; break;
+		case 5: m.cells.push_back(VISIT_QUAD); np = 4; break;
+		default: np = -1;
+		}
+		if ( (np < 0) || (i + np > s.nmix) ){
+			Error::mess << base << ".mesh.bin has an unknown cell";
+			ERRSET();
+		}
+		m.conn.insert(m.conn.end(), mix.begin() + i, mix.begin() + i + np);
+		i += np;
+	}
+
+	FuncEnd();
+}
+
+/** @brief writes frame i of s in the format cmd */
+static void write_frame(const std::string &base, Series &s, const int i, const std::string &cmd,
+						VtkMesh &m){
+	FuncBegin();
+
+	std::vector< std::vector<char> > f;
+	std::stringstream adr;
+
+	s.read(i, f);
+	if (cmd == "restart"){
+		//S by node, as driver::writeinitial writes it
+		for (size_t k = 0 ; k < s.fld.size() ; k++){
+			if (s.fld[k].name != "restart") continue;
+			const double *v = (const double*)f[k].data();
+			adr << "restart." << s.frm[i].nFile;
+			std::ofstream fl(adr.str().c_str());
+			fl << std::setprecision(12);
+			fl << "#Restart file @ time = " << s.frm[i].t << std::endl;
+			fl << "%initialcondition" << std::endl;
+			fl << "%mod n" << std::endl;
+			for (int j = 0 ; j < s.fld[k].n ; j++) fl << v[j] << " " << std::endl;
+			fl.close();
+			if (fl.fail()){
+				Error::mess << adr.str() << " could not be written.";
+				ERRSET();
+			}
+		}
+		if (adr.str().empty()) adr << "no restart file, outputfields does not list restart";
+	}
+	else if (cmd == "bin"){
+		//the fields one after the other, as the xdmf visual type writes them
+		adr << base << "." << s.frm[i].nFile << ".bin";
+		std::ofstream fl(adr.str().c_str(), std::ios::binary | std::ios::trunc);
+		for (size_t k = 0 ; k < s.fld.size() ; k++)
+			if (s.fld[k].name != "restart") fl.write(f[k].data(), f[k].size());
+		fl.close();
+		if (fl.fail()){
+			Error::mess << adr.str() << " could not be written.";
+			ERRSET();
+		}
+	}
+	else{
+		std::vector<float*> vars;
+		std::vector<const char*> names;
+		std::vector<int> dim, cent;
+		if (m.pts.empty()) read_mesh(base, s, m);
+		vars.push_back(m.reg.data()); names.push_back("porous_region_no"); dim.push_back(1); cent.push_back(0);
+		vars.push_back(m.bnd.data()); names.push_back("bnd_region_no"); dim.push_back(1); cent.push_back(1);
+		for (size_t k = 0 ; k < s.fld.size() ; k++){
+			if ( (s.fld[k].name == "restart") || (s.fld[k].esize != sizeof(float)) ) continue;
+			vars.push_back((float*)f[k].data());
+			names.push_back(s.fld[k].name.c_str());
+			dim.push_back(s.fld[k].dim);
+			cent.push_back(s.fld[k].nodal);
+		}
+		adr << base << "." << s.frm[i].nFile << ".vtk";
+		write_unstructured_mesh(adr.str().c_str(), 1, s.npts, m.pts.data(),
+								m.cells.size(), m.cells.data(), m.conn.data(),
+								vars.size(), dim.data(), cent.data(), names.data(), vars.data());
+	}
+	std::cout << "output " << s.frm[i].nFile << ( adr.str().empty() ? "" : ": " ) << adr.str() << std::endl;
+
+	FuncEnd();
+}
+
+/** The main function. */
+int main(int argc, char *argv[]){
+	FuncBegin();
+
+	Series s;
+	VtkMesh m;
+
+	if ( (argc < 2) || ( (argc > 2) && strcmp(argv[2], "vtk") && strcmp(argv[2], "bin") &&
+						 strcmp(argv[2], "restart") ) ){
+		std::cout << "Usage: " << argv[0] << " <base> [vtk|bin|restart] [n ...]" << std::endl;
+		return 1;
+	}
+	const std::string base = argv[1];
+	if (!s.open(base)){
+		std::cout << s.dts() << " could not be openned." << std::endl;
+		return 1;
+	}
+
+	//list the outputs
+	if (argc == 2){
+		long nkey = 0, size = 0;
+		std::cout << std::setw(8) << "output" << std::setw(16) << "t" << std::setw(6) << "key"
+				  << std::setw(14) << "bytes" << std::endl;
+		for (size_t i = 0 ; i < s.frm.size() ; i++){
+			std::cout << std::setw(8) << s.frm[i].nFile << std::setw(16) << s.frm[i].t
+					  << std::setw(6) << ( s.frm[i].key ? "*" : "" ) << std::setw(14) << s.frm[i].size << std::endl;
+			nkey += s.frm[i].key;
+			size += s.frm[i].size;
+		}
+		std::cout << s.frm.size() << " outputs, " << nkey << " keyframes, " << size << " bytes" << std::endl;
+		return 0;
+	}
+
+	//rebuild the outputs asked for
+	if (argc == 3)
+		for (size_t i = 0 ; i < s.frm.size() ; i++) write_frame(base, s, i, argv[2], m);
+	for (int a = 3 ; a < argc ; a++){
+		const int i = s.find(atoi(argv[a]));
+		if (i < 0){
+			std::cout << "output " << argv[a] << " is not in " << s.dts() << std::endl;
+			continue;
+		}
+		write_frame(base, s, i, argv[2], m);
+	}
+	return 0;
+
+	FuncEnd();
+}
@@ -37,6 +37,9 @@ bool JFuncFirooz::compareRegion(RegionPorous const *r1, RegionPorous const *r2)
 std::string JFuncFirooz::name() const{
 	return "FiroozCappilaryCurve";
 }
+std::vector<double> JFuncFirooz::params() const{
+	return std::vector<double>();
+}
 
 bool JFuncZero::compareRegion(RegionPorous const *r1, RegionPorous const *r2) const {
 	return (r1->ID < r2->ID);
@@ -44,6 +47,9 @@ bool JFuncZero::compareRegion(RegionPorous const *r1, RegionPorous const *r2) co
 std::string JFuncZero::name() const{
 	return "JFuncZero";
 }
+std::vector<double> JFuncZero::params() const{
+	return std::vector<double>();
+}
 
 bool JFuncLinear::compareRegion(RegionPorous const *r1, RegionPorous const *r2) const {
 	return (r1->pd > r2->pd);
@@ -51,6 +57,9 @@ bool JFuncLinear::compareRegion(RegionPorous const *r1, RegionPorous const *r2)
 std::string JFuncLinear::name() const{
 	return "JFuncLinear";
 }
+std::vector<double> JFuncLinear::params() const{
+	return std::vector<double>();
+}
 
 JFuncVang::JFuncVang(const double m_,const double e_):m(m_),e(e_){
 	j0 = j(e);
@@ -65,6 +74,9 @@ std::string JFuncVang::name() const{
 	   << " j0 = " << j0 ;
 	return ss.str();
 }
+std::vector<double> JFuncVang::params() const{
+	return std::vector<double>{m, e};
+}
 
 JFuncBrooks::JFuncBrooks(const double lambda_):lambda(lambda_){
 }
@@ -76,6 +88,9 @@ std::string JFuncBrooks::name() const{
 	ss << "JFuncBrooks: lambda = " << lambda;
 	return ss.str();
 }
+std::vector<double> JFuncBrooks::params() const{
+	return std::vector<double>{lambda};
+}
 
 
 
@@ -90,6 +105,9 @@ std::string KFuncFirooz::name() const{
 	   << " kn0: " << kn0_;
 	return ss.str();
 }
+std::vector<double> KFuncFirooz::params() const{
+	return std::vector<double>{vw_, vn_, kw0_, kn0_};
+}
 
 KFuncFirooz::KFuncFirooz(const double vw, const double vn,
 						 const double kw0, const double kn0):vw_(vw),vn_(vn),kw0_(kw0),kn0_(kn0){
@@ -102,6 +120,9 @@ std::string KFuncVang::name() const{
 	   << " kn0: " << kn0_;
 	return ss.str();
 }
+std::vector<double> KFuncVang::params() const{
+	return std::vector<double>{m_, kw0_, kn0_};
+}
 
 KFuncVang::KFuncVang(const double m, const double kw0, const double kn0):m_(m),kw0_(kw0),kn0_(kn0){
 }
@@ -113,6 +134,9 @@ std::string KFuncBrooks::name() const{
 	   << " kn0: " << kn0_;
 	return ss.str();
 }
+std::vector<double> KFuncBrooks::params() const{
+	return std::vector<double>{lambda_, kw0_, kn0_};
+}
 
 KFuncBrooks::KFuncBrooks(const double lambda, const double kw0, const double kn0):lambda_(lambda),kw0_(kw0),kn0_(kn0){
 }
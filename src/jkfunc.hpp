@@ -12,6 +12,7 @@
 #include <cmath>
 #include <string>
 #include <sstream>
+#include <vector>
 
 // The file region.hpp is included in the .cpp file to prevent mutual including
 // of header files. So these lines have to be added here.
@@ -97,6 +98,9 @@ public:
 	/** @brief returns description of the curve as readable string.
 	 */
 	virtual std::string name() const = 0;
+	/** @brief returns the parameters of the curve, as they are.
+	 */
+	virtual std::vector<double> params() const = 0;
 	/** @brief destructor for removing warning.
 	 */
 	virtual ~JFunc() {};
@@ -126,6 +130,7 @@ public:
 		return pow(s , p1/p2);
 	}
 	std::string name() const;
+	std::vector<double> params() const;
 };
 
 /** @brief Zero cappilary pressure.
@@ -146,6 +151,7 @@ public:
 		return s;
 	}
 	std::string name() const;
+	std::vector<double> params() const;
 };
 
 /** @brief linear cappilary curve.
@@ -166,6 +172,7 @@ public:
 		return (s < 1 - p2/p1 ? 0 : 1 - p1/p2*(1-s) );
 	}
 	std::string name() const;
+	std::vector<double> params() const;
 };
 
 /** @ingroup edat_module
@@ -225,6 +232,7 @@ public:
 		return ( s < sl ? 0 : sminus(fmax(0.001,fmin(s,.999)),r) ); 
 	}
 	std::string name() const;
+	std::vector<double> params() const;
 };
 
 /** @ingroup edat_module
@@ -254,6 +262,7 @@ public:
 		return ( s > sr ? 1 : pow(r,-lambda)*s ); 
 	}
 	std::string name() const;
+	std::vector<double> params() const;
 };
 
 /*****************************************************************************
@@ -276,9 +285,20 @@ public:
 	 * @param s saturation
 	 */
 	virtual  double nw(const double s) const = 0;
+	/** @brief returns d k_rw / ds.
+	 * @param s saturation
+	 */
+	virtual  double dw(const double s) const = 0;
+	/** @brief returns d k_rnw / ds.
+	 * @param s saturation
+	 */
+	virtual  double dnw(const double s) const = 0;
 	/** @brief returns the name of the model.
 	 */
 	virtual std::string name() const = 0;
+	/** @brief returns the parameters of the model, as they are.
+	 */
+	virtual std::vector<double> params() const = 0;
 	/** @brief destructor.
 	 */
 	virtual ~KFunc() {};
@@ -304,7 +324,14 @@ public:
 	inline double nw(const double s) const{
 		return kn0_*pow(1-s,vn_);
 	}
+	inline double dw(const double s) const{
+		return ( s > 0 ? kw0_*vw_*pow(s,vw_-1) : 0 );
+	}
+	inline double dnw(const double s) const{
+		return ( s < 1 ? -kn0_*vn_*pow(1-s,vn_-1) : 0 );
+	}
 	std::string name() const;
+	std::vector<double> params() const;
 	/**  sets vw,vn,kw0 and kn0.
 	 */
 	KFuncFirooz(const double vw, const double vn,
@@ -332,7 +359,20 @@ public:
 		double ss = fmax(0.001,fmin(s,.999));
 		return kn0_ * sqrt(1-ss) * pow( 1 - pow(ss,1/m_), 2*m_ );
 	}
+	inline double dw(const double s) const{
+		if ( (s < 0.001) || (s > .999) ) return 0;
+		double a = 1 - pow(1- pow(s,1/m_), m_);
+		double da = pow(1 - pow(s,1/m_), m_-1) * pow(s, 1/m_-1);
+		return kw0_ * ( .5 / sqrt(s) * a * a + sqrt(s) * 2 * a * da );
+	}
+	inline double dnw(const double s) const{
+		if ( (s < 0.001) || (s > .999) ) return 0;
+		double b = 1 - pow(s,1/m_);
+		double db = -pow(s, 1/m_-1) / m_;
+		return kn0_ * ( -.5 / sqrt(1-s) * pow(b, 2*m_) + sqrt(1-s) * 2 * m_ * pow(b, 2*m_-1) * db );
+	}
 	std::string name() const;
+	std::vector<double> params() const;
 	/**  sets m, kw0 and kn0.
 	 */
 	KFuncVang(const double m,	const double kw0, const double kn0);	
@@ -356,7 +396,15 @@ public:
 	inline double nw(const double s) const{
 	    return kn0_ * pow(1-s,2) * (1 - pow(s,1+2*lambda_));
 	}
+	inline double dw(const double s) const{
+		return kw0_ * (3+2*lambda_) * pow(s,2+2*lambda_);
+	}
+	inline double dnw(const double s) const{
+	    return kn0_ * ( -2 * (1-s) * (1 - pow(s,1+2*lambda_)) -
+						pow(1-s,2) * (1+2*lambda_) * pow(s,2*lambda_) );
+	}
 	std::string name() const;
+	std::vector<double> params() const;
 	/**  @brief sets m, kw0 and kn0.
 	 */
 	KFuncBrooks(const double lambda,	const double kw0, const double kn0);	
@@ -0,0 +1,258 @@
+/** @file lossy.cpp
+ * cpp file for lossy.hpp.
+ * Part of DF_2d.
+ */
+
+#include "lossy.hpp"
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace lossy{
+
+	const char magic[8] = {'d','f','2','d','z','1','\0','\0'};
+
+	/** @brief probabilities of a binary range coder, in 1/2048 */
+	static const int probBits = 11;
+	/** @brief how fast the probabilities adapt */
+	static const int moveBits = 5;
+	/** @brief the range is renormalized when it gets below this */
+	static const uint32_t top = 1u << 24;
+
+	/** @brief adaptive contexts of the coded differences.
+
+		A difference d is coded as u = 2|d| - (d < 0) + 1, by k, the number of
+		bits of u after the first, in unary, and then those k bits. The unary
+		bits depend on the k of the previous value, as a jump in a field is
+		followed by more of them.
+	*/
+	struct Model{
+		uint16_t len[4][33];  /**< @brief unary bits of k, by the previous k (up to 3) */
+		uint16_t bit[33][32]; /**< @brief bits of u, by k and position */
+		Model(){
+			for (int i = 0 ; i < 4 ; i++)
+				for (int j = 0 ; j < 33 ; j++) len[i][j] = 1 << (probBits - 1);
+			for (int i = 0 ; i < 33 ; i++)
+				for (int j = 0 ; j < 32 ; j++) bit[i][j] = 1 << (probBits - 1);
+		}
+	};
+
+	/** @brief binary range encoder, as in LZMA */
+	class Encoder{
+		std::vector<unsigned char> &out_;
+		uint64_t low_;
+		uint32_t range_;
+		unsigned char cache_;
+		uint64_t ncache_;
+		void shift(){
+			if ( ((uint32_t)low_ < 0xFF000000u) || (low_ >> 32) ){
+				unsigned char c = cache_;
+				do{
+					out_.push_back( (unsigned char)(c + (low_ >> 32)) );
+					c = 0xFF;
+				}while(--ncache_);
+				cache_ = (unsigned char)(low_ >> 24);
+			}
+			ncache_++;
+			low_ = (low_ & 0x00FFFFFFu) << 8;
+		}
+	public:
+		explicit Encoder(std::vector<unsigned char> &out):out_(out), low_(0), range_(0xFFFFFFFFu),
+														  cache_(0), ncache_(1){}
+		/** @brief codes b with the probability p of a 0, and updates p */
+		void bit(uint16_t &p, const int b){
+			const uint32_t bound = (range_ >> probBits) * p;
+			if (!b){
+				range_ = bound;
+				p += ( (1 << probBits) - p ) >> moveBits;
+			}
+			else{
+				low_ += bound;
+				range_ -= bound;
+				p -= p >> moveBits;
+			}
+			while (range_ < top){ range_ <<= 8; shift(); }
+		}
+		/** @brief writes what is left */
+		void finish(){
+			for (int i = 0 ; i < 5 ; i++) shift();
+		}
+	};
+
+	/** @brief binary range decoder, the reverse of Encoder */
+	class Decoder{
+		const unsigned char *p_, *e_;
+		uint32_t range_, code_;
+		bool bad_;
+		unsigned char next(){
+			if (p_ < e_) return *p_++;
+			bad_ = true;
+			return 0;
+		}
+	public:
+		Decoder(const unsigned char *p, const size_t size):p_(p), e_(p + size), range_(0xFFFFFFFFu),
+														   code_(0), bad_(false){
+			for (int i = 0 ; i < 5 ; i++) code_ = (code_ << 8) | next();
+		}
+		/** @brief decodes a bit with the probability p of a 0, and updates p */
+		int bit(uint16_t &p){
+			const uint32_t bound = (range_ >> probBits) * p;
+			int b;
+			if (code_ < bound){
+				range_ = bound;
+				p += ( (1 << probBits) - p ) >> moveBits;
+				b = 0;
+			}
+			else{
+				code_ -= bound;
+				range_ -= bound;
+				p -= p >> moveBits;
+				b = 1;
+			}
+			while (range_ < top){ range_ <<= 8; code_ = (code_ << 8) | next(); }
+			return b;
+		}
+		/** @brief true if more data was read than there is */
+		bool bad() const { return bad_; }
+	};
+
+	/** @brief number of bits of x after the first, x > 0 */
+	static int nbits(uint64_t x){
+		int k = -1;
+		while (x){ x >>= 1; k++; }
+		return k;
+	}
+
+	bool compress(const float *v, const size_t n, const int dim, const double eb,
+				  std::vector<unsigned char> &out, float &ebq){
+		//the floats as they are
+		ebq = 0;
+		if (eb <= 0){
+			const unsigned char *c = (const unsigned char*)v;
+			out.insert(out.end(), c, c + n * sizeof(float));
+			return true;
+		}
+
+		//the half step, a float below eb by the rounding of the largest value to float
+		double vmax = 0;
+		for (size_t i = 0 ; i < n ; i++) vmax = std::fmax(vmax, std::fabs(v[i]));
+		float h = (float)( eb - vmax * FLT_EPSILON );
+		while ( (h > 0) && ((double)h > eb - vmax * FLT_EPSILON) ) h = std::nextafter(h, 0.f);
+		if ( !(h > 0) ) return false;
+
+		//quantize, the differences must fit in 32 bits, and every value must
+		//come back within eb as expand finds it
+		std::vector<int32_t> q(n);
+		const double s = 1 / (2 * (double)h), s2 = 2 * (double)h;
+		for (size_t i = 0 ; i < n ; i++){
+			const double x = std::floor(v[i] * s + 0.5);
+			if ( !std::isfinite(x) || (std::fabs(x) > 1e9) ) return false;
+			if ( std::fabs( (double)(float)(s2 * x) - v[i] ) > eb ) return false;
+			q[i] = (int32_t)x;
+		}
+		ebq = h;
+
+		//code the differences to the same component of the previous value
+		Model m;
+		Encoder rc(out);
+		int kold = 0;
+		for (size_t i = 0 ; i < n ; i++){
+			const int64_t d = (int64_t)q[i] - ( i >= (size_t)dim ? q[i - dim] : 0 );
+			const uint64_t u = ( d >= 0 ? 2 * (uint64_t)d : 2 * (uint64_t)(-d) - 1 ) + 1;
+			const int k = nbits(u), c = ( kold < 3 ? kold : 3 );
+			for (int j = 0 ; j < k ; j++) rc.bit(m.len[c][j], 1);
+			rc.bit(m.len[c][k], 0);
+			for (int j = k - 1 ; j >= 0 ; j--) rc.bit(m.bit[k][j], (u >> j) & 1);
+			kold = k;
+		}
+		rc.finish();
+		return true;
+	}
+
+	bool expand(const unsigned char *p, const size_t size, const FieldHead &h, float *v){
+		if (h.eb <= 0){
+			if (size != h.n * sizeof(float)) return false;
+			memcpy(v, p, size);
+			return true;
+		}
+		if ( (h.dim < 1) || (h.dim > 3) ) return false;
+
+		Model m;
+		Decoder rc(p, size);
+		std::vector<int32_t> q(h.n);
+		const double s = 2 * (double)h.eb;
+		int kold = 0;
+		bool ok = true;
+		for (size_t i = 0 ; ok && (i < h.n) ; i++){
+			const int c = ( kold < 3 ? kold : 3 );
+			int k = 0;
+			while ( (k < 32) && rc.bit(m.len[c][k]) ) k++;
+			uint64_t u = 1;
+			for (int j = k - 1 ; j >= 0 ; j--) u = (u << 1) | rc.bit(m.bit[k][j]);
+			u--;
+			const int64_t d = ( u & 1 ? -(int64_t)( (u + 1) / 2 ) : (int64_t)(u / 2) );
+			const int64_t x = d + ( i >= h.dim ? q[i - h.dim] : 0 );
+			if ( rc.bad() || (x > INT32_MAX) || (x < INT32_MIN) ) ok = false;
+			q[i] = (int32_t)x;
+			v[i] = (float)(s * x);
+			kold = k;
+		}
+		return ok;
+	}
+
+	bool write(const std::string &adr, const std::vector<int> &id,
+			   const std::vector<const std::vector<float>*> &f,
+			   const std::vector<int> &dim, const std::vector<double> &eb){
+		std::vector<unsigned char> buf;
+		FieldHead h;
+		std::ofstream fl( (adr + ".tmp").c_str(), std::ios::binary | std::ios::trunc );
+		if (!fl.is_open()) return false;
+		const uint32_t nf = f.size();
+		fl.write(magic, sizeof(magic));
+		fl.write((const char*)&nf, sizeof(nf));
+		for (size_t k = 0 ; k < f.size() ; k++){
+			buf.clear();
+			h.id = id[k];
+			h.n = f[k]->size();
+			h.dim = dim[k];
+			const float *v = ( h.n ? &(*f[k])[0] : NULL );
+			if (!compress(v, h.n, h.dim, eb[k], buf, h.eb))
+				compress(v, h.n, h.dim, 0, buf, h.eb);
+			h.size = buf.size();
+			fl.write((const char*)&h, sizeof(h));
+			if (!buf.empty()) fl.write((const char*)&buf[0], buf.size());
+		}
+		fl.close();
+		if (fl.fail()) return false;
+		return rename( (adr + ".tmp").c_str(), adr.c_str() ) == 0;
+	}
+
+	bool read(const std::string &adr, std::vector<FieldHead> &h,
+			  std::vector< std::vector<float> > &f){
+		std::ifstream fl(adr.c_str(), std::ios::binary);
+		if (!fl.is_open()) return false;
+		std::vector<unsigned char> d( (std::istreambuf_iterator<char>(fl)), std::istreambuf_iterator<char>() );
+		const unsigned char *p = d.empty() ? NULL : &d[0], *e = p + d.size();
+		uint32_t nf;
+
+		if ( (d.size() < sizeof(magic) + sizeof(nf)) || memcmp(p, magic, sizeof(magic)) ) return false;
+		p += sizeof(magic);
+		memcpy(&nf, p, sizeof(nf));
+		p += sizeof(nf);
+		h.resize(nf);
+		f.resize(nf);
+		for (uint32_t k = 0 ; k < nf ; k++){
+			if ( (size_t)(e - p) < sizeof(FieldHead) ) return false;
+			memcpy(&h[k], p, sizeof(FieldHead));
+			p += sizeof(FieldHead);
+			if ( (uint64_t)(e - p) < h[k].size ) return false;
+			f[k].resize(h[k].n);
+			if ( !expand(p, h[k].size, h[k], h[k].n ? &f[k][0] : NULL) ) return false;
+			p += h[k].size;
+		}
+		return true;
+	}
+}
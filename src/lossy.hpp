@@ -0,0 +1,89 @@
+/** @file lossy.hpp
+ * Error bounded compression of the visual fields.
+ * Part of DF_2d.
+ * @ingroup dr_module
+ */
+
+#ifndef LOSSY_HPP
+#define LOSSY_HPP
+
+#include <vector>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @ingroup dr_module
+ * @brief Compression of float fields with an absolute error bound.
+ *
+ * A value v is stored as q = round(v / 2h), so it comes back as the float
+ * of 2h q. h is a little below eb, by the rounding of the largest value to
+ * float, and every value is checked to come back at most eb away from v;
+ * a field where one does not is kept as floats. The difference of q to the same
+ * component of the previous value is coded by an adaptive binary range
+ * coder, so smooth fields and fields that are mostly constant, like the
+ * saturation away from the front, take a few bits per value. An error
+ * bound of 0 keeps the floats as they are.
+ *
+ * A compressed file (.dfz) has a header, then for every field its index,
+ * number of floats, components, error bound and size, then its data.
+ * Expanding it gives the raw floats of the fields one after the other, the
+ * same file the xdmf visual type writes without compression.
+ */
+namespace lossy{
+
+	/** @brief first bytes of a compressed file */
+	extern const char magic[8];
+
+	/** @brief header of a field in a compressed file */
+	struct FieldHead{
+		uint32_t id;      /**< @brief index of the field, e.g. in the names of the writer */
+		uint32_t n;       /**< @brief number of floats */
+		uint32_t dim;     /**< @brief number of components of each value */
+		float eb;         /**< @brief half the step of the values, 0 if the floats are kept */
+		uint64_t size;    /**< @brief bytes of the data after this header */
+	};
+
+	/** Compresses n floats.
+		@param v the values, dim components of each one after the other
+		@param eb absolute error bound, 0 to keep the floats
+		@param out output, the data, appended to what is there
+		@param ebq output, FieldHead::eb of the data
+		@returns false if a value is not finite, too large for eb or would
+		not come back within eb, out is not changed then
+	*/
+	bool compress(const float *v, const size_t n, const int dim, const double eb,
+				  std::vector<unsigned char> &out, float &ebq);
+
+	/** Expands the data of a field.
+		@param p the data
+		@param size bytes of the data
+		@param h the header of the field
+		@param v output, h.n floats
+		@returns false if the data is damaged
+	*/
+	bool expand(const unsigned char *p, const size_t size, const FieldHead &h, float *v);
+
+	/** Writes a compressed file.
+		@param adr address of the file
+		@param id index of each field
+		@param f the fields
+		@param dim components of each field
+		@param eb error bound of each field, a field that can not be
+		compressed with it is kept as floats
+		@returns false if the file could not be written
+	*/
+	bool write(const std::string &adr, const std::vector<int> &id,
+			   const std::vector<const std::vector<float>*> &f,
+			   const std::vector<int> &dim, const std::vector<double> &eb);
+
+	/** Reads a compressed file.
+		@param adr address of the file
+		@param h output, the header of each field
+		@param f output, the expanded fields
+		@returns false if the file could not be read or is damaged
+	*/
+	bool read(const std::string &adr, std::vector<FieldHead> &h,
+			  std::vector< std::vector<float> > &f);
+}
+
+#endif /*LOSSY_HPP*/
@@ -0,0 +1,222 @@
+/** @file mapfile.cpp
+ * cpp file for mapfile.hpp.
+ * Part of DF_2d.
+ */
+
+#include "mapfile.hpp"
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+/** @brief moves p over the spaces before the next field */
+static const char* skipws(const char *p, const char *e){
+	while ( (p < e) && ( (*p == ' ') || (*p == '\t') || (*p == '\r') ) ) p++;
+	return p;
+}
+
+/** @brief end of the field starting at p */
+static const char* endfield(const char *p, const char *e){
+	while ( (p < e) && (*p != ' ') && (*p != '\t') && (*p != '\r') ) p++;
+	return p;
+}
+
+bool MapLine::operator() (int &x){
+	p = skipws(p, e);
+	if ( (p < e) && (*p == '+') ) p++;
+	std::from_chars_result r = std::from_chars(p, endfield(p, e), x);
+	if (r.ec != std::errc()) return false;
+	p = r.ptr;
+	return true;
+}
+
+bool MapLine::operator() (double &x){
+	p = skipws(p, e);
+	if ( (p < e) && (*p == '+') ) p++;
+	std::from_chars_result r = std::from_chars(p, endfield(p, e), x);
+	if (r.ec != std::errc()) return false;
+	p = r.ptr;
+	return true;
+}
+
+bool MapLine::operator() (char &x){
+	p = skipws(p, e);
+	if (p == e) return false;
+	x = *p++;
+	return true;
+}
+
+bool MapLine::operator() (std::string &x){
+	p = skipws(p, e);
+	if (p == e) return false;
+	const char *q = endfield(p, e);
+	x.assign(p, q);
+	p = q;
+	return true;
+}
+
+MapFile::MapFile():beg_(NULL), end_(NULL), nl_(NULL), size_(0), open_(false), ln(0){
+	ls.p = ls.e = NULL;
+	ls.ln = 0;
+}
+
+void MapFile::open(const std::string &str){
+	FuncBegin();
+
+	struct stat st;
+	void *p = NULL;
+
+	close();
+	fn = str;
+	const int fd = ::open(fn.c_str(), O_RDONLY);
+	if ( (fd < 0) || (fstat(fd, &st) != 0) ){
+		if (fd >= 0) ::close(fd);
+		Error::mess << str << " could not be openned.";
+		ERRSET();
+	}
+	size_ = st.st_size;
+	if (size_) p = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED){
+		size_ = 0;
+		Error::mess << str << " could not be openned.";
+		ERRSET();
+	}
+	if (size_) madvise(p, size_, MADV_SEQUENTIAL);
+	beg_ = (const char*)p;
+	end_ = beg_ + size_;
+	open_ = true;
+	goto_beg();
+
+	FuncEnd();
+}
+
+void MapFile::close(){
+	FuncBegin();
+	if (size_) munmap((void*)beg_, size_);
+	beg_ = end_ = nl_ = NULL;
+	size_ = 0;
+	open_ = false;
+	FuncEnd();
+}
+
+MapFile::~MapFile(){
+	FuncBegin();
+	close();
+	FuncEnd();
+}
+
+bool MapFile::next(){
+	FuncBegin();
+	const char *eol;
+
+	do{
+		//check eof
+		if (nl_ >= end_) return false;
+		//find the line
+		eol = (const char*)memchr(nl_, '\n', end_ - nl_);
+		if (!eol) eol = end_;
+		ls.p = skipws(nl_, eol);
+		ls.e = eol;
+		nl_ = eol + 1;
+		ln++;
+		//check if it was a comment or empty
+	}while( (ls.p == ls.e) || (*ls.p == '#') );
+	ls.ln = ln;
+	return true;
+
+	FuncEnd();
+}
+
+bool MapFile::find(const std::string &findee){
+	FuncBegin();
+	std::string str_t;
+
+	do{
+		if (!next()) return false;
+		ls(str_t);
+	}while(str_t.compare(findee) != 0);
+	return true;
+
+	FuncEnd();
+}
+
+void MapFile::goto_beg(){
+	FuncBegin();
+
+	if(!open_){
+		Error::mess << "Can not go to beginning of not openned file";
+		ERRSET();
+	}
+	nl_ = beg_;
+	ln = 0;
+
+	FuncEnd();
+}
+
+void MapFile::seek(const char *p){
+	FuncBegin();
+
+	if ( !open_ || (p < beg_) || (p > end_) ){
+		Error::mess << fn << " ended unexpectedly.";
+		ERRSET();
+	}
+	nl_ = p;
+
+	FuncEnd();
+}
+
+void MapFile::lines(const int n, std::vector<MapLine> &l){
+	FuncBegin();
+
+	l.resize(n);
+	for (int i = 0 ; i < n ; i++){
+		enext();
+		l[i] = ls;
+	}
+
+	FuncEnd();
+}
+
+void MapFile::enext(){
+	FuncBegin();
+
+	if(!next()) {
+		Error::mess << fn << " ended unexpectedly.";
+		ERRSET();
+	}
+
+	FuncEnd();
+}
+void MapFile::operator() () {
+	FuncBegin();
+	enext();
+	FuncEnd();
+}
+
+void MapFile::efind(const std::string& findee){
+	FuncBegin();
+
+	if(!find(findee)) {
+		Error::mess << findee << " could not be found in " << fn ;
+		ERRSET();
+	}
+
+	FuncEnd();
+}
+
+void MapFile::operator() (const std::string &name){
+	FuncBegin();
+
+	std::string a_name;
+	operator()(a_name, name + " String Identifier");
+	if (a_name.compare(name) != 0){
+		Error::mess << fn << " at line " << ln << ". Expected to read \""
+					<< name << "\" but found \"" << a_name << "\" instead";
+		ERRSET();
+	}
+
+	FuncEnd();
+}
@@ -0,0 +1,145 @@
+/** @file mapfile.hpp
+ * Header file for MapFile class, a faster AsciiFile for large files.
+ * Part of DF_2d.
+ * @ingroup dr_module
+ */
+
+#ifndef MAPFILE_HPP
+#define MAPFILE_HPP
+
+#include <string>
+#include <vector>
+#include "error.hpp"
+
+/** @ingroup dr_module
+ *  @brief The part of a line of a MapFile that is not read yet.
+ *
+ * The fields are read with std::from_chars, straight from the mapped file.
+ * Reading does not raise errors, so the lines can be read on any thread.
+ */
+struct MapLine{
+	const char *p;  /**< @brief first character not read */
+	const char *e;  /**< @brief end of the line */
+	int ln;         /**< @brief line number */
+
+	/** Reads the next field, returns false if it is missing or is not a T. */
+	bool operator() (int &x);
+	/** Same as for int. */
+	bool operator() (double &x);
+	/** Same as for int, reads one character. */
+	bool operator() (char &x);
+	/** Same as for int, reads up to the next space. */
+	bool operator() (std::string &x);
+};
+
+/** @ingroup dr_module
+ *  @brief Reads an ascii file like AsciiFile, without copying the lines.
+ *
+ * The file is mapped into memory. Lines starting with # and empty lines are
+ * skipped the same way, and the errors name the same line numbers. lines()
+ * gives a section of the file to be read on more than one thread.
+ */
+class MapFile{
+	const char *beg_;  /**< @brief start of the mapped file */
+	const char *end_;  /**< @brief end of the mapped file */
+	const char *nl_;   /**< @brief start of the line after the current one */
+	size_t size_;      /**< @brief size of the mapping, 0 for an empty file */
+	bool open_;        /**< @brief a file is open */
+public:
+	/** Stores file name.
+	 */
+	std::string fn;
+
+	/** The current line that has been read.
+	 */
+	MapLine ls;
+
+	/** Line number.
+	 */
+	int ln;
+
+	/** Nothing open. */
+	MapFile();
+
+	/** Calls close.
+	 */
+	~MapFile();
+
+	/** Opens a file.
+	 * @param str file address.
+	 */
+	void open(const std::string& str);
+
+	/** Closes a currently open file.
+	 */
+	void close();
+
+	/** Moves to the next line.
+	 * If reached EOF, false will be returned.
+	 */
+	bool next();
+
+	/** Goes to next line with error checking */
+	void enext();
+	/** Same as enext */
+	void operator() ();
+
+	/** Finds a line starting with a specific string.
+	 *	@param findee the string to look for.
+	 *  @returns false if EOF is reached.
+	 */
+	bool find(const std::string& findee);
+
+	/** Find with error checking.
+	 *	@param findee the string to look for.
+	 */
+	void efind(const std::string& findee);
+
+	/** If the file is open goes to beginning of it.
+	 */
+	void goto_beg();
+
+	/** Start of the line after the current one, where binary data after it starts.
+	 */
+	const char* pos() const
+		{ return nl_; }
+
+	/** End of the file.
+	 */
+	const char* end() const
+		{ return end_; }
+
+	/** Moves to p, the next line starts there.
+	 * ln is not changed, as there are no lines in binary data.
+	 * @param p a position in the file, e.g. after binary data.
+	 */
+	void seek(const char *p);
+
+	/** Finds the next n lines, as enext() would.
+	 * The last of them becomes the current line.
+	 * @param n number of lines
+	 * @param l output, the lines
+	 */
+	void lines(const int n, std::vector<MapLine> &l);
+
+	/** Reads a parameter from the current line and generates error if faild.
+			@param param the parameter that should be read.
+			@param name name of the parameter
+	 */
+	template<class T>
+	void operator() (T &param, const std::string& name ){
+		FuncBegin();
+		if (!ls(param)){
+			Error::mess << fn << " at line " << ln << ". Failed to read " << name ;
+			ERRSET();
+		}
+		FuncEnd();
+	}
+
+	/** Reads a string identifier from the line and checks it.
+			@param name the string identifier
+	 */
+	void operator() (const std::string& name);
+};
+
+#endif /*MAPFILE_HPP*/
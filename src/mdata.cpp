@@ -4,6 +4,7 @@
 
 #include "mdata.hpp"
 #include "error.hpp"
+#include <cmath>
 
 void MData::initialize(){
 	FuncBegin();
@@ -13,10 +14,73 @@ void MData::initialize(){
 	P = (double*) NULL;
 	A = (Mat) NULL;
 	b = (Vec) NULL;
+	F = (Mat) NULL;
+	As = (Mat) NULL;
+	mesh = (Mesh*) NULL;
+	prow = pcol = (IS) NULL;
+	Ploc = Sg = Sl = Fsg = Fsl = Gz = (Vec) NULL;
+	halo = gather = (VecScatter) NULL;
+	comm = PETSC_COMM_SELF;
+	rank = 0;
+	nrank = 1;
+	nthread = 1;
+	pool = (ThreadPool*) NULL;
+	wT0 = wP = wH = 0;
 	J = (JFunc*) NULL;
 	qIn = qOut = qWin = qWout = 0;
 	nIt = 0;
-	cT = 0;
+	nPSolve = nPFactor = nStep = 0;
+	ltsMax = ltsM = 1;
+	ltsNFast = 0;
+	nDtRej = nDtLim = 0;
+	dtE = dtEOld = 0;
+	dtSafe = 0.9;
+	dtCtrl = DtPI;
+	sscheme = SEuler;
+	nSNESIt = 0;
+	sImpIt = 5;
+	sImpDsM = 0.5;
+	rkTol = 1e-3;
+	rkErr = dtNext = 0;
+	steadyTol = steadyPtcTol = stRate = stRateOld = 0;
+	steadyWin = 10;
+	steadyStep = steadyPtc = 0;
+	steadyPtcMax = 1000;
+	steadyT = steadyDsM = steadyDtM = 0;
+	steadyQ[0] = steadyQ[1] = steadyQ[2] = steadyQ[3] = 0;
+	steadyLts = 1;
+	steadyScheme = SEuler;
+	steadyState = SteadyNo;
+	prSlices = prNp = prCoarse = 1;
+	prIt = quiet = 0;
+	prTol = 1e-4;
+	ensN = ensNp = 0;
+	inHash = 0;
+	cacheOff = 0;
+	meshImg = 0;
+	ckptSteps = resume = 0;
+	ckptWall = ckptW0 = 0;
+	outAsync = 0;
+	outq = (OutputQueue*) NULL;
+	lossy = 0;
+	lossyTol[0] = lossyTol[1] = lossyTol[2] = 0;
+	deltaKey = 0;
+	deltaTol[0] = deltaTol[1] = deltaTol[2] = 0;
+	series = (SeriesWriter*) NULL;
+	outFields = OutAll;
+	nFileRun = 0;
+	dmnNp = 1;
+	dmnCache = 4;
+	tStop = HUGE_VAL;
+	snes = (SNES) NULL;
+	Js = (Mat) NULL;
+	Sx = Sr = (Vec) NULL;
+	pUpdateTol = dLt = Vw0 = 0;
+	cT = dpT = 0;
+	pdirect = 0;
+	pdirectLag = 1;
+	pdirectPackage = MATSOLVERPETSC;
+	pshell = 0;
 
 	FuncEnd();
 }
@@ -25,13 +89,29 @@ void MData::finalize(){
 	FuncBegin();
 
 	if (ksp) KSPDestroy(&ksp);
-	if (Pvec){
-		if (P) VecRestoreArrayRead(Pvec, &P);
-		VecDestroy(&Pvec);
-	}
+	if (snes) SNESDestroy(&snes);
+	if (Js) MatDestroy(&Js);
+	if (Sx) VecDestroy(&Sx);
+	if (Sr) VecDestroy(&Sr);
+	if (P) VecRestoreArrayRead( (Ploc ? Ploc : Pvec), &P);
+	if (Pvec) VecDestroy(&Pvec);
+	if (Ploc) VecDestroy(&Ploc);
+	if (Sg) VecDestroy(&Sg);
+	if (Sl) VecDestroy(&Sl);
+	if (Fsg) VecDestroy(&Fsg);
+	if (Fsl) VecDestroy(&Fsl);
+	if (Gz) VecDestroy(&Gz);
+	if (halo) VecScatterDestroy(&halo);
+	if (gather) VecScatterDestroy(&gather);
 	if (A) MatDestroy(&A);
 	if (b) VecDestroy(&b);
+	if (F) MatDestroy(&F);
+	if (As) MatDestroy(&As);
+	if (prow) ISDestroy(&prow);
+	if (pcol) ISDestroy(&pcol);
 	if (J)	delete J ;
+	if (pool) delete pool;
+	if (dtF.is_open()) dtF.close();
 
   FuncEnd();
 }
@@ -12,9 +12,17 @@
 #include "region.hpp"
 #include <list>
 #include <vector>
-#include <petscksp.h>
+#include <fstream>
+#include <stdint.h>
+#include <petscsnes.h>
 #include "gravity.hpp"
+#include "threadpool.hpp"
 
+// Mesh is only used through a pointer by the matrix-free p operator.
+class Mesh;
+// The output queue lives in driver.cpp, MData only points to it.
+class OutputQueue;
+class SeriesWriter;
 
 /** @ingroup edat_module
  * @brief This structure keeps the main data needed by our program.
@@ -53,6 +61,16 @@ struct MData{
 	std::vector<double> Ln;
 
 	
+	/** @brief Total mobility at the last p solve - Discontinuous */
+	std::vector<double> LtP;
+
+	
+	/** @brief Local time stepping: 1 for fast nodes, 2 for slow nodes next to them - Continuous */
+	std::vector<char> ltsFast;
+	/** @brief Local time stepping: Fs of the slow nodes, averaged in time - Continuous */
+	std::vector<double> ltsF;
+
+	
 	/** @brief Sum of S fluxes (RHS of S equation) - Continuous */
 	std::vector<double> Fs;
 	/** @brief Change in saturation - Discontinuous  */
@@ -63,7 +81,63 @@ struct MData{
 	Vec b;
 	/** @brief KSP for p equation - Petsc Krylov SubsPace solver*/
 	KSP ksp;
-	
+	/** @brief LU factor of A used by the direct pressure solver */
+	Mat F;
+	/** @brief Row and column ordering of A computed once for the direct solver */
+	IS prow,
+		pcol;
+	/** @brief SNES for the implicit S equation - Petsc nonlinear solver */
+	SNES snes;
+	/** @brief Jacobian of the implicit S equation - Petsc Mat */
+	Mat Js;
+	/** @brief Master saturations solved for by snes - Petsc Vector */
+	Vec Sx;
+	/** @brief Residual of the implicit S equation - Petsc Vector */
+	Vec Sr;
+	/** @brief Master saturation at the beginning of the time step - Continuous */
+	std::vector<double> Sn;
+	/** @brief SIGMA( phi_i * v_i * s_i ) at the beginning of the time step - Continuous */
+	std::vector<double> Wn;
+	/** @brief d Lw / d S_master - Discontinuous */
+	std::vector<double> dLw;
+	/** @brief d Ln / d S_master - Discontinuous */
+	std::vector<double> dLn;
+	/** @brief Indices of the nodes with constant S, used by snes */
+	std::vector<int> sconst;
+	/** @brief Steady state: rate of change of S in the last steps (ring) */
+	std::vector<double> stRates;
+	/** @brief Steady state: qWin in the last steps (ring) */
+	std::vector<double> stQWin;
+	/** @brief Steady state: qWout in the last steps (ring) */
+	std::vector<double> stQWout;
+	/** @brief Runge-Kutta master saturations: start of the step - Continuous */
+	std::vector<double> rkS0;
+	/** @brief Runge-Kutta master saturations: stages and embedded solution - Continuous */
+	std::vector<double> rkS1,
+		rkS2;
+	/** @brief Matrix-free LHS of P equation - Petsc shell Mat */
+	Mat As;
+	/** @brief Indices of the nodes with constant p, used by As */
+	std::vector<int> pconst;
+	/** @brief The mesh As applies its element kernels on */
+	Mesh *mesh;
+	/** @brief P of the owned and ghost nodes, md.P points to it when distributed - Petsc Vector */
+	Vec Ploc;
+	/** @brief Master saturation of the owned nodes, distributed like Pvec - Petsc Vector */
+	Vec Sg;
+	/** @brief Master saturation of the owned and ghost nodes - Petsc Vector */
+	Vec Sl;
+	/** @brief Fs summed over all processes, distributed like Pvec - Petsc Vector */
+	Vec Fsg;
+	/** @brief Fs of the owned and ghost nodes found by this process - Petsc Vector */
+	Vec Fsl;
+	/** @brief Whole nodal field on process 0, used for writing files - Petsc Vector */
+	Vec Gz;
+	/** @brief Halo exchange: distributed vector to owned and ghost nodes */
+	VecScatter halo;
+	/** @brief Gathers a distributed vector on process 0 */
+	VecScatter gather;
+
 
 	/*******************************************************************
 	 * Single Values
@@ -88,23 +162,130 @@ struct MData{
 
 	int nIt,   /**< @brief number of times that s equation is solved from beginning */
 		dnIt,    /**< @brief number of times that s equation is solved in this timestep*/
-		dnItM;  /**< @brief maximum allowed number of times to solve S in one timestep*/
+		dnItM,  /**< @brief maximum allowed number of times to solve S in one timestep*/
+		nPSolve,  /**< @brief number of times that p equation is solved from beginning */
+		nPFactor, /**< @brief number of numerical factorizations of A (direct solver) */
+		nStep,    /**< @brief number of time steps taken from beginning */
+		ltsMax,   /**< @brief maximum number of sub-steps of the fast nodes */
+		ltsM,     /**< @brief number of sub-steps of the fast nodes in this timestep */
+		ltsNFast, /**< @brief number of fast nodes in this timestep */
+		nSNESIt,  /**< @brief number of newton iterations of the implicit S equation from beginning */
+		sImpIt;   /**< @brief dt is increased if the implicit S equation took at most this many newton iterations */
+
+	double dcT, /**< @brief wall time of one time step */
+		cT,       /**< @brief wall time of the time steps since the program has started */
+		dpT;      /**< @brief wall time of the last p solve */
+
+	double sImpDsM, /**< @brief maximum change in saturation for the implicit S equation */
+		rkTol,    /**< @brief maximum local error of a Runge-Kutta step */
+		rkErr,    /**< @brief local error of the last Runge-Kutta step */
+		dtNext,   /**< @brief if positive, the time step chosen for the next step */
+		steadyTol, /**< @brief rate of change of S below which the steady state is reached, 0 for off */
+		steadyPtcTol, /**< @brief rate of change of S that ends the pseudo-transient mode */
+		stRate,   /**< @brief max rate of change of S at the beginning of this step */
+		stRateOld, /**< @brief stRate of the previous step in pseudo-transient mode */
+		steadyT,  /**< @brief t at which the steady state was found, the end of a pseudo-transient run */
+		steadyDsM, /**< @brief sImpDsM before the pseudo-transient mode, restored after it */
+		steadyDtM; /**< @brief dtM before the pseudo-transient mode, restored after it */
+	double steadyQ[4]; /**< @brief qIn, qOut, qWin and qWout when the steady state was found */
+
+	int steadyWin, /**< @brief number of steps the steady state must hold */
+		steadyStep, /**< @brief the step at which the steady state was found */
+		steadyPtc,  /**< @brief 1 to go on in pseudo-transient mode after steady state, 0 to stop */
+		steadyPtcMax, /**< @brief max number of steps in pseudo-transient mode */
+		steadyLts,  /**< @brief ltsMax before the pseudo-transient mode, restored after it */
+		steadyScheme, /**< @brief sscheme before the pseudo-transient mode, restored after it */
+		prSlices,   /**< @brief number of parareal time slices, 1 for normal marching */
+		prNp,       /**< @brief max number of parareal slices solved at the same time */
+		prCoarse,   /**< @brief number of time steps of the parareal coarse propagator in a slice */
+		prIt,       /**< @brief number of parareal iterations done */
+		ensN,       /**< @brief number of ensemble members, 0 for a single run */
+		ensNp,      /**< @brief max number of ensemble members run at the same time */
+		quiet;      /**< @brief if 1 marchintime does not report */
+
+	double prTol, /**< @brief max change of S between two parareal iterations to stop */
+		tStop;      /**< @brief time steps do not go beyond this time */
+
+	double dtSafe, /**< @brief fraction of the admissible dt used by the PI controller */
+		dtE,      /**< @brief ds/dsM of the last time step (PI controller) */
+		dtEOld;   /**< @brief ds/dsM of the time step before the last (PI controller) */
+
+	int nDtRej, /**< @brief number of times dt was divided by beta from beginning */
+		nDtLim;   /**< @brief number of times the PI dt was cut to the admissible dt */
+
+	double pUpdateTol, /**< @brief max relative change of total mobility before p is solved again */
+		dLt,      /**< @brief relative change of total mobility since the last p solve */
+		Vw0;      /**< @brief wetting phase volume at the beginning, for mass balance */
+
+	MPI_Comm comm; /**< @brief communicator of the p equation, PETSC_COMM_SELF if not distributed */
+
+	int rank,   /**< @brief rank of this process */
+		nrank;    /**< @brief number of processes, more than 1 means the mesh is distributed */
+
+	int nthread; /**< @brief number of threads, the mesh has one partition per thread */
+
+	ThreadPool *pool; /**< @brief threads that assemble the partitions, NULL for one thread */
+
+	std::vector< std::vector<double> > FsIf; /**< @brief Fs of the interface nodes from each partition */
 
-	double dcT, /**< @brief time passed for one time step */
-		cT;       /**< @brief time passed since the program has started */
+	double wT0, /**< @brief wall clock at the first time step */
+		wP,       /**< @brief wall time of the p solves */
+		wH;       /**< @brief wall time of the halo exchanges and reductions */
 
 	double qIn, /**< @brief total injected fluid to reservoir*/
 		qOut,     /**< @brief total extracted fluid from reservoir */
 		qWin,     /**< @brief total water injected to reservoir */
 		qWout;    /**< @brief total water extracted from reservoir */
 
+	/** @brief indicates how the S equation is moved in time */
+	enum SScheme{SEuler,   /**< @brief explicit forward euler */
+				 SImplicit,/**< @brief backward euler solved with SNES, P constant */
+				 SSSPRK2,  /**< @brief SSP Runge-Kutta order 2 with embedded euler error */
+				 SSSPRK3   /**< @brief SSP Runge-Kutta order 3 with embedded order 2 error */
+	};
+	/** @brief how the S equation is moved in time */
+	SScheme sscheme;
+	/** @brief indicates if the steady state is reached */
+	enum SteadyState{SteadyNo,  /**< @brief still transient */
+					 SteadyPTC, /**< @brief found, converging it with pseudo-transient steps */
+					 SteadyDone /**< @brief found, the simulation should stop */
+	};
+	/** @brief if the steady state is reached */
+	SteadyState steadyState;
+	/** @brief indicates how the time step is chosen */
+	enum DtController{DtRetry, /**< @brief divide dt by beta until ds < dsM */
+					  DtPI     /**< @brief find dt from Fs/SPhiV with a PI rule */
+	};
+	/** @brief how the time step is chosen */
+	DtController dtCtrl;
+	/** @brief the dt history file, one line per time step */
+	std::ofstream dtF;
+
 	int nFile0,   /**< @brief first number of .vtk (octave for 1d) file */
 		nFile,      /**< @brief current number of .vtk (octave for 1d) file */
+		nFileRun,   /**< @brief first file of this run, nFile0 or the one after the state it resumed from */
 		NFile;      /**< @brief final number of .vtk (octave for 1d) file */
 
 	JFunc *J;        /**< @brief Cappilary Curve */
 
 	std::string dir;  /**< @brief current directory */
+	std::string dmnDir; /**< @brief job directory of the daemon mode, empty for a normal run */
+	uint64_t inHash;  /**< @brief hash of the inputs that decide the states of the run, 0 if they are not cached */
+	int cacheOff;     /**< @brief 1 if the states are not cached and a run never resumes from them */
+	int meshImg;      /**< @brief 1 to read the mesh from its binary image, written if it is missing or old */
+	int ckptSteps,    /**< @brief write a checkpoint every this many time steps, 0 for never */
+		resume;       /**< @brief 1 to start from the checkpoint instead of the initial file */
+	double ckptWall,  /**< @brief write a checkpoint every this many seconds of wall time, 0 for never */
+		ckptW0;       /**< @brief wall clock at the last checkpoint */
+	int outAsync;     /**< @brief number of snapshots the output thread is given, 0 to write on the main thread */
+	OutputQueue *outq; /**< @brief the output thread during driver::solve, NULL when writing on the main thread */
+	int lossy;        /**< @brief 1 to compress the xdmf visual fields */
+	double lossyTol[3]; /**< @brief absolute error bounds of S, P and the velocities in the compressed fields, 0 to keep them */
+	int deltaKey;     /**< @brief write the xdmf fields as a series with a keyframe every this many outputs, 0 for no series */
+	double deltaTol[3]; /**< @brief changes of S, P and the velocities a delta frame keeps, smaller ones are dropped */
+	SeriesWriter *series; /**< @brief the series during driver::solve, NULL for none */
+	int dmnNp,        /**< @brief max number of daemon jobs run at the same time */
+		dmnCache;     /**< @brief max number of meshes the daemon keeps */
 
 	/** @brief indicates the type of mesh input file */
 	enum MeshType{MeshTriangle, /**< @brief Triangle .ele + .node + .edge file */
@@ -116,7 +297,8 @@ struct MData{
 	/** @brief indicates type of output file */
 	enum VisualType {VisualVtk,     /**< vtk file */
 					 VisualTecplot,  /**< Tecplot file */
-					 VisualGmsh     /**< msh file */
+					 VisualGmsh,    /**< msh file */
+					 VisualXdmf     /**< xdmf time series, the mesh is written once */
 	};
 	/**@brief  type of output */
 	VisualType visualtype;
@@ -130,13 +312,56 @@ struct MData{
 	 */
 	int visualduplicate;
 
+	/** @brief the outputs that can be selected in solver.config */
+	enum OutputField {OutSwNode = 1,   /**< nodal saturation of the visual files */
+					  OutSwCell = 2,   /**< cellwise saturation */
+					  OutPw = 4,       /**< pressure */
+					  OutQw = 8,       /**< wetting phase velocity */
+					  OutQn = 16,      /**< non-wetting phase velocity */
+					  OutQtotal = 32,  /**< total velocity */
+					  OutRestart = 64, /**< the restart files */
+					  OutFlow = 128,   /**< the lines of result.flow */
+					  OutAll = 255     /**< everything, when solver.config does not say */
+	};
+	/** @brief the outputs written, OutputField flags.
+	 *
+	 * Only the visual fields selected are computed, so without the velocities
+	 * the outputs do not need the mobilities or the KD matrices of the elements.
+	 */
+	int outFields;
+
 	/** @brief setfield mode or solver mode.
 	 *
 	 * If set to 1 df2d only changes the initial file and exits.
 	 * If set to 0 df2d will run a simulation
 	*/
 	int setfield;
-	
+
+	/** @brief solve the p equation using a direct solver with cached ordering.
+	 *
+	 * If set to 1 the nested dissection ordering and the symbolic LU factorization
+	 * of A are found once in preparedata, as the sparsity of A never changes after
+	 * Mesh::constructGeoParams. Each time step only does the numerical
+	 * factorization. If set to 0 the KSP configured in petsc.config is used.
+	 */
+	int pdirect;
+	/** @brief number of p solves between two numerical factorizations.
+	 *
+	 * If larger than 1 the lagged factor is used as a preconditioner for the KSP
+	 * instead of being applied once as an exact solver.
+	 */
+	int pdirectLag;
+	/** @brief the solver package used for the factorization, e.g. petsc or superlu */
+	std::string pdirectPackage;
+	/** @brief solve the p equation without assembling A.
+	 *
+	 * If set to 1 A is destroyed after preparedata and a Petsc shell matrix is
+	 * used instead, which applies the element lhsP matrices (upwinded mobilities
+	 * times H) on the fly. The diagonal of the operator is used as the
+	 * preconditioner.
+	 */
+	int pshell;
+
 
 	/*******************************************************************
 	 * Functions 
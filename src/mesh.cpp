@@ -5,6 +5,8 @@
 */
 
 #include "mesh.hpp"
+#include <algorithm>
+#include <deque>
 
 using std::list;
 using std::vector;
@@ -12,13 +14,224 @@ using std::vector;
 
 Region* Mesh::findRegion(const int regid){ 
 	FuncBegin();
-	for ( list<Region*>::iterator i = begreg() ; i != endreg() ; i++){
-		if (regid == (*i)->ID) return (*i);
-	}
-	return (Region*) NULL;
+	std::unordered_map<int, Region*>::const_iterator i = regid_.find(regid);
+	return ( i == regid_.end() ? (Region*) NULL : i->second );
 	FuncEnd(); 
 } 
 
+void Mesh::bisect(vector<int> &pos, const int b, const int e,
+				  const int p0, const int np, vector<int> &part){
+	FuncBegin();
+
+	double x0, x1, y0, y1;
+	int m;
+	bool alongx;
+
+	if (np == 1){
+		for (int k = b ; k < e ; k++) part[ pos[k] ] = p0;
+		return;
+	}
+	//the longer side of the bounding box
+	x0 = x1 = vnode_[ pos[b] ].x;
+	y0 = y1 = vnode_[ pos[b] ].y;
+	for (int k = b ; k < e ; k++){
+		x0 = fmin(x0, vnode_[ pos[k] ].x); x1 = fmax(x1, vnode_[ pos[k] ].x);
+		y0 = fmin(y0, vnode_[ pos[k] ].y); y1 = fmax(y1, vnode_[ pos[k] ].y);
+	}
+	alongx = ( x1 - x0 >= y1 - y0 );
+	//split at the weighted median, ties are broken by position so all processes agree
+	m = b + (int)( (long)(e - b) * (np / 2) / np );
+	std::nth_element(pos.begin() + b, pos.begin() + m, pos.begin() + e,
+					 [this, alongx](const int i, const int j){
+						 const double ci = ( alongx ? vnode_[i].x : vnode_[i].y ),
+							 cj = ( alongx ? vnode_[j].x : vnode_[j].y );
+						 return ( ci < cj ) || ( (ci == cj) && (i < j) );
+					 });
+	bisect(pos, b, m, p0, np / 2, part);
+	bisect(pos, m, e, p0 + np / 2, np - np / 2, part);
+
+	FuncEnd();
+}
+
+void Mesh::partition(){
+	FuncBegin();
+
+	vector<int> pos(nnode()), part(nnode()), next;
+
+	for (int i = 0 ; i < nnode() ; i++) pos[i] = i;
+	bisect(pos, 0, nnode(), 0, nrank_, part);
+	//contiguous idx for each process, in the order of the nodes
+	rrange_.assign(nrank_ + 1, 0);
+	for (int i = 0 ; i < nnode() ; i++) rrange_[ part[i] + 1 ]++;
+	for (int r = 0 ; r < nrank_ ; r++) rrange_[r+1] += rrange_[r];
+	next.assign(rrange_.begin(), rrange_.end() - 1);
+	for (int i = 0 ; i < nnode() ; i++) vnode_[i].idx = next[ part[i] ]++;
+
+	FuncEnd();
+}
+
+int Mesh::owner(const int idx) const{
+	FuncBegin();
+	return (int)( std::upper_bound(rrange_.begin(), rrange_.end(), idx) - rrange_.begin() ) - 1;
+	FuncEnd();
+}
+
+void Mesh::distribute(){
+	FuncBegin();
+
+	list<eleblank*> lele_rem;
+	list<BVertexCQ*> lbvertex_rem;
+	vector<char> mark(nnode(), 0);
+	const arma::ivec *idx;
+	list<eleblank*>::iterator i;
+	list<BVertexCQ*>::iterator j;
+
+	//owned nodes are marked with 1 and ghost nodes with 2
+	for (int k = rstart() ; k < rend() ; k++) mark[k] = 1;
+	for (i = lele_ptr_.begin() ; i != lele_ptr_.end() ; ){
+		idx = &(*i)->idxGlob();
+		bool own = false;
+		for (int k = 0 ; k < (*i)->nNode() ; k++) own = own || ( mark[ (*idx)(k) ] == 1 );
+		if (own)
+			for (int k = 0 ; k < (*i)->nNode() ; k++)
+				if ( !mark[ (*idx)(k) ] ) mark[ (*idx)(k) ] = 2;
+		if ( owner( arma::min(*idx) ) != rank_ ) lele_rem.splice(lele_rem.end(), lele_ptr_, i++);
+		else i++;
+	}
+	lele_end_ = ( lele_rem.empty() ? lele_ptr_.end() : lele_rem.begin() );
+	lele_ptr_.splice(lele_ptr_.end(), lele_rem);
+	for (j = lbvertex_ptr_.begin() ; j != lbvertex_ptr_.end() ; ){
+		if ( mark[ (*j)->idx() ] != 1 ) lbvertex_rem.splice(lbvertex_rem.end(), lbvertex_ptr_, j++);
+		else j++;
+	}
+	lbvertex_end_ = ( lbvertex_rem.empty() ? lbvertex_ptr_.end() : lbvertex_rem.begin() );
+	lbvertex_ptr_.splice(lbvertex_ptr_.end(), lbvertex_rem);
+	//owned nodes, then ghosts
+	vlnode_.clear();
+	for (int k = rstart() ; k < rend() ; k++) vlnode_.push_back(vnodeidx_[k]);
+	nownnode_ = vlnode_.size();
+	for (int k = 0 ; k < nnode() ; k++) if (mark[k] == 2) vlnode_.push_back(vnodeidx_[k]);
+
+	FuncEnd();
+}
+
+void Mesh::partitionElements(const int np){
+	FuncBegin();
+
+	vector<eleblank*> ele(begele(), endele());
+	const int ne = ele.size();
+	vector<int> part(ne, -1), nstart(nnode() + 1, 0), nele, order, pmin(nnode(), np), pmax(nnode(), -1),
+		newidx(nnode(), -1), estart(np + 1, 0);
+	std::deque<int> q, front;
+	const arma::ivec *idx;
+	int e, seed = 0, first = 0, cnt, next;
+
+	//elements around each node
+	for (e = 0 ; e < ne ; e++){
+		idx = &ele[e]->idxGlob();
+		for (int k = 0 ; k < ele[e]->nNode() ; k++) nstart[ (*idx)(k) + 1 ]++;
+	}
+	for (int i = 0 ; i < nnode() ; i++) nstart[i+1] += nstart[i];
+	nele.resize(nstart[nnode()]);
+	{
+		vector<int> pos(nstart.begin(), nstart.end() - 1);
+		for (e = 0 ; e < ne ; e++){
+			idx = &ele[e]->idxGlob();
+			for (int k = 0 ; k < ele[e]->nNode() ; k++) nele[ pos[ (*idx)(k) ]++ ] = e;
+		}
+	}
+	//calls f for each element sharing a node with element e
+	auto neigh = [&](const int e, std::deque<int> &out){
+		const arma::ivec &id = ele[e]->idxGlob();
+		for (int k = 0 ; k < ele[e]->nNode() ; k++)
+			for (int l = nstart[ id(k) ] ; l < nstart[ id(k) + 1 ] ; l++)
+				if (part[ nele[l] ] < 0) out.push_back(nele[l]);
+	};
+
+	//peripheral seed: the last element reached from the first one
+	if (ne > 0){
+		vector<char> seen(ne, 0);
+		q.push_back(0);
+		seen[0] = 1;
+		while (!q.empty()){
+			seed = q.front();
+			q.pop_front();
+			std::deque<int> nb;
+			neigh(seed, nb);
+			for (std::deque<int>::iterator l = nb.begin() ; l != nb.end() ; l++)
+				if (!seen[*l]){ seen[*l] = 1; q.push_back(*l); }
+		}
+	}
+
+	//grow the partitions, each starts from the front the last one left
+	for (int p = 0 ; p < np ; p++){
+		estart[p] = order.size();
+		cnt = 0;
+		q.clear();
+		while ( cnt < (long)ne * (p + 1) / np - (long)ne * p / np ){
+			if (q.empty()){
+				while ( !front.empty() && (part[ front.front() ] >= 0) ) front.pop_front();
+				if (!front.empty()) seed = front.front();
+				else if ( (p > 0) || (part[seed] >= 0) ){
+					while (part[first] >= 0) first++;
+					seed = first;
+				}
+				q.push_back(seed);
+			}
+			e = q.front();
+			q.pop_front();
+			if (part[e] >= 0) continue;
+			part[e] = p;
+			order.push_back(e);
+			cnt++;
+			neigh(e, q);
+		}
+		front.insert(front.end(), q.begin(), q.end());
+	}
+	estart[np] = ne;
+
+	//sort the elements by partition
+	lele_ptr_.clear();
+	for (e = 0 ; e < ne ; e++) lele_ptr_.push_back( ele[ order[e] ] );
+	lele_end_ = lele_ptr_.end();
+	partele_.assign(np + 1, lele_ptr_.end());
+	for (int p = np - 1 ; p >= 0 ; p--){
+		partele_[p] = partele_[p+1];
+		for (e = estart[p] ; e < estart[p+1] ; e++) partele_[p]--;
+	}
+
+	//inner nodes of each partition in the order they are met, then the interface nodes
+	for (e = 0 ; e < ne ; e++){
+		idx = &ele[e]->idxGlob();
+		for (int k = 0 ; k < ele[e]->nNode() ; k++){
+			pmin[ (*idx)(k) ] = std::min( pmin[ (*idx)(k) ], part[e] );
+			pmax[ (*idx)(k) ] = std::max( pmax[ (*idx)(k) ], part[e] );
+		}
+	}
+	partnode_.assign(np + 2, 0);
+	next = 0;
+	for (int p = 0 ; p < np ; p++){
+		partnode_[p] = next;
+		for (e = estart[p] ; e < estart[p+1] ; e++){
+			idx = &ele[ order[e] ]->idxGlob();
+			for (int k = 0 ; k < ele[ order[e] ]->nNode() ; k++){
+				const int i = (*idx)(k);
+				if ( (newidx[i] < 0) && (pmin[i] == pmax[i]) ) newidx[i] = next++;
+			}
+		}
+	}
+	partnode_[np] = next;
+	for (int i = 0 ; i < nnode() ; i++) if (newidx[i] < 0) newidx[i] = next++;
+	partnode_[np+1] = next;
+
+	//renumber
+	for (vector<Node>::iterator i = begnode() ; i < endnode() ; i++) i->idx = newidx[i->idx];
+	for (vector<Node>::iterator i = begnode() ; i < endnode() ; i++) vnodeidx_.at(i->idx) = &(*i);
+	vlnode_ = vnodeidx_;
+
+	FuncEnd();
+}
+
 void Mesh::reserveNodes(const int sz){ 
 	FuncBegin(); 
 	vnode_.reserve(sz);
@@ -47,43 +260,49 @@ void Mesh::addNode(const double x, const double y, const int idx){
 
 void Mesh::addElement(const int regid, const int ndidx[], const CellType celltype, const int linenumber){ 
 	FuncBegin();
+	addElements(regid, ndidx, celltype, 1, linenumber);
+	FuncEnd(); 
+} 
+
+void Mesh::addElements(const int regid, const int ndidx[], const CellType celltype, const int n,
+					   const int linenumber){ 
+	FuncBegin();
 	Node *ndptr[10];
 	Region *regptr;
 
 	//find the region
 	regptr = findRegion(regid);
 	if (!regptr) return;
+	if ( regptr->isBoundary() && (celltype != CellPoint) && (celltype != CellLine) ){
+		Error::mess << "Element belongs to region: " << regid << " which is boundary. "
+					<< "However it is neither a line nor a point. It is a " << celltype
+					<< " at line "<< linenumber << " of mesh file. " ;
+		ERRSET();
+	}
 
-	//find the nodes
-	for (int i = 0 ; i < (int)celltype ; i++)
-		ndptr[i] = &vnode_.at(ndidx[i]);
-	
-	//add the element
-	if ( regptr->isBoundary() ){
-		RegionBoundary *regptrbnd = (RegionBoundary*) regptr;
-	    switch (celltype){
-			case CellPoint:
+	for (int k = 0 ; k < n ; k++, ndidx += (int)celltype){
+		//find the nodes
+		for (int i = 0 ; i < (int)celltype ; i++)
+			ndptr[i] = &vnode_.at(ndidx[i]);
+
+		//add the element
+		if ( regptr->isBoundary() ){
+			RegionBoundary *regptrbnd = (RegionBoundary*) regptr;
+			if (celltype == CellPoint)
 				lbvertex_ptr_.push_back( BVertexCQ::neww(ndptr[0], regptrbnd, regptrbnd->ptype) );
-				break;
-			case CellLine:
+			else{
 				if (!ndptr[0]->bvertex) 
 					lbvertex_ptr_.push_back( BVertexCQ::neww( ndptr[0], regptrbnd , regptrbnd->ptype) );
 				ndptr[0]->bvertex->addNeigh(ndptr[1]);
 				if (!ndptr[1]->bvertex)
 					lbvertex_ptr_.push_back( BVertexCQ::neww( ndptr[1], regptrbnd , regptrbnd->ptype) );
 				ndptr[1]->bvertex->addNeigh(ndptr[0]);
-				break;
-			default:
-				Error::mess << "Element belongs to region: " << regid << " which is boundary. "
-							<< "However it is neither a line nor a point. It is a " << celltype
-							<< " at line "<< linenumber << " of mesh file. " ;
-				ERRSET();
-				break;
 			}
-	}
-	else{
-		RegionPorous *regptrpour = (RegionPorous*) regptr;
-		lele_ptr_.push_back( eleblank::neww(regptrpour, ndptr, celltype) );
+		}
+		else{
+			RegionPorous *regptrpour = (RegionPorous*) regptr;
+			lele_ptr_.push_back( eleblank::neww(regptrpour, ndptr, celltype) );
+		}
 	}
 									 
 	FuncEnd(); 
@@ -92,34 +311,107 @@ void Mesh::addElement(const int regid, const int ndidx[], const CellType celltyp
 void Mesh::addRegion(Region *regionpointer){ 
 	FuncBegin(); 
 	lreg_ptr_.push_back(regionpointer);
+	regid_.insert( std::make_pair(regionpointer->ID, regionpointer) );
 	FuncEnd(); 
 } 
 
 void Mesh::constructGeoParams(const RegionPointerComparer& cmp,
-							  const double dp, Mat &A, const Gravity &grav){ 
+							  const double dp, Mat &A, const Gravity &grav,
+							  MPI_Comm comm, const int npart, MeshGeo *geo){ 
 	FuncBegin();
 	int j,jbup;
 	arma::vec::fixed<20> matloc;
+	const bool set = geo && !geo->ndd.empty();
+	bool csr;
+	//elements and bvertices in the order they were added, before they are partitioned
+	vector<eleblank*> vele(begele(), endele());
+	std::unordered_map<BVertexCQ*, int> bpos;
+
+	j = 0;
+	for ( list<BVertexCQ*>::iterator i = begbvertex() ; i != endbvertex() ; i++) bpos[*i] = j++;
+	if ( set && ( ((int)geo->ndd.size() != nnode()) || (geo->bnb.size() != 2 * bpos.size()) ||
+				  (geo->bvx.size() != BVertexCQ::nGeo * bpos.size()) ) ){
+		Error::mess << "the geometry of the mesh image does not match the mesh";
+		ERRSET();
+	}
+
+	//partition the nodes
+	comm_ = comm;
+	Error::code=MPI_Comm_size(comm_, &nrank_);ERRCHK();
+	Error::code=MPI_Comm_rank(comm_, &rank_);ERRCHK();
+	rrange_.assign(2, 0);
+	rrange_[1] = nnode();
+	if (nrank_ > 1) partition();
+	vnodeidx_.resize(nnode());
+	for (vector<Node>::iterator i = begnode() ; i < endnode() ; i++) vnodeidx_.at(i->idx) = &(*i);
+	vlnode_ = vnodeidx_;
+	nownnode_ = nnode();
 
 	// sort regions
 	lreg_ptr_.sort(cmp);
+	vector<RegionPorous*> vreg;
 	j = 0;
 	for ( list<Region*>::iterator i = begreg() ; i != endreg() ; i++){
 		(*i)->idx = j;
+		vreg.push_back( dynamic_cast<RegionPorous*>(*i) );
 		j++;
 	}
 
 	//create dupldata
-	for ( list<eleblank*>::iterator i = begele() ; i != endele() ; i++){
-		(*i)->constructGeoParams();
-		(*i)->constructDuplData();
-		(*i)->constructBVertices(NULL);
+	if (set){
+		//the dupldata of each node in their sorted order, the elements only find theirs
+		const int *d = &geo->dreg[0];
+		size_t ne = 0;
+		for (vector<Node>::iterator i = begnode() ; i < endnode() ; i++){
+			i->n_dd = geo->ndd.at(i - begnode());
+			for (int k = 0 ; k < i->n_dd ; k++, d++){
+				DuplData dd;
+				dd.constructBase(vreg.at(*d));
+				i->dd.push_back(dd);
+			}
+		}
+		for (size_t i = 0 ; i < vele.size() ; i++){
+			vele[i]->constructDuplData();
+			if (ne + vele[i]->nGeo() > geo->ele.size()){
+				Error::mess << "the geometry of the mesh image does not match the mesh";
+				ERRSET();
+			}
+			vele[i]->setGeoParams(&geo->ele[ne]);
+			ne += vele[i]->nGeo();
+		}
 	}
+	else{
+		for ( list<eleblank*>::iterator i = begele() ; i != endele() ; i++){
+			(*i)->constructGeoParams();
+			(*i)->constructDuplData();
+			(*i)->constructBVertices(NULL);
+		}
+		if (geo){
+			geo->ndd.clear();
+			geo->dreg.clear();
+			geo->ele.clear();
+			for (vector<Node>::iterator i = begnode() ; i < endnode() ; i++){
+				geo->ndd.push_back(i->n_dd);
+				for (list<DuplData>::iterator k = i->dd.begin() ; k != i->dd.end() ; k++)
+					geo->dreg.push_back(k->reg->idx);
+			}
+			for (size_t i = 0 ; i < vele.size() ; i++){
+				geo->ele.resize(geo->ele.size() + vele[i]->nGeo());
+				vele[i]->geoParams(&geo->ele[geo->ele.size() - vele[i]->nGeo()]);
+			}
+		}
+	}
+	partele_.assign(1, begele());
+	partele_.push_back(endele());
+	partnode_.assign(3, nnode());
+	partnode_[0] = 0;
+	if ( (npart > 1) && (nrank_ == 1) ) partitionElements(npart);
+	//dupldata follow the node idx, so each partition is contiguous too
 	j = 0;
 	jbup = 0;
-	for (vector<Node>::iterator i = begnode() ; i < endnode() ; i++){
-		jbup += i->n_dd;
-		for (list<DuplData>::iterator k = i->dd.begin() ; k != i->dd.end() ; k++){
+	for (vector<Node*>::iterator i = vnodeidx_.begin() ; i < vnodeidx_.end() ; i++){
+		jbup += (*i)->n_dd;
+		for (list<DuplData>::iterator k = (*i)->dd.begin() ; k != (*i)->dd.end() ; k++){
 			k->idx = j;
 			j++;
 		}
@@ -130,40 +422,105 @@ void Mesh::constructGeoParams(const RegionPointerComparer& cmp,
 		ERRSET();
 	}
 
-	//create the matrix
-	Error::code=MatCreateSeqAIJ(PETSC_COMM_SELF,nnode(),nnode(),0,NULL,&A);ERRCHK();
-	Error::code=MatZeroEntries(A);ERRCHK();
+	//create the matrix, only with the rows of this process
+	csr = set && (nrank_ == 1) && ((int)geo->ia.size() == nnode() + 1);
+	if (nrank_ > 1){
+		distribute();
+		partele_.back() = endele();
+		partnode_.assign(3, nownnode_);
+		partnode_[0] = 0;
+		Error::code=MatCreateAIJ(comm_, rend() - rstart(), rend() - rstart(), nnode(), nnode(),
+								 0, NULL, 0, NULL, &A);ERRCHK();
+	}
+	else if (csr){
+		//the rows by idx, each one sorted, as MatSeqAIJSetPreallocationCSR takes them
+		vector<int> nnz(nnode()), ia(nnode() + 1, 0), ja(geo->ja.size());
+		for (vector<Node>::iterator i = begnode() ; i < endnode() ; i++){
+			const int p = i - begnode();
+			nnz.at(i->idx) = geo->ia[p+1] - geo->ia[p];
+		}
+		for (int i = 0 ; i < nnode() ; i++) ia[i+1] = ia[i] + nnz[i];
+		for (vector<Node>::iterator i = begnode() ; i < endnode() ; i++){
+			const int p = i - begnode();
+			int *c = &ja[ ia[i->idx] ];
+			for (int k = geo->ia[p] ; k < geo->ia[p+1] ; k++) *(c++) = vnode_.at(geo->ja[k]).idx;
+			std::sort(&ja[ ia[i->idx] ], c);
+		}
+		Error::code=MatCreateSeqAIJ(PETSC_COMM_SELF,nnode(),nnode(),0,&nnz[0],&A);ERRCHK();
+		Error::code=MatSeqAIJSetPreallocationCSR(A, &ia[0], &ja[0], NULL);ERRCHK();
+	}
+	else{
+		Error::code=MatCreateSeqAIJ(PETSC_COMM_SELF,nnode(),nnode(),0,NULL,&A);ERRCHK();
+	}
 	Error::code=MatSetOption(A, MAT_ROW_ORIENTED, PETSC_FALSE);ERRCHK();
-	Error::code=MatSetOption(A, MAT_NEW_NONZERO_LOCATIONS, PETSC_TRUE);ERRCHK();
-	j = 1;
-	for (list<eleblank*>::iterator i = begele() ; i != endele() ; i++){
-		matloc.ones();
-		matloc *= j;
-		Error::code=MatSetValues(A ,(*i)->nNode(),(*i)->idxGlob().memptr()
-								 ,(*i)->nNode(),(*i)->idxGlob().memptr()
-								 ,matloc.memptr(),ADD_VALUES);ERRCHK();
-		j++;
+	if (!csr){
+		Error::code=MatZeroEntries(A);ERRCHK();
+		Error::code=MatSetOption(A, MAT_NEW_NONZERO_LOCATIONS, PETSC_TRUE);ERRCHK();
+		j = 1;
+		for (list<eleblank*>::iterator i = begele() ; i != endele() ; i++){
+			matloc.ones();
+			matloc *= j;
+			Error::code=MatSetValues(A ,(*i)->nNode(),(*i)->idxGlob().memptr()
+									 ,(*i)->nNode(),(*i)->idxGlob().memptr()
+									 ,matloc.memptr(),ADD_VALUES);ERRCHK();
+			j++;
+		}
+		Error::code=MatAssemblyBegin(A, MAT_FINAL_ASSEMBLY);ERRCHK();
+		Error::code=MatAssemblyEnd(A, MAT_FINAL_ASSEMBLY);ERRCHK();
 	}
-	Error::code=MatAssemblyBegin(A, MAT_FINAL_ASSEMBLY);ERRCHK();
-	Error::code=MatAssemblyEnd(A, MAT_FINAL_ASSEMBLY);ERRCHK();
 	Error::code=MatSetOption(A, MAT_NEW_NONZERO_LOCATIONS , PETSC_FALSE);ERRCHK();
 	Error::code=MatSetOption(A, MAT_NEW_NONZERO_LOCATION_ERR , PETSC_TRUE);ERRCHK();
 	Error::code=MatSetOption(A, MAT_KEEP_NONZERO_PATTERN, PETSC_TRUE);ERRCHK();
+	if ( geo && !set && (nrank_ == 1) ){
+		//the rows by node position
+		int nc;
+		const int *c;
+		geo->ia.assign(1, 0);
+		geo->ja.clear();
+		for (vector<Node>::iterator i = begnode() ; i < endnode() ; i++){
+			Error::code=MatGetRow(A, i->idx, &nc, &c, NULL);ERRCHK();
+			for (int k = 0 ; k < nc ; k++) geo->ja.push_back( vnodeidx_.at(c[k]) - &vnode_[0] );
+			Error::code=MatRestoreRow(A, i->idx, &nc, &c, NULL);ERRCHK();
+			geo->ia.push_back(geo->ja.size());
+		}
+	}
 
 	//create the bvertices
-	for ( list<BVertexCQ*>::iterator i = begbvertex() ; i != endbvertex() ; i++)
-		(*i)->constructGeoParams(dp, A, grav);
+	if (set){
+		for ( list<BVertexCQ*>::iterator i = begbvertex() ; i != endbvertex() ; i++){
+			const int b = bpos.at(*i), pre = geo->bnb.at(2*b), next = geo->bnb.at(2*b+1);
+			(*i)->setGeoParams(&geo->bvx.at(BVertexCQ::nGeo * b),
+							   ( pre < 0 ? (Node*)NULL : &vnode_.at(pre) ),
+							   ( next < 0 ? (Node*)NULL : &vnode_.at(next) ), dp, A);
+		}
+	}
+	else{
+		for ( list<BVertexCQ*>::iterator i = begbvertex() ; i != endbvertex() ; i++)
+			(*i)->constructGeoParams(dp, A, grav);
+		if (geo){
+			geo->bnb.assign(2 * bpos.size(), -1);
+			geo->bvx.assign(BVertexCQ::nGeo * bpos.size(), 0);
+			for ( list<BVertexCQ*>::iterator i = begbvertex() ; i != endbvertex() ; i++){
+				const int b = bpos.at(*i);
+				if ((*i)->pre()) geo->bnb[2*b] = (*i)->pre() - &vnode_[0];
+				if ((*i)->next()) geo->bnb[2*b+1] = (*i)->next() - &vnode_[0];
+				(*i)->geoParams(&geo->bvx[BVertexCQ::nGeo * b]);
+			}
+		}
+	}
 	
 	FuncEnd(); 
 } 
 
-Mesh::Mesh():ndupldata_(0){}
+Mesh::Mesh():ndupldata_(0), nownnode_(0),
+			lele_end_(lele_ptr_.end()), lbvertex_end_(lbvertex_ptr_.end()),
+			comm_(PETSC_COMM_SELF), rank_(0), nrank_(1){}
 
 Mesh::~Mesh(){ 
 	FuncBegin(); 
-	for ( list<BVertexCQ*>::iterator i = begbvertex() ; i != endbvertex() ; i++)
+	for ( list<BVertexCQ*>::iterator i = begbvertex() ; i != endbvertexall() ; i++)
 		if (*i) delete (*i);
-	for ( list<eleblank*>::iterator i = begele() ; i != endele() ; i++)
+	for ( list<eleblank*>::iterator i = begele() ; i != endeleall() ; i++)
 		if (*i) delete (*i);
 	for ( list<Region*>::iterator i = begreg() ; i != endreg() ; i++)
 		if (*i) delete (*i);
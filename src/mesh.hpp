@@ -15,8 +15,27 @@
 #include "jkfunc.hpp"
 #include <list>
 #include <vector>
+#include <unordered_map>
 #include <petscmat.h>
 
+/** @brief what Mesh::constructGeoParams finds from the nodes, elements and regions.
+
+	It is kept in the mesh image, so that a run on the same mesh sets it
+	instead of finding it again. Everything is in the order the nodes,
+	elements and bvertices were added, so it does not depend on how the mesh
+	is partitioned.
+	@ingroup mesh_module
+ */
+struct MeshGeo{
+	std::vector<int> ndd;    /**< @brief number of dupldata of each node */
+	std::vector<int> dreg;   /**< @brief Region::idx of each dupldata, node after node */
+	std::vector<double> ele; /**< @brief Element::geoParams of each element, one after the other */
+	std::vector<int> bnb;    /**< @brief position of the pre and next node of each bvertex, -1 for none */
+	std::vector<double> bvx; /**< @brief BVertexCQ::geoParams of each bvertex */
+	std::vector<int> ia;     /**< @brief first nonzero of each row of A, by node position, and nnz; or empty */
+	std::vector<int> ja;     /**< @brief column of each nonzero of A, by node position */
+};
+
 /** @brief all mesh data in one class.
 	@ingroup mesh_module
  */
@@ -25,14 +44,61 @@ protected:
 	std::list<BVertexCQ*> lbvertex_ptr_; /**< @brief polymorphic list storing bvertices */
 	std::list<eleblank*> lele_ptr_;      /**< @brief polymorphic list storing elements */
 	std::list<Region*> lreg_ptr_;        /**< @brief polymorphic list storing regions  */
+	std::unordered_map<int, Region*> regid_; /**< @brief regions by ID, the first one added for each ID */
 	std::vector<Node> vnode_;            /**< @brief normal list storing nodes         */
 	int ndupldata_;                      /**< @brief number of dupldata */
+	std::vector<Node*> vnodeidx_;        /**< @brief nodes sorted by idx */
+	std::vector<Node*> vlnode_;          /**< @brief owned nodes followed by ghost nodes */
+	int nownnode_;                       /**< @brief number of owned nodes */
+	std::list<eleblank*>::iterator lele_end_;      /**< @brief first element of other processes */
+	std::list<BVertexCQ*>::iterator lbvertex_end_; /**< @brief first bvertex of other processes */
+	std::vector<int> rrange_;            /**< @brief first node idx of each process, and nnode at the end */
+	std::vector<int> partnode_;          /**< @brief first inner node of each partition in the owned nodes,
+											then the first interface node and nownnode */
+	std::vector<std::list<eleblank*>::iterator> partele_; /**< @brief first element of each partition, and endele */
+	MPI_Comm comm_;                      /**< @brief communicator the mesh is distributed on */
+	int rank_;                           /**< @brief rank of this process in comm_ */
+	int nrank_;                          /**< @brief size of comm_ */
 
 	/** @brief find a region from ID.
 		@param regid id of the region
 		@returns pointer to the region
 	*/
 	Region* findRegion(const int regid);
+	/** @brief gives the nodes in pos[b,e) to np processes starting from p0.
+		Recursive coordinate bisection: the nodes are split at the median of
+		their longer side, in proportion to the number of processes on each side.
+		@param part output, the process of each node (by position)
+	*/
+	void bisect(std::vector<int> &pos, const int b, const int e,
+				const int p0, const int np, std::vector<int> &part);
+	/** @brief renumbers the nodes, so that each process owns a contiguous range of idx.
+		Must be called before the elements find their idxGlob.
+	*/
+	void partition();
+	/** @brief moves the elements and bvertices of other processes to the end of
+		their lists and finds the ghost nodes.
+
+		An element belongs to the process owning its node with the smallest idx
+		and a bvertex to the process owning its node. The ghost nodes are the
+		nodes of other processes that share an element with an owned node.
+		@note every process still keeps the whole mesh, the elements and
+		bvertices of the others are only used for the output.
+	*/
+	void distribute();
+	/** @brief splits the elements into np partitions for threads and renumbers the nodes.
+
+		The partitions are grown one after the other by a breadth first search
+		over the element dual graph (elements sharing a node), starting from a
+		peripheral element, and each one starts from the front of the last. The
+		elements are sorted by partition. The inner nodes of each partition get
+		contiguous idx in the order they are met, and the interface nodes, which
+		touch more than one partition, are numbered after all of them. Must be
+		called before the DuplData idx are set.
+	*/
+	void partitionElements(const int np);
+	/** @brief process owning a node idx */
+	int owner(const int idx) const;
 public:
 	/** @brief bvertex size */
 	int nbvertex() const                 
@@ -50,6 +116,48 @@ public:
 	int ndd() const                      
 		{ return ndupldata_; }
 	
+	/** @brief node with a given idx */
+	Node& node(const int idx)
+		{ return *vnodeidx_.at(idx); }
+	/** @brief first owned node */
+	std::vector<Node*>::iterator begownnode()
+		{ return vlnode_.begin(); }
+	/** @brief last owned node, which is also the first ghost node */
+	std::vector<Node*>::iterator endownnode()
+		{ return vlnode_.begin() + nownnode_; }
+	/** @brief last ghost node */
+	std::vector<Node*>::iterator endghostnode()
+		{ return vlnode_.end(); }
+	/** @brief number of owned nodes */
+	int nownnode() const
+		{ return nownnode_; }
+	/** @brief first owned node idx */
+	int rstart() const
+		{ return rrange_.at(rank_); }
+	/** @brief last owned node idx + 1 */
+	int rend() const
+		{ return rrange_.at(rank_+1); }
+	/** @brief rank of this process */
+	int rank() const
+		{ return rank_; }
+	/** @brief number of processes */
+	int nrank() const
+		{ return nrank_; }
+	/** @brief number of element partitions (threads) */
+	int npart() const
+		{ return partele_.size() - 1; }
+	/** @brief first element of partition p */
+	std::list<eleblank*>::iterator begpartele(const int p)
+		{ return partele_.at(p); }
+	/** @brief last element of partition p */
+	std::list<eleblank*>::iterator endpartele(const int p)
+		{ return partele_.at(p+1); }
+	/** @brief position of the first inner node of partition p in the owned nodes.
+		The inner nodes of p end at partnode(p+1), partnode(npart()) is the first
+		interface node and partnode(npart()+1) is nownnode().
+	*/
+	int partnode(const int p) const
+		{ return partnode_.at(p); }
 	/** @brief first bvertex */
 	std::list<BVertexCQ*>::iterator begbvertex()    
 		{ return lbvertex_ptr_.begin(); }
@@ -63,11 +171,17 @@ public:
 	std::vector<Node>::iterator begnode()            
 		{ return vnode_.begin(); }
 
-	/** @brief last bvertex */
+	/** @brief last bvertex owned by this process */
 	std::list<BVertexCQ*>::iterator endbvertex()   
+		{ return lbvertex_end_; }
+	/** @brief last bvertex of all processes */
+	std::list<BVertexCQ*>::iterator endbvertexall()
 		{ return lbvertex_ptr_.end(); }
-	/** @brief last ele */
+	/** @brief last ele owned by this process */
 	std::list<eleblank*>::iterator endele()        
+		{ return lele_end_; }
+	/** @brief last ele of all processes */
+	std::list<eleblank*>::iterator endeleall()
 		{ return lele_ptr_.end(); }
 	/** @brief last region */
 	std::list<Region*>::iterator endreg()          
@@ -98,6 +212,17 @@ public:
 		       used to generate error if anything goes wrong. is optional.
 	*/
 	void addElement(const int regid, const int ndidx[], const CellType celltype, const int linenumber= -1);
+	/** @brief add n elements or bvertices of the same region and type.
+
+		The region is found once for all of them.
+		@param regid ID of the region the elements belong to
+		@param ndidx index of corner nodes, celltype of them for each element
+		@param celltype type of the cells
+		@param n number of elements
+		@param linenumber same as for addElement
+	*/
+	void addElements(const int regid, const int ndidx[], const CellType celltype, const int n,
+					 const int linenumber= -1);
 	/** @brief add a region.
 		
 		@param regionpointer pointer to the newly added region.
@@ -109,9 +234,18 @@ public:
 	   @param dp dimensionless p number
 	   @param A a petsc matrix, the matrix should be null before call,
 	   after the call the matrix will be fully defined.
+	   @param comm if it has more than one process, the nodes are partitioned
+	   and A is a distributed matrix. Only the bvertices of this process are
+	   constructed.
+	   @param npart number of element partitions for threads, only used on one process.
+	   @param geo if it is not empty, the dupldata, the element and bvertex
+	   parameters and the sparsity of A are set from it instead of found.
+	   Else it is filled with them, which is only complete on one process.
 	*/
 	void constructGeoParams(const RegionPointerComparer& cmp,
-							const double dp, Mat &A, const Gravity &grav);
+							const double dp, Mat &A, const Gravity &grav,
+							MPI_Comm comm = PETSC_COMM_SELF, const int npart = 1,
+							MeshGeo *geo = NULL);
 	/** @brief sets ndupldata_ to zero */
 	Mesh();
 	/** @brief frees memory */
@@ -0,0 +1,100 @@
+/** @file parsebench.cpp
+	.cpp file of df2d-parsebench, which measures how fast AsciiFile and MapFile
+	read a file.
+
+	Usage: df2d-parsebench <file> [threads]
+
+	Every field of every line that is not a comment is read as a double, first
+	with AsciiFile, then with MapFile and then with MapFile on the given number
+	of threads, the way the mesh readers split a section. The speeds are
+	printed in MB/s of the file.
+*/
+
+#include "asciifile.hpp"
+#include "mapfile.hpp"
+#include "threadpool.hpp"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <sys/stat.h>
+
+/** @brief seconds since t0 */
+static double since(const std::chrono::steady_clock::time_point &t0){
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+/** @brief prints one result */
+static void report(const char *name, const double mb, const double s, const long n, const double sum){
+	std::cout << std::left << std::setw(20) << name << std::right
+			  << std::setw(10) << std::fixed << std::setprecision(1) << mb / s << " MB/s"
+			  << std::setw(12) << std::setprecision(3) << s << " s"
+			  << std::setw(14) << n << " fields"
+			  << "   sum " << std::scientific << std::setprecision(10) << sum << std::endl;
+}
+
+/** The main function. */
+int main(int argc, char *argv[]){
+	FuncBegin();
+
+	struct stat st;
+	long n;
+	double x, sum, mb;
+	std::chrono::steady_clock::time_point t0;
+
+	if ( (argc < 2) || (stat(argv[1], &st) != 0) ){
+		std::cout << "Usage: " << argv[0] << " <file> [threads]" << std::endl;
+		return 1;
+	}
+	const int np = ( argc > 2 ? std::max(atoi(argv[2]), 1) : 4 );
+	mb = st.st_size / 1048576.;
+
+	//AsciiFile
+	{
+		AsciiFile fl;
+		n = 0; sum = 0;
+		t0 = std::chrono::steady_clock::now();
+		fl.open(argv[1]);
+		while (fl.next())
+			while (fl.ss >> x){ sum += x; n++; }
+		fl.close();
+		report("AsciiFile", mb, since(t0), n, sum);
+	}
+	//MapFile
+	{
+		MapFile fl;
+		n = 0; sum = 0;
+		t0 = std::chrono::steady_clock::now();
+		fl.open(argv[1]);
+		while (fl.next())
+			while (fl.ls(x)){ sum += x; n++; }
+		fl.close();
+		report("MapFile", mb, since(t0), n, sum);
+	}
+	//MapFile on threads
+	{
+		MapFile fl;
+		std::vector<MapLine> lines;
+		std::vector<long> nt(np, 0);
+		std::vector<double> st(np, 0);
+		ThreadPool pool(np);
+		n = 0; sum = 0;
+		t0 = std::chrono::steady_clock::now();
+		fl.open(argv[1]);
+		while (fl.next()) lines.push_back(fl.ls);
+		pool.run([&](const int t){
+			const long nl = lines.size();
+			double y;
+			for (long i = nl * t / np ; i < nl * (t+1) / np ; i++)
+				while (lines[i](y)){ st[t] += y; nt[t]++; }
+		});
+		fl.close();
+		for (int t = 0 ; t < np ; t++){ sum += st[t]; n += nt[t]; }
+		std::stringstream name;
+		name << "MapFile, " << np << " threads";
+		report(name.str().c_str(), mb, since(t0), n, sum);
+	}
+	return 0;
+
+	FuncEnd();
+}
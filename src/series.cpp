@@ -0,0 +1,289 @@
+/** @file series.cpp
+ * cpp file for series.hpp.
+ * Part of DF_2d.
+ */
+
+#include "series.hpp"
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/** @brief first bytes of <base>.dts */
+static const char seriesmagic[8] = {'d','f','2','d','t','s','1','\0'};
+
+/** @brief a field as it is in the header of <base>.dts */
+struct FieldRecord{
+	char name[16];
+	int32_t dim, nodal, esize, n;
+	double tol;
+};
+
+/** @brief the start of a frame in <base>.dts, a count per field follows */
+struct FrameRecord{
+	int32_t nFile, key;
+	double t;
+};
+
+/** @brief true if component j of a and b differ by more than tol */
+static bool changed(const char *a, const char *b, const int esize, const int j, const double tol){
+	if (esize == 8){
+		const double x = ((const double*)a)[j], y = ((const double*)b)[j];
+		return ( tol > 0 ? !(std::fabs(x - y) <= tol) : (x != y) );
+	}
+	const float x = ((const float*)a)[j], y = ((const float*)b)[j];
+	return ( tol > 0 ? !(std::fabs(x - y) <= tol) : (x != y) );
+}
+
+Series::Series():npts(0), nele(0), nmix(0), head_(0){}
+
+bool Series::open(const std::string &base){
+	FuncBegin();
+
+	std::ifstream fl;
+	char mg[8];
+	int32_t sz[4];
+	struct stat st;
+	FieldRecord r;
+
+	base_ = base;
+	fld.clear();
+	frm.clear();
+	fl.open(dts().c_str(), std::ios::binary);
+	if (!fl.is_open()) return false;
+	fl.read(mg, sizeof(mg));
+	fl.read((char*)sz, sizeof(sz));
+	if ( !fl.good() || memcmp(mg, seriesmagic, sizeof(mg)) ){
+		Error::mess << dts() << " is not a series of outputs.";
+		ERRSET();
+	}
+	npts = sz[0]; nele = sz[1]; nmix = sz[2];
+	fld.resize(sz[3]);
+	for (size_t k = 0 ; k < fld.size() ; k++){
+		fl.read((char*)&r, sizeof(r));
+		r.name[15] = '\0';
+		fld[k].name = r.name;
+		fld[k].dim = r.dim; fld[k].nodal = r.nodal; fld[k].esize = r.esize; fld[k].n = r.n;
+		fld[k].tol = r.tol;
+		fld[k].v = NULL;
+		if ( !fl.good() || ( (r.esize != 4) && (r.esize != 8) ) || (r.n < 0) ){
+			Error::mess << dts() << " is damaged.";
+			ERRSET();
+		}
+	}
+	head_ = fl.tellg();
+	fl.close();
+
+	//the index, without a frame that was not written completely
+	fl.open(dti().c_str(), std::ios::binary);
+	if (fl.is_open() && (stat(dts().c_str(), &st) == 0)){
+		Frame f;
+		while (fl.read((char*)&f, sizeof(f)) && (f.off >= head_) && (f.off + f.size <= st.st_size))
+			frm.push_back(f);
+	}
+	return true;
+
+	FuncEnd();
+}
+
+int Series::find(const int nFile) const{
+	for (size_t i = 0 ; i < frm.size() ; i++)
+		if (frm[i].nFile == nFile) return i;
+	return -1;
+}
+
+void Series::read(const int i, std::vector< std::vector<char> > &f){
+	FuncBegin();
+
+	std::ifstream fl;
+	FrameRecord fr;
+	uint32_t cnt, idx;
+	int k0 = i;
+
+	if ( (i < 0) || (i >= (int)frm.size()) ){
+		Error::mess << dts() << " has no frame " << i;
+		ERRSET();
+	}
+	//the keyframe before it, then the deltas up to it
+	while ( (k0 > 0) && !frm[k0].key ) k0--;
+	fl.open(dts().c_str(), std::ios::binary);
+	f.resize(fld.size());
+	for (int j = k0 ; j <= i ; j++){
+		fl.seekg(frm[j].off);
+		fl.read((char*)&fr, sizeof(fr));
+		for (size_t k = 0 ; fl.good() && (k < fld.size()) ; k++){
+			const int es = fld[k].esize;
+			fl.read((char*)&cnt, sizeof(cnt));
+			if (fr.key){
+				f[k].resize((size_t)fld[k].n * es);
+				if (cnt != (uint32_t)fld[k].n){
+					fl.setstate(std::ios::failbit);
+					break;
+				}
+				fl.read(f[k].data(), f[k].size());
+			}
+			else for (uint32_t c = 0 ; fl.good() && (c < cnt) ; c++){
+				fl.read((char*)&idx, sizeof(idx));
+				if ( (idx >= (uint32_t)fld[k].n) || (f[k].size() != (size_t)fld[k].n * es) ){
+					fl.setstate(std::ios::failbit);
+					break;
+				}
+				fl.read(&f[k][(size_t)idx * es], es);
+			}
+		}
+		if ( !fl.good() || (fr.nFile != frm[j].nFile) || ( (j == k0) && !fr.key ) ){
+			Error::mess << dts() << " is damaged at output " << frm[j].nFile;
+			ERRSET();
+		}
+	}
+
+	FuncEnd();
+}
+
+SeriesWriter::SeriesWriter(const std::string &base, const int key, const int nFile,
+						   const int np, const int ne, const int nm):key_(key), nkey_(-1){
+	FuncBegin();
+
+	int i;
+
+	base_ = base;
+	if ( (nFile != 0) && open(base) ){
+		if ( (npts != np) || (nele != ne) || (nmix != nm) ){
+			Error::mess << dts() << " was written for another mesh, remove it to start over.";
+			ERRSET();
+		}
+		//drop the frames from nFile on, e.g. of a run that is solved again
+		for (i = 0 ; (i < (int)frm.size()) && (frm[i].nFile < nFile) ; i++);
+		frm.resize(i);
+	}
+	else frm.clear();
+
+	if (frm.empty()){
+		//start over, the header is written with the first frame
+		fld.clear();
+		unlink(dts().c_str());
+		unlink(dti().c_str());
+	}
+	else{
+		if ( (truncate(dts().c_str(), frm.back().off + frm.back().size) != 0) ||
+			 (truncate(dti().c_str(), frm.size() * sizeof(Frame)) != 0) ){
+			Error::mess << dts() << " could not be truncated.";
+			ERRSET();
+		}
+		read(frm.size() - 1, last_);
+		for (nkey_ = 0 ; !frm[frm.size() - 1 - nkey_].key ; nkey_++);
+	}
+	npts = np; nele = ne; nmix = nm;
+
+	FuncEnd();
+}
+
+bool SeriesWriter::write(const int nFile, const double t, const std::vector<SeriesField> &f){
+	FuncBegin();
+
+	std::ofstream fl;
+	std::vector< std::vector<uint32_t> > ch(f.size());
+	size_t nbkey = 0, nbdelta = 0;
+	struct stat st;
+	FrameRecord r;
+	Frame fr;
+	uint32_t cnt;
+	bool key;
+
+	//a new series gets its header
+	if (fld.empty()){
+		const int32_t sz[4] = {npts, nele, nmix, (int32_t)f.size()};
+		fl.open(dts().c_str(), std::ios::binary | std::ios::trunc);
+		fl.write(seriesmagic, sizeof(seriesmagic));
+		fl.write((const char*)sz, sizeof(sz));
+		for (size_t k = 0 ; k < f.size() ; k++){
+			FieldRecord h;
+			memset(&h, 0, sizeof(h));
+			strncpy(h.name, f[k].name.c_str(), sizeof(h.name) - 1);
+			h.dim = f[k].dim; h.nodal = f[k].nodal; h.esize = f[k].esize; h.n = f[k].n;
+			h.tol = f[k].tol;
+			fl.write((const char*)&h, sizeof(h));
+		}
+		head_ = fl.tellp();
+		fl.close();
+		std::ofstream fi(dti().c_str(), std::ios::binary | std::ios::trunc);
+		fi.close();
+		if (fl.fail() || fi.fail()){
+			Error::mess << dts() << " could not be written.";
+			ERRSET();
+		}
+		fld = f;
+		for (size_t k = 0 ; k < fld.size() ; k++) fld[k].v = NULL;
+		last_.assign(f.size(), std::vector<char>());
+		nkey_ = -1;
+	}
+	if (f.size() != fld.size()){
+		Error::mess << dts() << " has " << fld.size() << " fields, output " << nFile << " has " << f.size();
+		ERRSET();
+	}
+	for (size_t k = 0 ; k < f.size() ; k++){
+		if ( (f[k].n != fld[k].n) || (f[k].esize != fld[k].esize) || (f[k].name != fld[k].name) ){
+			Error::mess << dts() << ": field " << f[k].name << " of output " << nFile
+						<< " is not the same as in the first output";
+			ERRSET();
+		}
+	}
+
+	//the components that changed since the last frame
+	for (size_t k = 0 ; k < f.size() ; k++){
+		const int es = f[k].esize;
+		nbkey += sizeof(cnt) + (size_t)f[k].n * es;
+		if (nkey_ >= 0)
+			for (int j = 0 ; j < f[k].n ; j++)
+				if (changed((const char*)f[k].v, last_[k].data(), es, j, f[k].tol)) ch[k].push_back(j);
+		nbdelta += sizeof(cnt) + ch[k].size() * (sizeof(uint32_t) + es);
+	}
+	key = ( (nkey_ < 0) || (nkey_ + 1 >= key_) || (2 * nbdelta >= nbkey) );
+
+	//the frame, then its record in the index
+	fr.off = ( stat(dts().c_str(), &st) == 0 ? st.st_size : 0 );
+	fr.size = sizeof(r) + ( key ? nbkey : nbdelta );
+	fr.nFile = nFile;
+	fr.key = key;
+	fr.t = t;
+	r.nFile = nFile;
+	r.key = key;
+	r.t = t;
+	fl.open(dts().c_str(), std::ios::binary | std::ios::app);
+	fl.write((const char*)&r, sizeof(r));
+	for (size_t k = 0 ; k < f.size() ; k++){
+		const int es = f[k].esize;
+		const char *v = (const char*)f[k].v;
+		if (key){
+			cnt = f[k].n;
+			fl.write((const char*)&cnt, sizeof(cnt));
+			fl.write(v, (size_t)cnt * es);
+			last_[k].assign(v, v + (size_t)cnt * es);
+		}
+		else{
+			cnt = ch[k].size();
+			fl.write((const char*)&cnt, sizeof(cnt));
+			for (uint32_t c = 0 ; c < cnt ; c++){
+				const size_t j = (size_t)ch[k][c] * es;
+				fl.write((const char*)&ch[k][c], sizeof(uint32_t));
+				fl.write(v + j, es);
+				memcpy(&last_[k][j], v + j, es);
+			}
+		}
+	}
+	fl.close();
+	std::ofstream fi(dti().c_str(), std::ios::binary | std::ios::app);
+	fi.write((const char*)&fr, sizeof(fr));
+	fi.close();
+	if (fl.fail() || fi.fail()){
+		Error::mess << dts() << " could not be written.";
+		ERRSET();
+	}
+	frm.push_back(fr);
+	nkey_ = ( key ? 0 : nkey_ + 1 );
+	return key;
+
+	FuncEnd();
+}
@@ -0,0 +1,122 @@
+/** @file series.hpp
+ * Header file for the time series of outputs stored as keyframes and deltas.
+ * Part of DF_2d.
+ * @ingroup dr_module
+ */
+
+#ifndef SERIES_HPP
+#define SERIES_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "error.hpp"
+
+/** @ingroup dr_module
+ *  @brief A field of an output in a time series.
+ */
+struct SeriesField{
+	std::string name;  /**< @brief name, at most 15 characters */
+	int dim;           /**< @brief components of each value */
+	int nodal;         /**< @brief 1 for a value per point, 0 for one per cell */
+	int esize;         /**< @brief bytes of a component, 4 for float or 8 for double */
+	int n;             /**< @brief number of components */
+	double tol;        /**< @brief a component is stored if it changed by more than this */
+	const void *v;     /**< @brief the components, only used when writing */
+};
+
+/** @ingroup dr_module
+ *  @brief The layout of a time series: <base>.dts holds the frames and
+ *  <base>.dti an index of them.
+ *
+ * <base>.dts starts with the sizes of the mesh and the fields. A frame is a
+ * keyframe, all of its components, or a delta: the index and the value of
+ * the components that changed by more than the tolerance of their field
+ * since the frame before it. Each component is compared to its value in the
+ * reconstructed frame before, so the error of a frame is at most the
+ * tolerance, whatever the number of deltas since the keyframe.
+ *
+ * <base>.dti has a fixed size record for every frame, so any frame is found
+ * without reading the ones before it, and is rebuilt from the keyframe before
+ * it and the deltas in between.
+ */
+class Series{
+public:
+	/** @brief a frame, as it is in the index */
+	struct Frame{
+		int64_t off;   /**< @brief position of the frame in <base>.dts */
+		int64_t size;  /**< @brief its bytes */
+		int32_t nFile; /**< @brief output number */
+		int32_t key;   /**< @brief 1 for a keyframe */
+		double t;      /**< @brief time */
+	};
+
+	int npts;   /**< @brief points of the mesh of the visual files */
+	int nele;   /**< @brief cells of the mesh */
+	int nmix;   /**< @brief length of its xdmf mixed topology */
+	std::vector<SeriesField> fld;  /**< @brief the fields, v is not used */
+	std::vector<Frame> frm;        /**< @brief the frames */
+
+	/** Nothing open. */
+	Series();
+
+	/** Reads the header and the index of a series.
+		@param base the files are <base>.dts and <base>.dti
+		@returns false if there is no series
+	*/
+	bool open(const std::string &base);
+
+	/** Rebuilds a frame.
+		@param i index of the frame in frm
+		@param f output, the bytes of each field
+	*/
+	void read(const int i, std::vector< std::vector<char> > &f);
+
+	/** The index in frm of output nFile, -1 if it is not there. */
+	int find(const int nFile) const;
+
+	/** The name of the frames file, <base>.dts */
+	std::string dts() const { return base_ + ".dts"; }
+	/** The name of the index file, <base>.dti */
+	std::string dti() const { return base_ + ".dti"; }
+
+protected:
+	std::string base_;  /**< @brief the files are <base>.dts and <base>.dti */
+	int64_t head_;      /**< @brief size of the header of <base>.dts */
+};
+
+/** @ingroup dr_module
+ *  @brief Adds the outputs of a run to a Series.
+ *
+ * A keyframe is written every key frames, and also when a delta would not
+ * be smaller than half of a keyframe. The writer keeps the last frame as
+ * it is rebuilt, so a delta is found without reading the files.
+ */
+class SeriesWriter: public Series{
+	int key_;   /**< @brief a keyframe every key_ frames */
+	int nkey_;  /**< @brief frames since the last keyframe, -1 for none */
+	std::vector< std::vector<char> > last_;  /**< @brief the last frame, as read() would rebuild it */
+public:
+	/** Opens a series to add outputs to.
+		The frames from output nFile on, e.g. of a run that stopped after
+		them, are removed; with nFile 0 the series starts over.
+		@param base the files are <base>.dts and <base>.dti
+		@param key a keyframe every key frames
+		@param nFile the first output that will be written
+		@param npts points of the mesh
+		@param nele cells of the mesh
+		@param nmix length of the xdmf mixed topology of the mesh
+	*/
+	SeriesWriter(const std::string &base, const int key, const int nFile,
+				 const int npts, const int nele, const int nmix);
+
+	/** Adds an output. The fields must be the same for all the outputs.
+		@param nFile output number
+		@param t time
+		@param f the fields, with v set
+		@returns true if it was written as a keyframe
+	*/
+	bool write(const int nFile, const double t, const std::vector<SeriesField> &f);
+};
+
+#endif /*SERIES_HPP*/
@@ -0,0 +1,182 @@
+/** @file simexample.cpp
+	.cpp file of df2d-simexample, which runs a case folder through Simulator.
+
+	Usage: df2d-simexample [-df2d_dir <case folder>] [petsc options]
+
+	The regions, the fixed data and the mesh of the case are read into a
+	Simulator, as a program would set them from memory, and the initial file
+	is taken as the starting saturation. It is run twice from the same start,
+	once with step() and then runUntil(), and once after reset() with
+	runUntil() only, up to the time of the last restart file df2d wrote for
+	the case, e.g. after make bench2 in examples/bench2. S() is checked
+	against that restart file and P() against Pw of the .vtk file of the same
+	output. Returns 0 if both runs agree with df2d.
+*/
+
+#include "simulator.hpp"
+#include "error.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <iterator>
+
+/** @brief tolerance of S, the restart file has 12 digits */
+static const double stol = 1e-6;
+/** @brief relative tolerance of P, the .vtk file has floats */
+static const double ptol = 1e-5;
+
+/** @brief reads restart.n, the time it was written at and S of each node.
+	@returns false if there is no such file
+ */
+static bool read_restart(const std::string &adr, const int nnode, double &t, std::vector<double> &s){
+	FuncBegin();
+
+	std::ifstream fl(adr.c_str());
+	std::string ln;
+
+	if (!fl.is_open()) return false;
+	std::getline(fl, ln);
+	if ( (sscanf(ln.c_str(), "#Restart file @ time = %lf", &t) != 1) ||
+		 !std::getline(fl, ln) || !std::getline(fl, ln) ){
+		Error::mess << adr << " is not a restart file";
+		ERRSET();
+	}
+	s.resize(nnode);
+	for (int i = 0 ; i < nnode ; i++)
+		if (!(fl >> s[i])){
+			Error::mess << adr << " has fewer than " << nnode << " values";
+			ERRSET();
+		}
+	return true;
+
+	FuncEnd();
+}
+
+/** @brief reads the field name of a binary .vtk file written by visit_writer */
+static void read_vtk_field(const std::string &adr, const std::string &name, const int npts,
+						   std::vector<float> &f){
+	FuncBegin();
+
+	std::ifstream fl(adr.c_str(), std::ios::binary);
+	const std::string buf((std::istreambuf_iterator<char>(fl)), std::istreambuf_iterator<char>());
+	std::ostringstream head;
+	size_t pos;
+
+	head << "\n" << name << " 1 " << npts << " float\n";
+	pos = buf.find("POINT_DATA");
+	if (pos != std::string::npos) pos = buf.find(head.str(), pos);
+	if ( (pos == std::string::npos) || (pos + head.str().size() + 4 * (size_t)npts > buf.size()) ){
+		Error::mess << adr << " has no field " << name << " with " << npts << " points";
+		ERRSET();
+	}
+	//the floats are big-endian
+	const unsigned char *c = (const unsigned char*)buf.data() + pos + head.str().size();
+	f.resize(npts);
+	for (int i = 0 ; i < npts ; i++, c += 4){
+		const uint32_t u = ((uint32_t)c[0] << 24) | ((uint32_t)c[1] << 16) | ((uint32_t)c[2] << 8) | c[3];
+		memcpy(&f[i], &u, 4);
+	}
+
+	FuncEnd();
+}
+
+/** @brief compares S() and P() of sim with the output of df2d.
+	@returns true if both are within the tolerances
+ */
+static bool check(Simulator &sim, const char *what, const std::vector<double> &sref,
+				  const std::vector<float> &pref){
+	FuncBegin();
+
+	const int n = (int)sref.size();
+	const bool dupl = (sim.data().visualduplicate == 0);
+	double ds = 0, dp = 0, pm = 0;
+
+	for (int i = 0 ; i < n ; i++){
+		const double p = pref[ dupl ? sim.sIdx(i) : sim.pIdx(i) ];
+		ds = fmax(ds, fabs(sim.S()[sim.sIdx(i)] - sref[i]));
+		dp = fmax(dp, fabs(sim.P()[sim.pIdx(i)] - p));
+		pm = fmax(pm, fabs(p));
+	}
+	dp /= fmax(pm, 1e-300);
+	std::cout << what << ": t = " << sim.time() << " max |S - S_df2d| = " << ds
+			  << " max |P - P_df2d| / max |P_df2d| = " << dp << std::endl;
+	return (ds <= stol) && (dp <= ptol);
+
+	FuncEnd();
+}
+
+/** The main function. */
+int main(int argc, char *argv[]){
+	FuncBegin();
+
+	MData md;
+	std::vector<double> s0, sref, s1;
+	std::vector<float> pref;
+	double t0, tref = 0;
+	int n, nstep = 0;
+	bool ok = true;
+
+	//petsc with petsc.config of the case, as df2d starts
+	driver::initialize(&argc, &argv, md);
+	{
+		Simulator sim;
+		MData &d = sim.data();
+		d.dir = md.dir;
+
+		//the case, into memory
+		driver::readregion(d, sim.mesh());
+		driver::readfixed(d);
+		driver::readmeshfile(d, sim.mesh());
+		sim.setup();
+		driver::readinitial(d, sim.mesh());
+		t0 = sim.time();
+		s0.resize(sim.mesh().nnode());
+		for (int i = 0 ; i < (int)s0.size() ; i++) s0[i] = sim.S()[sim.sIdx(i)];
+
+		//the last output of df2d
+		for (n = d.nFile + d.NFile ; n > d.nFile ; n--){
+			std::ostringstream ss;
+			ss << d.dir << "restart/restart." << n;
+			if (read_restart(ss.str(), (int)s0.size(), tref, sref)) break;
+		}
+		if (n == d.nFile){
+			Error::mess << "no restart file in " << d.dir << "restart/, run df2d on the case first";
+			ERRSET();
+		}
+		{
+			std::ostringstream ss;
+			ss << d.dir << "result/result." << n << ".vtk";
+			read_vtk_field(ss.str(), "Pw", ( d.visualduplicate == 0 ? sim.mesh().ndd() : sim.mesh().nnode() ),
+						   pref);
+		}
+		std::cout << "Comparing with output " << n << " of df2d at t = " << tref << std::endl;
+
+		//run 1: a few steps, then up to the output
+		sim.reset(&s0[0], t0);
+		while ( (nstep < 10) && (sim.time() + d.dt < tref) && sim.step() ) nstep++;
+		sim.runUntil(tref);
+		ok = check(sim, "step() and runUntil()", sref, pref) && ok;
+		s1.assign(sim.S().begin(), sim.S().end());
+
+		//run 2: the same start again
+		sim.reset(&s0[0], t0);
+		sim.runUntil(tref);
+		ok = check(sim, "reset() and runUntil()", sref, pref) && ok;
+		for (size_t i = 0 ; i < s1.size() ; i++)
+			if (fabs(s1[i] - sim.S()[i]) > stol){
+				std::cout << "The two runs differ at S index " << i << std::endl;
+				ok = false;
+				break;
+			}
+	}
+	std::cout << (ok ? "Simulator agrees with df2d." : "Simulator does NOT agree with df2d.") << std::endl;
+
+	md.finalize();
+	PetscFinalize();
+	return (ok ? 0 : 1);
+	FuncEnd();
+}
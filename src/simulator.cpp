@@ -0,0 +1,161 @@
+/** @file simulator.cpp
+	.cpp file for the Simulator class.
+*/
+
+#include "simulator.hpp"
+#include "error.hpp"
+#include <cmath>
+#include <algorithm>
+
+int Simulator::nsim_ = 0;
+bool Simulator::petsc_ = false;
+
+Simulator::Simulator(int *argc, char **argv[]):ready_(false), dt0_(0), tEnd0_(0), dtM0_(0),
+												sImpDsM0_(0), ltsMax0_(1), sscheme0_(MData::SEuler){
+	FuncBegin();
+
+	PetscBool init;
+
+	md_.initialize();
+	Error::code=PetscInitialized(&init);ERRCHK();
+	if (init == PETSC_FALSE){
+		Error::code=PetscInitialize(argc, argv, NULL, NULL);ERRCHK();
+		petsc_ = true;
+	}
+	driver::readoptions(md_);
+	md_.quiet = 1;
+	nsim_++;
+
+	FuncEnd();
+}
+
+Simulator::~Simulator(){
+	md_.finalize();
+	nsim_--;
+}
+
+void Simulator::addRegion(Region *reg){
+	FuncBegin();
+	msh_.addRegion(reg);
+	FuncEnd();
+}
+
+void Simulator::reserveNodes(const int n){
+	FuncBegin();
+	msh_.reserveNodes(n);
+	FuncEnd();
+}
+
+void Simulator::addNode(const double x, const double y){
+	FuncBegin();
+	msh_.addNode(x, y, msh_.nnode());
+	FuncEnd();
+}
+
+void Simulator::addElement(const int regid, const int nd[], const CellType c){
+	FuncBegin();
+	msh_.addElement(regid, nd, c);
+	FuncEnd();
+}
+
+void Simulator::setup(){
+	FuncBegin();
+
+	if (ready_){
+		Error::mess << "Simulator::setup() was already called";
+		ERRSET();
+	}
+	if (!md_.J){
+		Error::mess << "Simulator::setup() needs the J model, data().J";
+		ERRSET();
+	}
+	msh_.constructGeoParams(md_.J->cmp, md_.dp, md_.A, md_.grav, md_.comm, md_.nthread);
+	md_.S.resize(msh_.ndd(), 0);
+	driver::allocdata(md_, msh_);
+	dt0_ = md_.dt;
+	tEnd0_ = md_.tEnd;
+	dtM0_ = md_.dtM;
+	sImpDsM0_ = md_.sImpDsM;
+	ltsMax0_ = md_.ltsMax;
+	sscheme0_ = md_.sscheme;
+	ready_ = true;
+
+	FuncEnd();
+}
+
+void Simulator::reset(const double *s0, const double t0){
+	FuncBegin();
+
+	if (!ready_){
+		Error::mess << "Simulator::setup() must be called before reset()";
+		ERRSET();
+	}
+	for (std::vector<Node>::iterator i = msh_.begnode() ; i < msh_.endnode() ; i++)
+		md_.S.at(i->dd.front().idx) = s0[ i - msh_.begnode() ];
+	//the statistics of the last run
+	md_.t = t0;
+	md_.dt = dt0_;
+	md_.tStop = HUGE_VAL;
+	md_.qIn = md_.qOut = md_.qWin = md_.qWout = 0;
+	md_.nIt = md_.nPSolve = md_.nPFactor = md_.nStep = 0;
+	md_.nDtRej = md_.nDtLim = md_.nSNESIt = 0;
+	md_.dtE = md_.dtEOld = md_.dtNext = 0;
+	md_.cT = md_.dpT = 0;
+	md_.steadyState = MData::SteadyNo;
+	md_.steadyStep = 0;
+	md_.stRate = md_.stRateOld = 0;
+	std::fill(md_.stRates.begin(), md_.stRates.end(), 0);
+	std::fill(md_.stQWin.begin(), md_.stQWin.end(), 0);
+	std::fill(md_.stQWout.begin(), md_.stQWout.end(), 0);
+	//the settings the steady state of the last run changed
+	md_.tEnd = tEnd0_;
+	md_.dtM = dtM0_;
+	md_.sImpDsM = sImpDsM0_;
+	md_.ltsMax = ltsMax0_;
+	md_.sscheme = sscheme0_;
+	md_.ltsM = 1;
+	md_.ltsNFast = 0;
+	md_.LtP.clear();
+	driver::initdata(md_, msh_);
+
+	FuncEnd();
+}
+
+void Simulator::reset(const double s0, const double t0){
+	FuncBegin();
+	std::vector<double> s(msh_.nnode(), s0);
+	reset(&s[0], t0);
+	FuncEnd();
+}
+
+bool Simulator::step(){
+	FuncBegin();
+
+	if (md_.t >= md_.tEnd) return false;
+	md_.dt = fmin(md_.dt, md_.tEnd - md_.t);
+	driver::marchintime(md_, msh_);
+	return (md_.t < md_.tEnd) && (md_.steadyState != MData::SteadyDone);
+
+	FuncEnd();
+}
+
+void Simulator::runUntil(const double t){
+	FuncBegin();
+
+	md_.tStop = t;
+	while ( md_.t < t - 1e-12 * fabs(t) ){
+		md_.dt = fmin(md_.dt, t - md_.t);
+		driver::marchintime(md_, msh_);
+		if (md_.steadyState == MData::SteadyDone) break;
+	}
+	md_.tStop = HUGE_VAL;
+
+	FuncEnd();
+}
+
+void Simulator::finalize(){
+	if (petsc_ && (nsim_ == 0)){
+		PetscFinalize();
+		petsc_ = false;
+	}
+}
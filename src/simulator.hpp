@@ -0,0 +1,106 @@
+/** @file simulator.hpp
+	Header file for the Simulator class, df2d as a library.
+
+	Written as part of DF_2d.
+	@ingroup dr_module
+*/
+
+#ifndef SIMULATOR_HPP
+#define SIMULATOR_HPP
+
+#include "driver.hpp"
+
+/** @ingroup dr_module
+	@brief runs df2d from memory, for programs that call the solver many times.
+
+	The same steps as the df2d program, without reading files:
+	\li set the fixed data through data(): dm, dn, dp, grav, J and the time
+	stepping parameters (t, tEnd, dt, dtM, dtm, dsM, dsm, beta, dnItM).
+	\li add the regions, the nodes and the elements.
+	\li call setup() once, which finds the geometry, the sparsity of the p matrix
+	and creates the Petsc objects.
+	\li call reset() to start a run from a saturation field, then step() or
+	runUntil(). reset() can be called again for another run, and reuses all of
+	the above.
+
+	The -df2d_ options are read from the Petsc options database. Nothing is
+	written to files; the results are read through P() and S() without copying.
+	Errors are thrown as Error, the same as in the df2d program.
+ */
+class Simulator{
+	MData md_;           /**< @brief data of the runs */
+	Mesh msh_;           /**< @brief the mesh */
+	bool ready_;         /**< @brief setup() was called */
+	double dt0_;         /**< @brief dt at setup(), each run starts with it */
+	double tEnd0_,       /**< @brief tEnd at setup(), the steady state changes it */
+		dtM0_,           /**< @brief dtM at setup(), pseudo-transient continuation changes it */
+		sImpDsM0_;       /**< @brief sImpDsM at setup(), the same */
+	int ltsMax0_;        /**< @brief ltsMax at setup(), the same */
+	MData::SScheme sscheme0_; /**< @brief sscheme at setup(), the same */
+	static int nsim_;    /**< @brief number of Simulator objects alive */
+	static bool petsc_;  /**< @brief petsc was initialized by a Simulator */
+
+	/** @brief not copyable, the mesh holds pointers to itself */
+	Simulator(const Simulator&);
+	/** @brief not copyable */
+	Simulator& operator=(const Simulator&);
+public:
+	/** @brief initializes petsc, if the program has not, and reads the options.
+		@param argc,argv passed to PetscInitialize, may be NULL.
+	*/
+	Simulator(int *argc = NULL, char **argv[] = NULL);
+	/** @brief frees the Petsc objects, but does not finalize Petsc */
+	~Simulator();
+	/** @brief the fixed data, to be set before setup() */
+	MData& data()
+		{ return md_; }
+	/** @brief the mesh */
+	Mesh& mesh()
+		{ return msh_; }
+	/** @brief adds a region, the mesh deletes it */
+	void addRegion(Region *reg);
+	/** @brief reserves memory for n nodes */
+	void reserveNodes(const int n);
+	/** @brief adds a node, the nodes are numbered 0, 1, ... in the order they are added */
+	void addNode(const double x, const double y);
+	/** @brief adds an element, or a boundary edge for a boundary region.
+		@param regid ID of the region
+		@param nd numbers of the nodes, as they were added
+		@param c type of the cell
+	*/
+	void addElement(const int regid, const int nd[], const CellType c);
+	/** @brief finds the geometry and creates the p matrix and the solvers */
+	void setup();
+	/** @brief starts a new run at time t0.
+		@param s0 saturation of each node, in the order the nodes were added. The
+		saturation of the other regions at a node is found from the J curve.
+	*/
+	void reset(const double *s0, const double t0);
+	/** @brief starts a new run at time t0 with a uniform saturation */
+	void reset(const double s0, const double t0);
+	/** @brief takes one time step.
+		@returns false if tEnd is reached.
+	*/
+	bool step();
+	/** @brief marches until time t, the last step is shortened to end at t */
+	void runUntil(const double t);
+	/** @brief the current time */
+	double time() const
+		{ return md_.t; }
+	/** @brief pressure, indexed by the idx of the nodes */
+	const double* P() const
+		{ return md_.P; }
+	/** @brief saturation, indexed by the idx of the DuplData of the nodes */
+	const std::vector<double>& S() const
+		{ return md_.S; }
+	/** @brief idx in P() of node i, in the order they were added */
+	int pIdx(const int i)
+		{ return msh_.begnode()[i].idx; }
+	/** @brief idx in S() of the master saturation of node i, in the order they were added */
+	int sIdx(const int i)
+		{ return msh_.begnode()[i].dd.front().idx; }
+	/** @brief finalizes petsc, if a Simulator initialized it */
+	static void finalize();
+};
+
+#endif /*SIMULATOR_HPP*/
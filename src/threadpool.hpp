@@ -0,0 +1,101 @@
+/** @file threadpool.hpp
+ *  A fixed pool of threads that run one job per mesh partition.
+ *  Part of DF_2d.
+ * @ingroup dr_module
+ */
+
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include "error.hpp"
+
+/** @ingroup dr_module
+ * @brief runs f(0), ..., f(n-1) at the same time, f(0) on the calling thread.
+ *
+ * The threads are created once and wait between the jobs, so a job can be as
+ * short as one assembly loop. The workers are marked with Error::worker, so
+ * an error on them is not sent to PETSc: it is caught, the first one is kept
+ * in error() and run() returns false, so the caller can raise it on its own
+ * thread.
+ */
+class ThreadPool{
+	std::vector<std::thread> th_;         /**< @brief worker threads 1..n-1 */
+	std::mutex mx_;                       /**< @brief guards the fields below */
+	std::condition_variable cvjob_;       /**< @brief a new job or the end */
+	std::condition_variable cvdone_;      /**< @brief a worker finished its part */
+	std::function<void(int)> f_;          /**< @brief the current job */
+	long gen_;                            /**< @brief number of jobs given so far */
+	int nbusy_;                           /**< @brief workers still running the job */
+	bool failed_;                         /**< @brief a part of the job threw */
+	std::string error_;                   /**< @brief where and why the first worker failed */
+	bool stop_;                           /**< @brief the pool is being destroyed */
+
+	/** @brief loop of worker t */
+	void work(const int t){
+		long gen = 0;
+		Error::worker = true;
+		for (;;){
+			std::unique_lock<std::mutex> lk(mx_);
+			cvjob_.wait(lk, [&]{ return stop_ || (gen_ != gen); });
+			if (stop_) return;
+			gen = gen_;
+			lk.unlock();
+			bool ok = true;
+			try{ f_(t); }
+			catch(...){ ok = false; }
+			lk.lock();
+			if (!ok){
+				if (!failed_) error_ = Error::trace;
+				failed_ = true;
+			}
+			Error::trace.clear();
+			if (--nbusy_ == 0) cvdone_.notify_one();
+		}
+	}
+public:
+	/** @brief starts n-1 worker threads */
+	explicit ThreadPool(const int n):gen_(0), nbusy_(0), failed_(false), stop_(false){
+		for (int t = 1 ; t < n ; t++) th_.push_back( std::thread(&ThreadPool::work, this, t) );
+	}
+	/** @brief number of threads, including the calling one */
+	int size() const { return th_.size() + 1; }
+	/** @brief runs f(t) for every thread t and waits for all of them.
+		@returns false if any of them threw.
+	*/
+	bool run(const std::function<void(int)> &f){
+		bool ok = true;
+		{
+			std::lock_guard<std::mutex> lk(mx_);
+			f_ = f;
+			failed_ = false;
+			error_.clear();
+			nbusy_ = th_.size();
+			gen_++;
+		}
+		cvjob_.notify_all();
+		try{ f(0); }
+		catch(...){ ok = false; }
+		std::unique_lock<std::mutex> lk(mx_);
+		cvdone_.wait(lk, [&]{ return nbusy_ == 0; });
+		return ok && !failed_;
+	}
+	/** @brief the first error of a worker in the last run(), empty if none */
+	const std::string& error() const { return error_; }
+	/** @brief stops and joins the workers */
+	~ThreadPool(){
+		{
+			std::lock_guard<std::mutex> lk(mx_);
+			stop_ = true;
+		}
+		cvjob_.notify_all();
+		for (int t = 0 ; t < (int)th_.size() ; t++) th_[t].join();
+	}
+};
+
+#endif /*THREADPOOL_HPP*/
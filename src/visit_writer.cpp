@@ -9,18 +9,55 @@
 #include "visit_writer.h"
 
 
-/**@var static FILE *fp
-	 current file.
+/** @brief size of the buffer of a file, in bytes */
+#define VW_BUFSIZE (1 << 20)
+
+/** @brief a file being written.
+
+	All the state of a write is kept here, not in globals, so several files
+	can be written at the same time from different threads. Everything is
+	put into buf and written with one fwrite when it is full.
 */
-static FILE *fp = NULL; 
- /** @var static int useBinary
-		 tells whether we should use binary.
-	*/
-static int useBinary = 0; 
- /** @var static int numInColumn
-		 number of character in line.
- */
-static int numInColumn = 0; 
+typedef struct
+{
+    FILE *fp;          /**< @brief the file, NULL if it could not be opened */
+    int useBinary;     /**< @brief tells whether we should use binary */
+    int shouldSwap;    /**< @brief the machine is little-endian, binary data is swapped */
+    int numInColumn;   /**< @brief number of values in the current ascii line */
+    char *buf;         /**< @brief data not written yet */
+    size_t used;       /**< @brief bytes used in buf */
+} vw_file;
+
+/*****************************************************************************/
+/** @func flush_buffer
+ *
+ *  Purpose:
+ *      Writes what is in the buffer to the file.
+ *
+ */ /**************************************************************************/
+
+static void flush_buffer(vw_file *f)
+{
+    if (f->used > 0 && f->fp != NULL)
+        fwrite(f->buf, 1, f->used, f->fp);
+    f->used = 0;
+}
+
+/*****************************************************************************/
+/** @func reserve
+ *
+ *  Purpose:
+ *      Makes room for n more bytes in the buffer, n must not be larger
+ *      than VW_BUFSIZE. Returns where they go.
+ *
+ */ /**************************************************************************/
+
+static char *reserve(vw_file *f, size_t n)
+{
+    if (f->used + n > VW_BUFSIZE)
+        flush_buffer(f);
+    return f->buf + f->used;
+}
 
 /*****************************************************************************/
 /** @func end_line
@@ -35,13 +72,13 @@ static int numInColumn = 0;
  * 
  */ /**************************************************************************/
 
-static void end_line(void)
+static void end_line(vw_file *f)
 {
-    if (!useBinary)
+    if (!f->useBinary)
     {
-        char str2[8] = "\n";
-        fprintf(fp, str2);
-        numInColumn = 0;
+        *reserve(f, 1) = '\n';
+        f->used++;
+        f->numInColumn = 0;
     }
 }
 
@@ -49,82 +86,90 @@ static void end_line(void)
 /** @func open_file
  *
  *  Purpose:
- *      Opens a file for writing and assigns the handle to the global variable
- *      "fp".
+ *      Opens a file for writing and sets up f. Returns 0 if it could not be
+ *      opened, then nothing is written.
  *
  *  Programmer: Hank Childs
  *  Creation:   September 3, 2004
  * 
  */ /*************************************************************************/
 
-static void open_file(const char *filename)
+static int open_file(vw_file *f, const char *filename, int ub)
 {
     char full_filename[1024];
+    int tmp1 = 1;
     if (strstr(filename, ".vtk") != NULL)
     {
-        strcpy(full_filename, filename);
+        snprintf(full_filename, sizeof(full_filename), "%s", filename);
     }
     else
     {
-        sprintf(full_filename, "%s.vtk", filename);
+        snprintf(full_filename, sizeof(full_filename), "%s.vtk", filename);
     }
 
-    fp = fopen(full_filename, "w+");
+    f->useBinary = ub;
+    f->shouldSwap = (*(unsigned char *) &tmp1 != 0);
+    f->numInColumn = 0;
+    f->used = 0;
+    f->buf = (char *) malloc(VW_BUFSIZE);
+    f->fp = (f->buf == NULL ? NULL : fopen(full_filename, "w+"));
+    if (f->fp == NULL)
+    {
+        free(f->buf);
+        f->buf = NULL;
+        return 0;
+    }
+    return 1;
 }
 
 /*****************************************************************************/
 /** @func close_file
  *
  *  Purpose:
- *      Closes the file with handle "fp" (a global variable).
+ *      Writes the rest of the buffer and closes the file.
  *
  *  Programmer: Hank Childs
  *  Creation:   September 3, 2004
  * 
  */ /************************************************************************ */
 
-static void close_file(void)
+static void close_file(vw_file *f)
 {
-    end_line();
-    fclose(fp);
-    fp = NULL;
+    end_line(f);
+    flush_buffer(f);
+    fclose(f->fp);
+    free(f->buf);
+    f->fp = NULL;
+    f->buf = NULL;
 }
 
 /*****************************************************************************/
-/** @func force_big_endian
+/** @func copy_big_endian
  *
  *  Purpose:
- *      Determines if the machine is little-endian.  If so, then, for binary
- *      data, it will force the data to be big-endian.
- *
- *  Note:       This assumes that all inputs are 4 bytes long.
+ *      Copies n 4 byte values to dst. If the machine is little-endian, the
+ *      bytes of each are swapped, so the data is big-endian.
  *
  *  Programmer: Hank Childs
  *  Creation:   September 3, 2004
  * 
  */ /************************************************************************* */
 
-static void force_big_endian(unsigned char *bytes)
+static void copy_big_endian(const vw_file *f, unsigned char *dst,
+                            const unsigned char *src, size_t n)
 {
-    static int doneTest = 0;
-    static int shouldSwap = 0;
-    if (!doneTest)
+    size_t i;
+    if (!f->shouldSwap)
     {
-        int tmp1 = 1;
-        unsigned char *tmp2 = (unsigned char *) &tmp1;
-        if (*tmp2 != 0)
-            shouldSwap = 1;
-        doneTest = 1;
+        memcpy(dst, src, 4*n);
+        return;
     }
-
-    if (shouldSwap & useBinary)
+    for (i = 0 ; i < n ; i++, dst += 4, src += 4)
     {
-        unsigned char tmp = bytes[0];
-        bytes[0] = bytes[3];
-        bytes[3] = tmp;
-        tmp = bytes[1];
-        bytes[1] = bytes[2];
-        bytes[2] = tmp;
+        dst[0] = src[3];
+        dst[1] = src[2];
+        dst[2] = src[1];
+        dst[3] = src[0];
     }
 }
 
@@ -139,9 +184,17 @@ static void force_big_endian(unsigned char *bytes)
  * 
  */ /************************************************************************ */
 
-static void write_string(const char *str)
+static void write_string(vw_file *f, const char *str)
 {
-    fprintf(fp, str);
+    size_t n = strlen(str);
+    while (n > 0)
+    {
+        size_t m = (n < VW_BUFSIZE ? n : VW_BUFSIZE);
+        memcpy(reserve(f, m), str, m);
+        f->used += m;
+        str += m;
+        n -= m;
+    }
 }
 
 /*****************************************************************************/
@@ -156,52 +209,73 @@ static void write_string(const char *str)
  * 
  *//**************************************************************************/
 
-static void new_section(void)
+static void new_section(vw_file *f)
 {
-    if (numInColumn != 0)
-        end_line();
-    numInColumn = 0;
+    if (f->numInColumn != 0)
+        end_line(f);
+    f->numInColumn = 0;
 }
 
 /*****************************************************************************/
-/** @func write_int
+/** @func write_ascii
+ *
+ *  Purpose:
+ *      Writes one formatted value to an ASCII file, 9 to a line.
+ *
+ */ /************************************************************************* */
+
+static void write_ascii(vw_file *f, const char *str)
+{
+    write_string(f, str);
+    if (((f->numInColumn++) % 9) == 8)
+        end_line(f);
+}
+
+/*****************************************************************************/
+/** @func write_ints
  *
  *  Purpose:
- *      Writes an integer to the currently open file.  This routine takes
- *      care of ASCII vs binary issues.
+ *      Writes n integers to the currently open file.  This routine takes
+ *      care of ASCII vs binary issues.  Binary data is swapped into the
+ *      buffer a block at a time.
  *
  *  Programmer: Hank Childs
  *  Creation:   September 3, 2004
  * 
  */ /************************************************************************* */
 
-static void write_int(int val)
+static void write_ints(vw_file *f, const int *val, size_t n)
 {
-    if (useBinary)
+    if (f->useBinary)
     {
-        force_big_endian((unsigned char *) &val);
-        fwrite(&val, sizeof(int), 1, fp);
+        while (n > 0)
+        {
+            size_t m = (n < VW_BUFSIZE/4 ? n : VW_BUFSIZE/4);
+            copy_big_endian(f, (unsigned char *) reserve(f, 4*m),
+                            (const unsigned char *) val, m);
+            f->used += 4*m;
+            val += m;
+            n -= m;
+        }
     }
     else
     {
         char str[128];
-        sprintf(str, "%d ", val);
-        fprintf(fp, str);
-        if (((numInColumn++) % 9) == 8)
+        for ( ; n > 0 ; n--)
         {
-            char str2[8] = "\n";
-            fprintf(fp, str2);
-            numInColumn = 0;
+            snprintf(str, sizeof(str), "%d ", *val++);
+            write_ascii(f, str);
         }
     }
 }
 
 /*****************************************************************************/
-/** @func write_float
+/** @func write_floats
  *
  *  Purpose:
- *      Writes an float to the currently open file.  This routine takes
- *      care of ASCII vs binary issues.
+ *      Writes n floats to the currently open file.  This routine takes
+ *      care of ASCII vs binary issues.  Binary data is swapped into the
+ *      buffer a block at a time.
  *
  *  Programmer: Hank Childs
  *  Creation:   September 3, 2004
@@ -213,25 +287,44 @@ static void write_int(int val)
  *
  */ /************************************************************************* */
 
-static void write_float(float val)
+static void write_floats(vw_file *f, const float *val, size_t n)
 {
-    if (useBinary)
+    if (f->useBinary)
     {
-        force_big_endian((unsigned char *) &val);
-        fwrite(&val, sizeof(float), 1, fp);
+        while (n > 0)
+        {
+            size_t m = (n < VW_BUFSIZE/4 ? n : VW_BUFSIZE/4);
+            copy_big_endian(f, (unsigned char *) reserve(f, 4*m),
+                            (const unsigned char *) val, m);
+            f->used += 4*m;
+            val += m;
+            n -= m;
+        }
     }
     else
     {
         char str[128];
-        sprintf(str, "%20.12e ", val);
-        fprintf(fp, str);
-        if (((numInColumn++) % 9) == 8)
+        for ( ; n > 0 ; n--)
         {
-            end_line();
+            snprintf(str, sizeof(str), "%20.12e ", *val++);
+            write_ascii(f, str);
         }
     }
 }
 
+/*****************************************************************************/
+/** @func write_int
+ *
+ *  Purpose:
+ *      Writes an integer to the currently open file.
+ *
+ */ /************************************************************************* */
+
+static void write_int(vw_file *f, int val)
+{
+    write_ints(f, &val, 1);
+}
+
 /*****************************************************************************/
 /** @func void write_header(void)
  *
@@ -244,14 +337,14 @@ static void write_float(float val)
  * 
  *//**************************************************************************/
 
-static void write_header(void)
+static void write_header(vw_file *f)
 {
-    fprintf(fp, "# vtk DataFile Version 2.0\n");
-    fprintf(fp, "Written using VisIt writer\n");
-    if (useBinary)
-        fprintf(fp, "BINARY\n");
+    write_string(f, "# vtk DataFile Version 2.0\n");
+    write_string(f, "Written using VisIt writer\n");
+    if (f->useBinary)
+        write_string(f, "BINARY\n");
     else
-        fprintf(fp, "ASCII\n");
+        write_string(f, "ASCII\n");
 }
 
 /*****************************************************************************/
@@ -274,18 +367,18 @@ static void write_header(void)
  * 
  */ /************************************************************************* */
 
-void write_variables(int nvars, int *vardim, int *centering, 
+static void write_variables(vw_file *f, int nvars, int *vardim, int *centering, 
                      const char * const * varname, float **vars,
                      int npts, int ncells)
 {
     char str[1024];
-    int i, j, first_scalar, first_vector;
+    int i, first_scalar, first_vector;
     int num_scalars, num_vectors;
     int num_field = 0;
 
-    new_section();
+    new_section(f);
     sprintf(str, "CELL_DATA %d\n", ncells);
-    write_string(str);
+    write_string(f, str);
 
     first_scalar = 0;
     first_vector = 0;
@@ -308,8 +401,8 @@ void write_variables(int nvars, int *vardim, int *centering,
                 {
                     should_write = 1;
                     sprintf(str, "SCALARS %s float\n", varname[i]);
-                    write_string(str);
-                    write_string("LOOKUP_TABLE default\n");
+                    write_string(f, str);
+                    write_string(f, "LOOKUP_TABLE default\n");
                     first_scalar = 1;
                 }
                 else 
@@ -321,7 +414,7 @@ void write_variables(int nvars, int *vardim, int *centering,
                 {
                     should_write = 1;
                     sprintf(str, "VECTORS %s float\n", varname[i]);
-                    write_string(str);
+                    write_string(f, str);
                     first_vector = 1;
                 }
                 else 
@@ -337,11 +430,8 @@ void write_variables(int nvars, int *vardim, int *centering,
             if (should_write)
             {
                 num_to_write = ncells*vardim[i];
-                for (j = 0 ; j < num_to_write ; j++)
-                {
-                    write_float(vars[i][j]);
-                }
-                end_line();
+                write_floats(f, vars[i], num_to_write);
+                end_line(f);
             }
         }
     }
@@ -350,7 +440,7 @@ void write_variables(int nvars, int *vardim, int *centering,
     if (num_scalars > 0)
     {
         sprintf(str, "FIELD FieldData %d\n", num_scalars);
-        write_string(str);
+        write_string(f, str);
         for (i = 0 ; i < nvars ; i++)
         {
             int should_write = 0;
@@ -366,7 +456,7 @@ void write_variables(int nvars, int *vardim, int *centering,
                     {
                         should_write = 1;
                         sprintf(str, "%s 1 %d float\n", varname[i], ncells);
-                        write_string(str);
+                        write_string(f, str);
                     }
                 }
             }
@@ -374,11 +464,8 @@ void write_variables(int nvars, int *vardim, int *centering,
             if (should_write)
             {
                 int num_to_write = ncells*vardim[i];
-                for (j = 0 ; j < num_to_write ; j++)
-                {
-                    write_float(vars[i][j]);
-                }
-                end_line();
+                write_floats(f, vars[i], num_to_write);
+                end_line(f);
             }
         }
     }
@@ -387,7 +474,7 @@ void write_variables(int nvars, int *vardim, int *centering,
     if (num_vectors > 0)
     {
         sprintf(str, "FIELD FieldData %d\n", num_vectors);
-        write_string(str);
+        write_string(f, str);
         for (i = 0 ; i < nvars ; i++)
         {
             int should_write = 0;
@@ -405,7 +492,7 @@ void write_variables(int nvars, int *vardim, int *centering,
                     {
                         should_write = 1;
                         sprintf(str, "%s 3 %d float\n", varname[i], ncells);
-                        write_string(str);
+                        write_string(f, str);
                     }
                 }
             }
@@ -413,18 +500,15 @@ void write_variables(int nvars, int *vardim, int *centering,
             if (should_write)
             {
                 int num_to_write = ncells*vardim[i];
-                for (j = 0 ; j < num_to_write ; j++)
-                {
-                    write_float(vars[i][j]);
-                }
-                end_line();
+                write_floats(f, vars[i], num_to_write);
+                end_line(f);
             }
         }
     }
 
-    new_section();
+    new_section(f);
     sprintf(str, "POINT_DATA %d\n", npts);
-    write_string(str);
+    write_string(f, str);
 
     first_scalar = 0;
     first_vector = 0;
@@ -447,8 +531,8 @@ void write_variables(int nvars, int *vardim, int *centering,
                 {
                     should_write = 1;
                     sprintf(str, "SCALARS %s float\n", varname[i]);
-                    write_string(str);
-                    write_string("LOOKUP_TABLE default\n");
+                    write_string(f, str);
+                    write_string(f, "LOOKUP_TABLE default\n");
                     first_scalar = 1;
                 }
                 else 
@@ -460,7 +544,7 @@ void write_variables(int nvars, int *vardim, int *centering,
                 {
                     should_write = 1;
                     sprintf(str, "VECTORS %s float\n", varname[i]);
-                    write_string(str);
+                    write_string(f, str);
                     first_vector = 1;
                 }
                 else 
@@ -476,11 +560,8 @@ void write_variables(int nvars, int *vardim, int *centering,
             if (should_write)
             {
                 num_to_write = npts*vardim[i];
-                for (j = 0 ; j < num_to_write ; j++)
-                {
-                    write_float(vars[i][j]);
-                }
-                end_line();
+                write_floats(f, vars[i], num_to_write);
+                end_line(f);
             }
         }
     }
@@ -489,7 +570,7 @@ void write_variables(int nvars, int *vardim, int *centering,
     if (num_scalars > 0)
     {
         sprintf(str, "FIELD FieldData %d\n", num_scalars);
-        write_string(str);
+        write_string(f, str);
         for (i = 0 ; i < nvars ; i++)
         {
             int should_write = 0;
@@ -505,7 +586,7 @@ void write_variables(int nvars, int *vardim, int *centering,
                     {
                         should_write = 1;
                         sprintf(str, "%s 1 %d float\n", varname[i], npts);
-                        write_string(str);
+                        write_string(f, str);
                     }
                 }
             }
@@ -513,11 +594,8 @@ void write_variables(int nvars, int *vardim, int *centering,
             if (should_write)
             {
                 int num_to_write = npts*vardim[i];
-                for (j = 0 ; j < num_to_write ; j++)
-                {
-                    write_float(vars[i][j]);
-                }
-                end_line();
+                write_floats(f, vars[i], num_to_write);
+                end_line(f);
             }
         }
     }
@@ -526,7 +604,7 @@ void write_variables(int nvars, int *vardim, int *centering,
     if (num_vectors > 0)
     {
         sprintf(str, "FIELD FieldData %d\n", num_vectors);
-        write_string(str);
+        write_string(f, str);
         for (i = 0 ; i < nvars ; i++)
         {
             int should_write = 0;
@@ -544,7 +622,7 @@ void write_variables(int nvars, int *vardim, int *centering,
                     {
                         should_write = 1;
                         sprintf(str, "%s 3 %d float\n", varname[i], npts);
-                        write_string(str);
+                        write_string(f, str);
                     }
                 }
             }
@@ -552,11 +630,8 @@ void write_variables(int nvars, int *vardim, int *centering,
             if (should_write)
             {
                 int num_to_write = npts*vardim[i];
-                for (j = 0 ; j < num_to_write ; j++)
-                {
-                    write_float(vars[i][j]);
-                }
-                end_line();
+                write_floats(f, vars[i], num_to_write);
+                end_line(f);
             }
         }
     }
@@ -597,44 +672,42 @@ void write_point_mesh(const char *filename, int ub, int npts, float *pts,
     char  str[128];
     int  *centering = NULL;
 
-    useBinary = ub;
-    open_file(filename);
-    write_header();
+    vw_file file, *f = &file;
+    if (!open_file(f, filename, ub))
+        return;
+    write_header(f);
 
-    write_string("DATASET UNSTRUCTURED_GRID\n");
+    write_string(f, "DATASET UNSTRUCTURED_GRID\n");
     sprintf(str, "POINTS %d float\n", npts);
-    write_string(str);
-    for (i = 0 ; i < 3*npts ; i++)
-    {
-        write_float(pts[i]);
-    }
+    write_string(f, str);
+    write_floats(f, pts, 3*npts);
 
-    new_section();
+    new_section(f);
     sprintf(str, "CELLS %d %d\n", npts, 2*npts);
-    write_string(str);
+    write_string(f, str);
     for (i = 0 ; i < npts ; i++)
     {
-        write_int(1);
-        write_int(i);
-        end_line();
+        write_int(f, 1);
+        write_int(f, i);
+        end_line(f);
     }
 
-    new_section();
+    new_section(f);
     sprintf(str, "CELL_TYPES %d\n", npts);
-    write_string(str);
+    write_string(f, str);
     for (i = 0 ; i < npts ; i++)
     {
-        write_int(VISIT_VERTEX);
-        end_line();
+        write_int(f, VISIT_VERTEX);
+        end_line(f);
     }
 
     centering = (int *) malloc(nvars*sizeof(int));
     for (i = 0 ; i < nvars ; i++)
         centering[i] = 1;
-    write_variables(nvars, vardim, centering, varnames, vars, npts, npts);
+    write_variables(f, nvars, vardim, centering, varnames, vars, npts, npts);
     free(centering);
 
-    close_file();
+    close_file(f);
 }
 
 
@@ -722,24 +795,22 @@ void write_unstructured_mesh(const char *filename, int ub, int npts,
                              int nvars, int *vardim, int *centering,
                              const char * const *varnames, float **vars)
 {
-    int   i, j;
+    int   i;
     char  str[128];
     int   conn_size = 0;
     int  *curr_conn = conn;
 
-    useBinary = ub;
-    open_file(filename);
-    write_header();
+    vw_file file, *f = &file;
+    if (!open_file(f, filename, ub))
+        return;
+    write_header(f);
 
-    write_string("DATASET UNSTRUCTURED_GRID\n");
+    write_string(f, "DATASET UNSTRUCTURED_GRID\n");
     sprintf(str, "POINTS %d float\n", npts);
-    write_string(str);
-    for (i = 0 ; i < 3*npts ; i++)
-    {
-        write_float(pts[i]);
-    }
+    write_string(f, str);
+    write_floats(f, pts, 3*npts);
 
-    new_section();
+    new_section(f);
     for (i = 0 ; i < ncells ; i++)
     {
         int npts = num_points_for_cell(celltypes[i]);
@@ -747,28 +818,28 @@ void write_unstructured_mesh(const char *filename, int ub, int npts,
         conn_size += npts+1;
     }
     sprintf(str, "CELLS %d %d\n", ncells, conn_size);
-    write_string(str);
+    write_string(f, str);
     for (i = 0 ; i < ncells ; i++)
     {
         int npts = num_points_for_cell(celltypes[i]);
-        write_int(npts);
-        for (j = 0 ; j < npts ; j++)
-            write_int(*curr_conn++);
-        end_line();
+        write_int(f, npts);
+        write_ints(f, curr_conn, npts);
+        curr_conn += npts;
+        end_line(f);
     }
 
-    new_section();
+    new_section(f);
     sprintf(str, "CELL_TYPES %d\n", ncells);
-    write_string(str);
+    write_string(f, str);
     for (i = 0 ; i < ncells ; i++)
     {
-        write_int(celltypes[i]);
-        end_line();
+        write_int(f, celltypes[i]);
+        end_line(f);
     }
 
-    write_variables(nvars, vardim, centering, varnames, vars, npts, ncells);
+    write_variables(f, nvars, vardim, centering, varnames, vars, npts, ncells);
 
-    close_file();
+    close_file(f);
 }
 
 
@@ -815,7 +886,7 @@ void write_rectilinear_mesh(const char *filename, int ub, int *dims,
                             int nvars, int *vardim, int *centering,
                             const char * const *varnames, float **vars)
 {
-    int   i, j;
+    int   j;
     char  str[128];
     int npts = dims[0]*dims[1]*dims[2];
     int ncX = (dims[0] - 1 < 1 ? 1 : dims[0] - 1);
@@ -823,31 +894,29 @@ void write_rectilinear_mesh(const char *filename, int ub, int *dims,
     int ncZ = (dims[2] - 1 < 1 ? 1 : dims[2] - 1);
     int ncells = ncX*ncY*ncZ;
 
-    useBinary = ub;
-    open_file(filename);
-    write_header();
+    vw_file file, *f = &file;
+    if (!open_file(f, filename, ub))
+        return;
+    write_header(f);
 
-    write_string("DATASET RECTILINEAR_GRID\n");
+    write_string(f, "DATASET RECTILINEAR_GRID\n");
     sprintf(str, "DIMENSIONS %d %d %d\n", dims[0], dims[1], dims[2]);
-    write_string(str);
+    write_string(f, str);
     sprintf(str, "X_COORDINATES %d float\n", dims[0]);
-    write_string(str);
-    for (i = 0 ; i < dims[0] ; i++)
-        write_float(x[i]);
-    new_section();
+    write_string(f, str);
+    write_floats(f, x, dims[0]);
+    new_section(f);
     sprintf(str, "Y_COORDINATES %d float\n", dims[1]);
-    write_string(str);
-    for (i = 0 ; i < dims[1] ; i++)
-        write_float(y[i]);
-    new_section();
+    write_string(f, str);
+    write_floats(f, y, dims[1]);
+    new_section(f);
     sprintf(str, "Z_COORDINATES %d float\n", dims[2]);
-    write_string(str);
-    for (i = 0 ; i < dims[2] ; i++)
-        write_float(z[i]);
+    write_string(f, str);
+    write_floats(f, z, dims[2]);
 
-    write_variables(nvars, vardim, centering, varnames, vars, npts, ncells);
+    write_variables(f, nvars, vardim, centering, varnames, vars, npts, ncells);
 
-    close_file();
+    close_file(f);
 }
 
 
@@ -952,7 +1021,7 @@ void write_curvilinear_mesh(const char *filename, int ub, int *dims,float *pts,
                             int nvars, int *vardim, int *centering,
                             const char * const *varnames, float **vars)
 {
-    int   i, j;
+    int   j;
     char  str[128];
     int npts = dims[0]*dims[1]*dims[2];
     int ncX = (dims[0] - 1 < 1 ? 1 : dims[0] - 1);
@@ -960,23 +1029,21 @@ void write_curvilinear_mesh(const char *filename, int ub, int *dims,float *pts,
     int ncZ = (dims[2] - 1 < 1 ? 1 : dims[2] - 1);
     int ncells = ncX*ncY*ncZ;
 
-    useBinary = ub;
-    open_file(filename);
-    write_header();
+    vw_file file, *f = &file;
+    if (!open_file(f, filename, ub))
+        return;
+    write_header(f);
 
-    write_string("DATASET STRUCTURED_GRID\n");
+    write_string(f, "DATASET STRUCTURED_GRID\n");
     sprintf(str, "DIMENSIONS %d %d %d\n", dims[0], dims[1], dims[2]);
-    write_string(str);
+    write_string(f, str);
     sprintf(str, "POINTS %d float\n", npts);
-    write_string(str);
-    for (i = 0 ; i < 3*npts ; i++)
-    {
-        write_float(pts[i]);
-    }
+    write_string(f, str);
+    write_floats(f, pts, 3*npts);
 
-    write_variables(nvars, vardim, centering, varnames, vars, npts, ncells);
+    write_variables(f, nvars, vardim, centering, varnames, vars, npts, ncells);
 
-    close_file();
+    close_file(f);
 }
 
 